@@ -5,6 +5,8 @@
 #define TRACKINGTELESCOPE_ACTION_H
 
 #include <string>
+#include <utility>
+#include <cstdint>
 #include <TString.h>
 class PSIFileReader;
 
@@ -14,12 +16,16 @@ public:
   Action(std::string , const TString &);
   ~Action() = default;
 
+  /** process only the entries [first, last] of ROOT input files (last < 0: until the end of the file) */
+  static void SetEntryRange(uint32_t first, int64_t last) { entry_range_ = std::make_pair(first, last); }
+
 protected:
   const std::string in_file_name_;
   const TString run_number_;
 
   PSIFileReader * FR;
   PSIFileReader * InitFileReader() const;
+  static std::pair<uint32_t, int64_t> entry_range_;
 };
 
 
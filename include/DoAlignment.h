@@ -2,6 +2,8 @@
 #define DoAlignment_h
 
 #include "Action.h"
+#include "PLTEventCache.h"
+#include <cmath>
 namespace tel { class ProgressBar; }
 class TH2F;
 class TGraph;
@@ -11,7 +13,7 @@ class TProfile;
 class Alignment: public Action {
 
 public:
-  Alignment(const std::string& in_file_name, const TString &run_number, uint16_t telescope_id, bool only_tel, uint16_t max_steps, float max_res, float max_angle, uint32_t max_events, int16_t sil_dut_roc);
+  Alignment(const std::string& in_file_name, const TString &run_number, uint16_t telescope_id, bool only_tel, uint16_t max_steps, float max_res, float max_angle, uint32_t max_events, int16_t sil_dut_roc, bool save_plots=false, bool global=false);
   ~Alignment();
 
   /** variables */
@@ -21,6 +23,8 @@ public:
   bool align_only_telescope_;
   uint16_t at_step_;
   bool alignment_finished_;
+  bool const save_plots_;  /** fill and save the residual histograms of every iteration */
+  bool const global_;  /** align all planes at once with a global least squares fit instead of the iterative steps */
 
   /** methods */
   int Align();
@@ -44,7 +48,14 @@ private:
   float const res_thresh_;
   float const delta_fac_ = .1;
   void EventLoop(const std::vector<uint16_t>&);
+  /** global alignment: normal equations of the offsets and rotations of all planes with the track parameters eliminated per track */
+  uint16_t const max_global_passes_ = 4;
+  std::vector<float> global_res_cut_;  /** residual cut per plane for the next pass */
+  void GlobalAlign();
+  void GlobalEventLoop(const std::vector<uint16_t>&, const std::vector<int>&);
   uint64_t max_event_number_;
+  /** decoded hits of the first pass, replayed with the updated alignment in all further iterations and steps */
+  PLTEventCache event_cache_;
   tel::ProgressBar * ProgressBar;
   float now_;
   uint16_t const maximum_steps_;
@@ -66,16 +77,37 @@ private:
   void SetPlanes();
   void SetNextAlignmentStep();
   float ReduceSigma(uint16_t step) const;
+  int TelescopePlaneBits() const;
   float CalcRes(uint16_t);
 
-  /** Histograms -------------------
+  /** Unbinned residual statistics of one plane: Welford mean/variance of dX and dY and the running co-moments
+   *  for the straight line fits dY(X) and dX(Y), which give the offsets and rotation angles directly */
+  struct ResidualMoments {
+    uint64_t N = 0;
+    double MeanDX = 0, MeanDY = 0, M2DX = 0, M2DY = 0;
+    double MeanX = 0, MeanY = 0, M2X = 0, M2Y = 0, CXdY = 0, CYdX = 0;
+    void Add(double x, double y, double dx, double dy) {
+      N++;
+      double const ddx = dx - MeanDX, ddy = dy - MeanDY, dxx = x - MeanX, dyy = y - MeanY;
+      MeanDX += ddx / N; MeanDY += ddy / N; MeanX += dxx / N; MeanY += dyy / N;
+      M2DX += ddx * (dx - MeanDX); M2DY += ddy * (dy - MeanDY);
+      M2X += dxx * (x - MeanX); M2Y += dyy * (y - MeanY);
+      CXdY += dxx * (dy - MeanDY); CYdX += dyy * (dx - MeanDX);
+    }
+    double RMSDX() const { return N > 0 ? std::sqrt(M2DX / N) : 0; }
+    double RMSDY() const { return N > 0 ? std::sqrt(M2DY / N) : 0; }
+    double SlopeXdY() const { return M2X > 0 ? CXdY / M2X : 0; }
+    double SlopeYdX() const { return M2Y > 0 ? CYdX / M2Y : 0; }
+  };
+  std::vector<ResidualMoments> residual_moments_;
+
+  /** Histograms (only filled if the plots are saved) -------------------
    *  hResidual:    x=dX / y=dY
    *  hResidualXdY: x=X  / y=dY
    *  hResidualYdX: x=Y  / y=dX  */
   std::vector<TH2F> hResidual;
   std::vector<TProfile> hResidualXdY;
   std::vector<TProfile> hResidualYdX;
-  std::pair <std::pair<float, float>, std::pair<float, float>> GetFitRange(uint16_t plane);
   std::vector<TGraph*> g_res_mean_;
   std::vector<TGraph*> g_res_angle_;
   void CalcMaxResiduals();
@@ -7,13 +7,19 @@
 #include <fstream>
 #include <string>
 #include <map>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 
 #include "TTree.h"
 #include "TFile.h"
+#include "TLeaf.h"
 
 #include "PSIRootFileReader.h"
 
 #define DEF_VAL -999
+#define WRITER_QUEUE_SIZE 1024  // number of events that can be in flight between the event loop and the writer thread
 
 class FileWriterTracking{
 
@@ -34,76 +40,118 @@ private:
     /** ============================
         BRANCH VARIABLES
      =================================*/
-    uint16_t br_hit_plane_bits = 0;
+    /** all tree variables of one event */
+    struct Record {
+        uint32_t entry = 0;
+        uint16_t hit_plane_bits = 0;
+        /** tracks */
+        uint8_t n_tracks = 0;
+        std::vector<float> dia_track_pos_x, dia_track_pos_y, dia_track_pos_x_loc, dia_track_pos_y_loc, dist_to_dia;
+        std::vector<float> track_col, track_row;
+        float chi2 = DEF_VAL, chi2_x = DEF_VAL, chi2_y = DEF_VAL;
+        float angle_x = DEF_VAL, angle_y = DEF_VAL;
+        std::vector<std::vector<float> > residuals_x, residuals_y, residuals;
+        std::vector<float> sres_x, sres_y, sres;
+        std::vector<std::vector<float> > track_x, track_y;
+        /** cluster numbers */
+        uint8_t total_clusters = 0;
+        std::vector<uint16_t> n_hits;
+        std::vector<uint8_t> n_clusters;
+        std::vector<std::vector<uint16_t> > cluster_size;
+        /** cluster positions */
+        std::vector<std::vector<uint16_t> > cluster_col, cluster_row;
+        std::vector<std::vector<float> > cluster_xpos_tel, cluster_ypos_tel;      // telescope coordinates (after alignment)
+        std::vector<std::vector<float> > cluster_xpos_local, cluster_ypos_local;  // local coordinates
+        /** cluster charge */
+        std::vector<std::vector<float> > cluster_charge;
+        /** calibrated charges of all hits, they replace the charge branch of the cloned input tree */
+        std::vector<float> charge;
+        /** raw bytes of the copied leaves of the input tree, in the order of copied_leaves_ */
+        std::vector<char> leaf_data;
+        std::vector<uint32_t> leaf_sizes;
+
+        void resize(uint16_t n_rocs, uint8_t n_duts);
+        void moveTo(Record & other);  // copies the fixed size variables and swaps the cluster vectors
+    };
+    Record event_;  // filled by the event loop
+    Record out_;    // branch buffers of newtree, only used by the writer thread
     std::vector<bool> * is_aligned;
     std::vector<bool> * br_aligned;
+    /** object branches need the address of a pointer */
+    std::vector<std::vector<float> > * br_residuals_x, * br_residuals_y, * br_residuals, * br_track_x, * br_track_y;
+    std::vector<std::vector<uint16_t> > * br_cluster_size, * br_cluster_col, * br_cluster_row;
+    std::vector<std::vector<float> > * br_cluster_xpos_tel, * br_cluster_ypos_tel, * br_cluster_xpos_local, * br_cluster_ypos_local, * br_cluster_charge;
 
-    /** tracks */
-    uint8_t br_n_tracks = 0;
-    float *br_dia_track_pos_x, *br_dia_track_pos_y, *br_dia_track_pos_x_loc, *br_dia_track_pos_y_loc, *br_dist_to_dia;
-    float *br_track_col, *br_track_row;
-    float br_chi2 = DEF_VAL, br_chi2_x = DEF_VAL, br_chi2_y = DEF_VAL;
-    float br_angle_x = DEF_VAL, br_angle_y = DEF_VAL;
-    std::vector<std::vector<float> > * br_residuals_x, * br_residuals_y;
-    std::vector<std::vector<float> > * br_residuals;
-    float *br_sres_x, *br_sres_y, *br_sres;
-    std::vector<std::vector<float> > * br_track_x, * br_track_y;
-
-  /** cluster numbers */
-    uint8_t br_total_clusters = 0;
-    uint16_t * br_n_hits;
-    uint8_t * br_n_clusters;
-    std::vector<std::vector<uint16_t> > * br_cluster_size;
-
-    /** cluster positions */
-    std::vector<std::vector<uint16_t> > * br_cluster_col, * br_cluster_row;
-    std::vector<std::vector<float> > * br_cluster_xpos_tel, * br_cluster_ypos_tel;      // telescope coordinates (after alignment)
-    std::vector<std::vector<float> > * br_cluster_xpos_local, * br_cluster_ypos_local;  // local coordinates
-
-    /** cluster charge */
-    std::vector<std::vector<float> > * br_cluster_charge;
+    /** ============================
+        WRITER THREAD
+     =================================*/
+    /** the event loop hands the records to a writer thread which fills them into newtree in the order of the entries,
+     *  so the serialisation and compression of the output overlaps with the decoding and tracking of the next events */
+    TFile * in_file_;         // own handle of the input file, newtree is cloned from it
+    TTree * copy_tree_;       // only the branches which can not be copied from intree are read in the writer thread
+    bool reread_entries_;
+    /** leaves of basic types: the event loop copies them from intree, the writer thread into newtree */
+    struct CopiedLeaf { TLeaf * in; TLeaf * out; };
+    std::vector<CopiedLeaf> copied_leaves_;
+    float charge_[UINT8_MAX + 1];  // buffer of the charge branch of copy_tree_ and newtree
+    std::vector<Record> records_;
+    std::vector<Record*> free_records_;
+    std::deque<Record*> filled_records_;
+    std::map<uint32_t, Record*> pending_records_;  // records waiting for an earlier entry, writer thread only
+    uint32_t next_entry_;
+    bool closing_;
+    std::mutex mutex_;
+    std::condition_variable free_cv_, filled_cv_;
+    std::thread writer_;
+
+    void initCopiedLeaves();
+    void writeLoop();
+    void writeRecord(Record *);
 
     /** some functions*/
-    std::string getFileName(std::string &);
+    static std::string getFileName(const std::string &, int16_t part, int16_t shard=-1);
 
 public:
 
     /** ============================
      CONSTRUCTOR
      =================================*/
-    FileWriterTracking(std::string, PSIFileReader * FR);
+    /** part >= 0: partial file of a parallel analysis, shard >= 0: file of one shard of a run split over several processes */
+    FileWriterTracking(std::string, PSIFileReader * FR, int16_t part=-1, uint32_t first_entry=0, int16_t shard=-1);
+    ~FileWriterTracking();
 
 
     /** ============================
      GET-FUNCTIONS
      =================================*/
     TTree * InTree() { return intree; }
-    uint8_t nClusters() const { return br_total_clusters; }
+    const std::string & FileName() const { return NewFileName; }
+    uint8_t nClusters() const { return event_.total_clusters; }
 
     /** ============================
         SETTER METHODS
         =================================*/
-    void setHitPlaneBits(uint16_t value) { br_hit_plane_bits = value; }
+    void setHitPlaneBits(uint16_t value) { event_.hit_plane_bits = value; }
     /** tracks */
-    void setNTracks(uint8_t value) { br_n_tracks = value; }
+    void setNTracks(uint8_t value) { event_.n_tracks = value; }
     void set_dut_tracks(const std::vector<float>*);
-    void setAngle(float xval, float yval) { br_angle_x = xval;  br_angle_y = yval; }
-    void setChi2(float total, float xval, float yval) { br_chi2 = total; br_chi2_x = xval; br_chi2_y = yval; }
-    void setResidualXY(uint8_t iRoc, float x, float y) { br_residuals_x->at(iRoc).push_back(x); br_residuals_y->at(iRoc).push_back(y); }
-    void setResidual(uint8_t iRoc, float value) { br_residuals->at(iRoc).push_back(value); }
+    void setAngle(float xval, float yval) { event_.angle_x = xval;  event_.angle_y = yval; }
+    void setChi2(float total, float xval, float yval) { event_.chi2 = total; event_.chi2_x = xval; event_.chi2_y = yval; }
+    void setResidualXY(uint8_t iRoc, float x, float y) { event_.residuals_x.at(iRoc).push_back(x); event_.residuals_y.at(iRoc).push_back(y); }
+    void setResidual(uint8_t iRoc, float value) { event_.residuals.at(iRoc).push_back(value); }
     void setSResidual(uint8_t iRoc, bool def);
-    void setTrackPos(uint8_t iRoc, float x, float y) { br_track_x->at(iRoc).push_back(x); br_track_x->at(iRoc).push_back(y); }
+    void setTrackPos(uint8_t iRoc, float x, float y) { event_.track_x.at(iRoc).push_back(x); event_.track_x.at(iRoc).push_back(y); }
     /** cluster numbers */
-    void setTotalClusters(uint8_t value) { br_total_clusters = value; }
-    void setNHits(uint8_t i_roc, uint16_t value) { br_n_hits[i_roc] = value; }
-    void setNClusters(uint8_t i_roc, uint8_t value) { br_n_clusters[i_roc] = value; }
-    void setClusterSize(uint8_t iRoc, int value) { br_cluster_size->at(iRoc).push_back(value); }
+    void setTotalClusters(uint8_t value) { event_.total_clusters = value; }
+    void setNHits(uint8_t i_roc, uint16_t value) { event_.n_hits[i_roc] = value; }
+    void setNClusters(uint8_t i_roc, uint8_t value) { event_.n_clusters[i_roc] = value; }
+    void setClusterSize(uint8_t iRoc, int value) { event_.cluster_size.at(iRoc).push_back(value); }
     /** cluster positions */
-    void setClusterPos(uint8_t iRoc, int col, int row) { br_cluster_col->at(iRoc).push_back(col); br_cluster_row->at(iRoc).push_back(row);}
-    void setClusterPosLocal(uint8_t iRoc, float x, float y) { br_cluster_xpos_local->at(iRoc).push_back(x); br_cluster_ypos_local->at(iRoc).push_back(y); }
-    void setClusterPosTel(uint8_t iRoc, float x, float y) { br_cluster_xpos_tel->at(iRoc).push_back(x); br_cluster_ypos_tel->at(iRoc).push_back(y); }
+    void setClusterPos(uint8_t iRoc, int col, int row) { event_.cluster_col.at(iRoc).push_back(col); event_.cluster_row.at(iRoc).push_back(row);}
+    void setClusterPosLocal(uint8_t iRoc, float x, float y) { event_.cluster_xpos_local.at(iRoc).push_back(x); event_.cluster_ypos_local.at(iRoc).push_back(y); }
+    void setClusterPosTel(uint8_t iRoc, float x, float y) { event_.cluster_xpos_tel.at(iRoc).push_back(x); event_.cluster_ypos_tel.at(iRoc).push_back(y); }
     /** cluster charge */
-    void setClusterCharge(uint8_t iRoc, float value) { br_cluster_charge->at(iRoc).push_back(value); }
+    void setClusterCharge(uint8_t iRoc, float value) { event_.cluster_charge.at(iRoc).push_back(value); }
 
     /** ============================
      AUXILIARY FUNCTIONS
@@ -111,7 +159,9 @@ public:
     void addBranches();
     void resizeVectors();
     void saveTree();
-    void fillTree();
+    static void mergeFiles(const std::vector<std::string> & parts, const std::string & InFileName, TMacro * names, int16_t shard=-1);
+    static std::string shardFileName(const std::string & InFileName, int16_t shard) { return getFileName(InFileName, -1, shard); }
+    void fillTree(uint32_t entry);
     void clearVectors();
 
 };
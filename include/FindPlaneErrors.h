@@ -13,10 +13,11 @@ namespace tel { class ProgressBar; }
 class FindPlaneErrors : public Action {
 
 public:
-  FindPlaneErrors(const std::string & in_file_name, const TString & run_number, int16_t telescope_ID);
+  FindPlaneErrors(const std::string & in_file_name, const TString & run_number, int16_t telescope_ID, bool single_pass=true);
   ~FindPlaneErrors();
   short const TelescopeID;
   unsigned const NPlanes;
+  bool const SinglePass;  /** read and clusterize the event sample once and refit the stored clusters */
   float Threshold;  /** in [cm] */
   int Run();
   void SaveErrors();
@@ -36,18 +37,24 @@ private:
   unsigned short MaxIterations;
   /** Histograms */
   std::pair<TH1F*, TH1F*> hChi2All;
-  std::pair<TH1F*, TH1F*> hChi2Res;
+  std::vector<std::pair<TH1F*, TH1F*>> hChi2Res;
   std::vector<std::pair<float, float>> Chi2Res;
   std::vector<std::pair<float, float>> RealChi2Res;
   std::pair<float, float> Chi2All;
   void FillAllChi2();
   void FillResChi2();
   void FillResChi2(unsigned short, bool=true);
+  void FitResChi2(unsigned short);
+  /** Event sample: telescope coordinates of the clusters in the planes with exactly one cluster */
+  std::vector<float> SampleTX, SampleTY, SampleTZ;  /** index: event * NPlanes + plane */
+  std::vector<short> SampleFreePlane;  /** plane without exactly one cluster (only usable as plane under test) or -1 */
+  void ReadSample();
+  void FillSampleChi2(bool, const std::vector<unsigned short>&);
   /** Fits */
   std::pair<TF1*, TF1*> AllFit;
   std::pair<TF1*, TF1*> ResFit;
   std::pair<TF1*, TF1*> InitFits(bool=false);
-  void FitGammaDistRes();
+  void FitGammaDistRes(unsigned short);
   void FitGammaDistAll();
   void SavePlots(unsigned short);
   void SavePlots();
@@ -31,12 +31,14 @@ struct AlignSettings {
   float res_thresh_ = 0;
   float angle_thresh_ = 0;
   int16_t sil_roc_ = -1;
+  uint64_t cache_memory_ = 1024;  // MB of alignment events kept in memory
 };
 
 AlignSettings ReadAlignSettings(std::vector<std::string>, uint16_t n_actions);
 std::string GetDir();
 std::string GetPlotDir();
 void ValidateDirectories(const std::string&);
+std::string GetRunNumber(const std::string&);
 std::string GetCalibrationPath();
 std::string GetAlignmentFilename();
 std::string GetMaskingFilename();
@@ -47,6 +49,8 @@ uint8_t GetNDUTs();
 int16_t GetRawID();
 int GetNSignals();
 bool UseGainInterpolator();
+bool UseGainLookupTable();
+uint64_t GetEventCacheMemory();
 bool UseExternalCalibrationFunction();
 bool IsROOTFile(const std::string& filename);
 bool UseFileWriter();
@@ -26,19 +26,67 @@ class PLTAlignment
     bool ErrorsFromFile;
     bool IsGood () { return fIsGood; }
 
-    float TtoLX (float , float, int, int);
-    float TtoLY (float, float, int, int);
-    std::pair<float, float> TtoLXY (float, float, int, int);
+    /** position or direction returned by the transforms below */
+    struct XYZ {
+      float X, Y, Z;
+    };
+
+    /** Rotation terms and translations of a plane, precomputed whenever its constants change.
+     *  The local rotation turns local into telescope coordinates, the global rotations about z and y turn telescope into global coordinates. */
+    struct PlaneFrame {
+      float CosLR, SinLR, LX, LY, LZ;
+      float CosGRZ, SinGRZ, CosGRY, SinGRY, GX, GY, GZ;
+    };
+    /** @returns: the frame of the plane or nullptr if there are no constants for it */
+    PlaneFrame const * FindFrame (int const ch, int const roc) {
+      if (roc >= 0 and roc < int(fPixelTables.size()) and fPixelTables[roc].Channel == ch) { return &fPixelTables[roc].Frame; }
+      return FindFrameSlow(ch, roc);
+    }
+    /** throws std::out_of_range if there are no constants for the plane */
+    PlaneFrame const & Frame (int, int);
+
+    /** Allocation free transforms between the local, telescope and global coordinates of a plane */
+    XYZ LtoT (float const LX, float const LY, int const ch, int const roc) {
+      PlaneFrame const & F = Frame(ch, roc);
+      return {LX * F.CosLR - LY * F.SinLR + F.LX, LX * F.SinLR + LY * F.CosLR + F.LY, F.LZ};
+    }
+    XYZ TtoG (XYZ const & T, int const ch, int const roc) {
+      PlaneFrame const & F = Frame(ch, roc);
+      float const GXZ = T.X * F.CosGRZ - T.Y * F.SinGRZ + F.GX, GYZ = T.X * F.SinGRZ + T.Y * F.CosGRZ + F.GY, GZZ = T.Z + F.GZ;
+      return {GXZ * F.CosGRY + GZZ * F.SinGRY, GYZ, GZZ * F.CosGRY - GXZ * F.SinGRY};
+    }
+    XYZ LtoG (float const LX, float const LY, int const ch, int const roc) { return TtoG(LtoT(LX, LY, ch, roc), ch, roc); }
+    XYZ GtoT (XYZ const & G, int const ch, int const roc) {
+      PlaneFrame const & F = Frame(ch, roc);
+      float const GXA = G.X * F.CosGRY - G.Z * F.SinGRY - F.GX, GYA = G.Y - F.GY, GZA = G.Z * F.CosGRY + G.X * F.SinGRY - F.GZ;
+      return {GXA * F.CosGRZ + GYA * F.SinGRZ, -GXA * F.SinGRZ + GYA * F.CosGRZ, GZA};
+    }
+    /** rotation only, for directions */
+    XYZ VTtoVG (XYZ const & V, int const ch, int const roc) {
+      PlaneFrame const & F = Frame(ch, roc);
+      float const GXZ = V.X * F.CosGRZ - V.Y * F.SinGRZ, GYZ = V.X * F.SinGRZ + V.Y * F.CosGRZ;
+      return {GXZ * F.CosGRY + V.Z * F.SinGRY, GYZ, V.Z * F.CosGRY - GXZ * F.SinGRY};
+    }
+    /** returns (-999, -999) if there are no constants for the plane */
+    std::pair<float, float> TtoLXY (float const TX, float const TY, int const ch, int const roc) {
+      PlaneFrame const * F = FindFrame(ch, roc);
+      if (F == nullptr) { return std::make_pair(-999, -999); }
+      float const LXA = TX - F->LX, LYA = TY - F->LY;
+      return std::make_pair(LXA * F->CosLR + LYA * F->SinLR, -LXA * F->SinLR + LYA * F->CosLR);
+    }
+    float TtoLX (float const TX, float const TY, int const ch, int const roc) { return TtoLXY(TX, TY, ch, roc).first; }
+    float TtoLY (float const TX, float const TY, int const ch, int const roc) { return TtoLXY(TX, TY, ch, roc).second; }
     static float LX2PX(float lx) { return lx / PLTU::PIXELWIDTH + PLTU::DIACENTERX; }
     static float LY2PY(float ly) { return ly / PLTU::PIXELHEIGHT + PLTU::DIACENTERY; }
 
 
+    /** same transforms with a vector as output */
     void LtoTXYZ (std::vector<float>&, float, float, int, int);
     void LtoGXYZ (std::vector<float>&, float, float, int, int);
     void TtoGXYZ (std::vector<float>&, float, float, float, int, int);
     void GtoTXYZ (std::vector<float>&, float, float, float, int, int);
     void VTtoVGXYZ (std::vector<float>&, float, float, float, int, int);
-    float GetTZ (int, int);
+    float GetTZ (int const ch, int const roc) { return Frame(ch, roc).LZ; }
 
     float PXtoLX (int);
     float PYtoLY (int);
@@ -115,6 +163,23 @@ class PLTAlignment
     std::map< std::pair<int, int>, CP > fConstantMap;
     std::map<int, TelescopeAlignmentStruct> fTelescopeMap;
 
+    /** local, telescope and global coordinates of every pixel of a plane, rebuilt whenever the constants of the plane change */
+    struct PixelCoordinates {
+      float LX, LY;
+      float TX, TY, TZ;
+      float GX, GY, GZ;
+    };
+    struct PixelTable {
+      int Channel = -1;
+      PlaneFrame Frame;
+      std::vector<PixelCoordinates> Pixels;  // index: column * NROW + row
+    };
+    std::vector<PixelTable> fPixelTables;  // index: ROC
+    void UpdatePixelTable (int, int);
+    void UpdatePixelTables ();
+    static PlaneFrame MakeFrame (CP const&);
+    PlaneFrame const * FindFrameSlow (int, int);
+
     std::vector< float > fErrorsX;
     std::vector< float > fErrorsY;
 
@@ -9,6 +9,8 @@
 #include "FileWriterTracking.h"
 #include "Action.h"
 
+#include <mutex>
+
 namespace tel{ class ProgressBar; }
 
 #define verbose 0
@@ -21,8 +23,9 @@ class PLTAnalysis : public Action {
 private:
     uint8_t const telescopeID;
     TFile * out_f;
-    /** measure elapsed time */
-    float now, now1, now2, loop, startProg, endProg, allProg, averTime, speed;
+    /** measure elapsed wall time */
+    double now1, now2;
+    float loop, startProg, endProg, allProg, averTime, speed;
     /** times for counting */
     uint32_t const TimeWidth, StartTime;
     uint32_t ThisTime;
@@ -38,13 +41,25 @@ private:
     bool trackOnlyTelescope;
     std::vector<float> * DiaZ;
     tel::ProgressBar * PBar;
+    /** parallel event loop: the main analysis has shard -1, its shards process the entries [first_entry_, last_entry_] */
+    uint16_t const n_threads_;
+    int16_t const shard_;
+    uint32_t first_entry_, last_entry_;
+    bool last_shard_;
+    /** run split over several processes: this process analyses the part process_shard_ (-1 if the run is not split) */
+    int16_t const process_shard_;
+    uint16_t const n_process_shards_;
+    uint16_t n_drawn_tracks_;
+
+    PLTAnalysis(PLTAnalysis & main, int16_t shard, uint32_t first_entry, uint32_t last_entry, bool last_shard);
 
 public:
 
     /** ============================
      CONSTRUCTOR // DECONSTRUCTOR
      =================================*/
-    PLTAnalysis(std::string const& inFileName, TFile * Out_f,  TString const& runNumber, uint8_t const TelescopeID, bool TrackOnlyTelescope=false, uint64_t max_event_nr=0);
+    PLTAnalysis(std::string const& inFileName, TFile * Out_f,  TString const& runNumber, uint8_t const TelescopeID, bool TrackOnlyTelescope=false, uint64_t max_event_nr=0,
+                uint16_t n_threads=1, int16_t process_shard=-1, uint16_t n_process_shards=1);
     ~PLTAnalysis();
 
 
@@ -52,18 +67,30 @@ public:
      EVENT LOOP
      =================================*/
     void EventLoop();
+    void ProcessEvents();
+    void ParallelEventLoop();
 
 
     /** ============================
      AFTER LOOP -> FINISH
      =================================*/
     void FinishAnalysis();
+    /** add up the histogram files and concatenate the tracking trees of the n_shards processes of a split run */
+    static void MergeShards(std::string const& inFileName, TFile * Out_f, TString const& runNumber, uint8_t TelescopeID, uint16_t n_shards);
+    static std::string ShardFileName(TString const& runNumber, int16_t shard);
+    /** ROOT graphics and the creation of the output files are not thread safe, they are serialised if several runs are analysed in parallel */
+    static std::mutex & RootMutex();
 
 
     /** ============================
      AUXILIARY FUNCTIONS
      =================================*/
-    float getTime(float now, float & time);
+    uint16_t GraphPoint(uint32_t entry) const;
+    uint32_t FirstEntry(uint16_t graph_point) const;
+    /** first entry of the part i out of n of the entries [first, last], split at the borders of the average pulse height points */
+    uint32_t SplitEntry(uint32_t first, uint32_t last, uint32_t i, uint32_t n) const;
+    uint32_t NPoints(uint32_t first, uint32_t last) const;
+    float getTime(double now, float & time);
     void SinglePlaneStudies();
     std::vector<float> * getDiaZPositions();
     void WriteTrackingTree();
@@ -83,4 +110,8 @@ void TestPlaneEfficiency (std::string const InFileName,
                           int telescopeID);
 
 void WriteHTML(TString const& OutDir, int telescopeID);
+
+/** analyse all runs of a list (lines: <InFileName> <telescopeID> (<TrackMode>=0)) with n_workers runs in parallel, the runs of a
+ *  telescope reuse its calibration, alignment and pixel mask. Returns the number of runs which could not be analysed. */
+int AnalyseRunList(std::string const& RunListFileName, uint16_t n_workers, uint16_t n_threads);
 #endif // PLTANALYSIS_H
@@ -11,6 +11,7 @@
 
 #include "PLTHit.h"
 #include "PLTPlane.h"
+#include "PLTPixelMask.h"
 
 
 
@@ -49,7 +50,7 @@ class PLTBinaryFileReader
     int fTimeMult;
     int fFEDID;
 
-    std::set<int> fPixelMask;
+    PLTPixelMask fPixelMask;
 };
 
 
@@ -5,6 +5,7 @@
 
 #include <iostream>
 #include <vector>
+#include <cstdint>
 
 class PLTCluster
 {
@@ -13,6 +14,7 @@ class PLTCluster
     ~PLTCluster ();
 
     void AddHit (PLTHit*);
+    void Clear () { fHits.clear(); fCentersValid = false; }
     float Charge ();
     size_t NHits ();
     PLTHit* Hit (size_t const);
@@ -44,15 +46,25 @@ class PLTCluster
     std::pair<float, float> GCenter ();
 
     // Cluster center
-    std::pair<float, float> CenterOfMass(std::string);
-    std::pair<float, float> LCenterOfMass() { return CenterOfMass("local"); }
-    std::pair<float, float> TCenterOfMass() { return CenterOfMass("telescope"); }
-    std::pair<float, float> GCenterOfMass() { return CenterOfMass("global"); }
+    enum class Frame : uint8_t { Local = 0, Telescope, Global };
+    /** charge weighted centre of the hits, computed for all frames with the first access and kept until the next AddHit */
+    template <Frame F>
+    std::pair<float, float> const & CenterOfMass () {
+      if (not fCentersValid) { ComputeCenters(); }
+      return fCenters[size_t(F)];
+    }
+    std::pair<float, float> LCenterOfMass() { return CenterOfMass<Frame::Local>(); }
+    std::pair<float, float> TCenterOfMass() { return CenterOfMass<Frame::Telescope>(); }
+    std::pair<float, float> GCenterOfMass() { return CenterOfMass<Frame::Global>(); }
 
 
   private:
     std::vector<PLTHit*> fHits;  // The seed hit needs to be 0 in this vector
 
+    void ComputeCenters ();
+    bool fCentersValid = false;
+    std::pair<float, float> fCenters[3];
+
 };
 
 
@@ -0,0 +1,51 @@
+#ifndef GUARD_PLTEventArena_h
+#define GUARD_PLTEventArena_h
+
+#include <deque>
+
+#include "PLTHit.h"
+#include "PLTCluster.h"
+#include "PLTTrack.h"
+
+
+/** Objects of one type which are handed out during an event and all given back at once.
+ *  The objects are never destroyed before the pool, so their addresses stay valid and their
+ *  vectors keep the capacity of earlier events. */
+template <typename T>
+class PLTObjectPool
+{
+  public:
+    T* Get ()
+    {
+      if (fNUsed == fObjects.size()) {
+        fObjects.emplace_back();
+      }
+      return &fObjects[fNUsed++];
+    }
+    void Reset () { fNUsed = 0; }
+    size_t NUsed () const { return fNUsed; }
+    size_t Capacity () const { return fObjects.size(); }
+
+  private:
+    std::deque<T> fObjects;
+    size_t fNUsed = 0;
+};
+
+
+/** Owns all hits, clusters and tracks of the current event. Reset() only rewinds the pools,
+ *  the objects are cleared when they are handed out again. */
+class PLTEventArena
+{
+  public:
+    PLTHit* NewHit (int const Channel, int const ROC, int const Column, int const Row, int const ADC);
+    PLTCluster* NewCluster ();
+    PLTTrack* NewTrack ();
+    void Reset ();
+
+  private:
+    PLTObjectPool<PLTHit> fHits;
+    PLTObjectPool<PLTCluster> fClusters;
+    PLTObjectPool<PLTTrack> fTracks;
+};
+
+#endif
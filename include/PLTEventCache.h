@@ -0,0 +1,53 @@
+#ifndef GUARD_PLTEventCache_h
+#define GUARD_PLTEventCache_h
+
+#include <cstdio>
+#include <cstdint>
+#include <vector>
+
+#include "PLTHit.h"
+
+
+/** Compact copy of the decoded (masked and gain calibrated) hits of all events of a run.
+ *  The hits are stored before alignment, so they can be replayed with changed alignment constants
+ *  without reading and calibrating the input file again. Hits beyond the memory budget are
+ *  written to a temporary file which is read back sequentially. */
+class PLTEventCache
+{
+  public:
+    explicit PLTEventCache (uint64_t max_memory_mb = 1024);
+    ~PLTEventCache ();
+
+    struct Hit {
+      int8_t ROC;
+      int8_t Column;
+      int8_t Row;
+      int16_t ADC;
+      float Charge;
+    };
+
+    void AddEvent (const std::vector<PLTHit*>&);
+    void Close ();
+    void Rewind ();
+    bool NextEvent (const Hit *& hits, uint16_t & n_hits);
+
+    bool IsComplete () const { return fComplete and not fFailed; }
+    bool IsGood () const { return not fFailed; }
+    size_t NEvents () const { return fNHits.size(); }
+    uint64_t MemoryUsage () const { return fHits.size() * sizeof(Hit) + fNHits.size() * sizeof(uint16_t); }
+
+  private:
+    uint64_t const fMaxHits;        // maximum number of hits kept in memory
+    std::vector<Hit> fHits;         // hits of the first fNMemoryEvents events
+    std::vector<uint16_t> fNHits;   // number of hits for every event
+    size_t fNMemoryEvents;
+    std::FILE * fSpillFile;         // hits of the remaining events
+    std::vector<Hit> fBuffer;
+
+    bool fComplete;
+    bool fFailed;
+    size_t fAtEvent;
+    size_t fAtHit;
+};
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef GUARD_PLTEventGenerator_h
+#define GUARD_PLTEventGenerator_h
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include "TRandom3.h"
+
+#include "PLTAlignment.h"
+#include "PLTGainCal.h"
+
+
+/** Toy Monte Carlo of the telescope: straight tracks with multiple scattering in the planes of the geometry given by the
+ *  alignment, charge sharing between the pixels, noise hits and the pulse heights of the calibration. The events are
+ *  written in the format of the converted beam test files, so they can be read by PSIRootFileReader, together with the
+ *  true track parameters. */
+class PLTEventGenerator
+{
+  public:
+    struct Settings {
+      uint32_t NEvents = 100000;
+      float TracksPerEvent = 1;        // mean of the Poisson distributed number of tracks, sets the occupancy
+      float NoiseHitsPerPlane = .05;   // mean number of noise hits per plane and event
+      float Momentum = .26;            // beam momentum [GeV/c] (pions)
+      float PlaneX0 = .005;            // material of one plane in radiation lengths
+      float BeamSigma = .15;           // beam spot [cm]
+      float Divergence = 1e-3;         // beam divergence [rad]
+      float ChargeMPV = 22000;         // most probable deposited charge [e]
+      float ChargeSigma = 2000;        // width of the Landau distribution [e]
+      float ChargeCloud = .0012;       // sigma of the charge cloud at the pixel implants [cm]
+      float Threshold = 1500;          // pixel threshold [e]
+      uint32_t Seed = 1;
+      std::string CalibrationPath;     // directory with the ROC<i>.txt calibration files, the telescope's one if empty
+    };
+
+    PLTEventGenerator (Settings const&);
+    ~PLTEventGenerator () = default;
+
+    void Generate (std::string const& OutFileName);
+
+  private:
+    static constexpr int MAXHITS = 255;  // size of the hit arrays of PSIRootFileReader
+
+    struct Pixel {
+      uint8_t ROC, Column, Row;
+      float Charge;
+    };
+    struct Track {
+      float X, Y, SlopeX, SlopeY;  // at z = 0 in telescope coordinates
+    };
+
+    Track NewTrack ();
+    void TrackHits (Track const&, std::vector<Pixel>&);
+    void DepositCharge (int, float, float, float, std::vector<Pixel>&);
+    void NoiseHits (std::vector<Pixel>&);
+
+    Settings const fSettings;
+    uint16_t const fNPlanes;
+    std::vector<uint16_t> fPlaneOrder;  // planes sorted in z
+    std::vector<float> fResolutionX, fResolutionY;  // intrinsic resolution: plane errors without the binary resolution
+    float fScatteringAngle;
+    PLTAlignment fAlignment;
+    PLTGainCal fGainCal;
+    TRandom3 fRandom;
+};
+
+#endif
@@ -22,14 +22,19 @@ class PLTGainCal {
 
 public:
   PLTGainCal ();
-  PLTGainCal (int, bool); // number of ROCs, isExternalFunction
+  PLTGainCal (int, bool, bool=false); // number of ROCs, isExternalFunction, useLookupTable
   PLTGainCal (const std::string&, int);
   ~PLTGainCal () = default;
 
   static int const DEBUGLEVEL = 0;
+  static bool UseCache;  // load external calibrations from the binary cache next to the calibration file if it matches the file, write it otherwise
 
   void SetCharge(PLTHit &Hit) { Hit.SetCharge(GetCharge(Hit.Channel(), Hit.ROC(), Hit.Column(), Hit.Row(), Hit.ADC())); }
   float GetCharge(int ch, int roc, int col, int row, int adc);
+  int GetADC(int ch, int roc, int col, int row, float charge);  // inverse of GetCharge for the external calibration
+  /** Calibrates the hits of a whole event (channel 1) given as arrays: charge[i] of the pixel (roc[i], col[i], row[i]) with
+   *  the pulse height adc[i]. Pixels outside the calibration get the same default charge as in GetCharge. */
+  void GetCharges(size_t n, const uint8_t * roc, const uint8_t * col, const uint8_t * row, const int16_t * adc, float * charge);
 
   void ReadGainCalFile (const std::string & GainCalFileName, int=0);
   void ReadGainCalFile3 (const std::string & GainCalFileName);
@@ -52,6 +57,12 @@ public:
 
   void ResetGC ();
 
+  /** ADC -> vcal lookup table for the external (Erf) calibration, inverted once at load time */
+  void SetUseLookupTable(bool use) { fUseLookupTable = use; }
+  bool UseLookupTable () const { return fUseLookupTable; }
+  void BuildLookupTable (int roc);
+  int CheckLookupTable (int roc);
+
 
 private:
   bool fIsGood = false;
@@ -59,6 +70,18 @@ private:
 
   int  fNParams {}; // how many parameters for this gaincal
   TF1 fFitFunction;
+  std::string fFormula;  // of the fit function of the external calibration
+  void SetFitFunction (const std::string & Formula);
+
+  bool fUseLookupTable = false;
+  struct LUTPixel {
+    int16_t MinADC = 1;  // first and last adc value with a valid charge, empty if MinADC > MaxADC
+    int16_t MaxADC = 0;
+    uint32_t Offset = 0;  // position of MinADC in the lookup table of the ROC
+  };
+  std::vector<std::vector<LUTPixel>> fLUTPixels;  // [roc][icol * NROW + irow]
+  std::vector<std::vector<float>> fLUT;  // [roc] vcal of all valid adc values of all pixels
+  double InvertFitFunction(double adc, double lo, double hi) const;
 
   static int const MAXCHNS =   1;
   static int const MAXROWS =  80;
@@ -69,10 +92,33 @@ private:
 
   int const NROCS = 6;
 
-  // Switched from float GC[NCHNS][NROCS][NCOLS][NROWS][6]
-  std::vector<std::vector<std::vector<std::vector<std::vector<float > > > > > GC;
+  /** parameters of all pixels in one contiguous block: GC[NCHNS][NROCS][NCOLS][NROWS][NPARS] */
+  static int const NPARS = 5;
+  std::vector<float> GC;
+  float & Par (int ich, int iroc, int icol, int irow, int ipar) {
+    return GC[(((size_t(ich) * NROCS + iroc) * PLTU::NCOL + icol) * PLTU::NROW + irow) * NPARS + ipar];
+  }
   std::vector<std::pair<float, float>> VC;  // VCal Calibration
 
+  /** binary cache of an external calibration file: the header, the formula, the parameters of all pixels of the ROC and its lookup table */
+  struct CacheHeader {
+    char Magic[8];
+    uint32_t Version;
+    uint32_t UseLookupTable;
+    uint64_t SourceHash;     // of the calibration file
+    int32_t NParams;
+    uint32_t FormulaSize;
+    uint32_t NPixelPars;     // NCOL * NROW * NPARS
+    uint32_t NLUTPixels;     // 0 if the ROC has no lookup table
+    uint64_t NLUT;
+  };
+  static constexpr uint32_t CacheVersion = 1;
+  static constexpr uint32_t MaxFormulaSize = 4096;
+  static uint64_t SourceHash (const std::string & FileName);
+  std::string CacheFileName (const std::string & GainCalFileName) const { return GainCalFileName + (fUseLookupTable ? ".lut.cache" : ".cache"); }
+  bool ReadCache (const std::string & GainCalFileName, int roc, uint64_t Hash);
+  void WriteCache (const std::string & GainCalFileName, int roc, uint64_t Hash);
+
 
   // Map for hardware locations by fed channel
   std::map<int, int> fHardwareMap;
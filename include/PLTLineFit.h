@@ -0,0 +1,41 @@
+#ifndef GUARD_PLTLineFit_h
+#define GUARD_PLTLineFit_h
+
+#include <cassert>
+#include <cstddef>
+
+
+/** Weighted least squares fit of a straight line v = slope * z + offset from accumulated sums. The points are kept
+ *  to compute the chi2 directly from the residuals, which does not suffer from the cancellation of the sums. */
+class PLTLineFit
+{
+  public:
+    static size_t const MaxPoints = 16;  // more than the planes of any telescope
+
+    void Add (double const z, double const v, double const err) {
+      if (err <= 0) { return; }  // points without error are skipped, as in TGraphErrors::Fit (e.g. the fixed plane of the alignment)
+      assert(N < MaxPoints);
+      double const w = 1. / (err * err);
+      Z[N] = z; V[N] = v; W[N] = w; ++N;
+      S += w; Sz += w * z; Sv += w * v; Szz += w * z * z; Szv += w * z * v;
+    }
+    void Solve () {
+      double const D = S * Szz - Sz * Sz;
+      Slope = D != 0 ? (S * Szv - Sz * Sv) / D : 0;
+      Offset = D != 0 ? (Szz * Sv - Sz * Szv) / D : (S != 0 ? Sv / S : 0);
+      Chi2 = 0;
+      for (size_t i = 0; i != N; ++i) {
+        double const r = V[i] - Slope * Z[i] - Offset;
+        Chi2 += W[i] * r * r;
+      }
+    }
+
+    double Slope = 0, Offset = 0, Chi2 = 0;
+
+  private:
+    double S = 0, Sz = 0, Sv = 0, Szz = 0, Szv = 0;
+    double Z[MaxPoints], V[MaxPoints], W[MaxPoints];
+    size_t N = 0;
+};
+
+#endif
@@ -0,0 +1,55 @@
+#ifndef GUARD_PLTPixelMask_h
+#define GUARD_PLTPixelMask_h
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+#include "PLTU.h"
+
+
+/** Dense mask of the pixels of all ROCs: one byte per pixel in a NCOL x NROW map for every (channel, ROC).
+ *  Masked columns and rows are expanded when they are added, so a lookup is a single array access. */
+class PLTPixelMask
+{
+  public:
+    static int const MAXROC = 10;      // ROC numbers are below 10 (packed key ch*100000 + roc*10000 + col*100 + row)
+    static int const MAXCHANNEL = 100;
+
+    void Add (int, int, int, int);
+    void AddColumn (int, int, int);
+    void AddRow (int, int, int);
+    void Clear ();
+
+    bool IsMasked (int const Channel, int const ROC, int const Col, int const Row) const
+    {
+      uint8_t const * Map = GetMap(Channel, ROC);
+      return Map != nullptr and InRange(Col, Row) and Map[Col * PLTU::NROW + Row];
+    }
+    bool IsMasked (int const ChannelPixel) const
+    {
+      return IsMasked(ChannelPixel / 100000, (ChannelPixel % 100000) / 10000, (ChannelPixel % 10000) / 100, ChannelPixel % 100);
+    }
+
+    /** Batch filter for the hit arrays of one event: writes the indices of the hits which are not masked to Good
+     *  and returns their number. */
+    size_t Filter (int, uint8_t const*, uint8_t const*, uint8_t const*, size_t, uint16_t*) const;
+
+    size_t NMasked () const;
+    std::vector<int> GetMaskedPixels () const;  // packed keys ch*100000 + roc*10000 + col*100 + row
+
+  private:
+    static bool InRange (int const Col, int const Row) { return Col >= 0 and Col < PLTU::NCOL and Row >= 0 and Row < PLTU::NROW; }
+    uint8_t const * GetMap (int const Channel, int const ROC) const
+    {
+      size_t const i = size_t(Channel) * MAXROC + size_t(ROC);
+      return (Channel >= 0 and ROC >= 0 and ROC < MAXROC and i < fMaps.size() and not fMaps[i].empty()) ? fMaps[i].data() : nullptr;
+    }
+    uint8_t * MakeMap (int, int);
+
+    std::vector<std::vector<uint8_t> > fMaps;  // index: channel * MAXROC + ROC, empty if nothing is masked
+};
+
+
+
+#endif
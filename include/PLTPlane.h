@@ -10,6 +10,7 @@
 
 #include "TH2F.h"
 
+class PLTEventArena;
 
 class PLTPlane
 {
@@ -77,10 +78,25 @@ class PLTPlane
 
     void SetChannel (int const);
     void SetROC (int const);
+    void SetArena (PLTEventArena* Arena) { fArena = Arena; }
 
     void Clear ();
     void CheckDoubleClassification();
 
+    static bool UseGridClustering;  // use the pixel occupancy grid for AllTouching and Seed NxN clustering
+
+  private:
+    /** pixel occupancy grid (NCOL x NROW) with the indices of fHits, shared by all planes of a thread */
+    bool FillHitGrid ();
+    void ClearHitGrid ();
+    int  NextTouchingHit (int, int);
+    void ClusterizeAllTouchingGrid ();
+    void ClusterizeFromSeedNxNGrid (int const, int const, FiducialRegion const);
+    bool IsBiggestHitInNxNGrid (int, int const, int const);
+    void AddClusterFromSeedNxNGrid (int, int const, int const);
+    void AddToCluster (PLTCluster*, int);
+    PLTCluster* NewCluster ();
+
   protected:
     int fChannel;
     int fROC;
@@ -89,6 +105,7 @@ class PLTPlane
     std::vector<PLTHit*> fClusterizedHits;
     std::vector<PLTHit*> fUnclusteredHits;
     std::vector<PLTCluster*> fClusters;
+    PLTEventArena* fArena = nullptr;  // owner of the clusters if set, otherwise the plane owns them
 
 };
 
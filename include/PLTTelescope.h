@@ -43,6 +43,7 @@ class PLTTelescope
     std::vector<PLTTrack*> fTracks;
     std::vector<float> fSignal;
     int fChannel;
+    bool fOwnsTracks;  // false if the tracks belong to an event arena
 
 
 };
@@ -4,6 +4,7 @@
 #include <vector>
 #include <iostream>
 #include <math.h>
+#include <algorithm>
 
 #include "TGraph.h"
 #include "TGraphErrors.h"
@@ -24,6 +25,7 @@ class PLTTrack
     ~PLTTrack ();
 
     void AddCluster (PLTCluster*);
+    void Clear () { fClusters.clear(); fLResidualX.clear(); fLResidualY.clear(); }
     int  MakeTrack (PLTAlignment&, int);
 
     size_t NClusters() { return fClusters.size(); }
@@ -95,6 +97,7 @@ class PLTTrack
     float fD2, fChi2, fChi2X, fChi2Y;
 
     static bool const DEBUG = false;
+    static bool UseRootFit;  // fit tracks with >2 clusters with TGraphErrors::Fit instead of the analytic least squares (validation)
 
 };
 
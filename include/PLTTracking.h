@@ -9,6 +9,7 @@
 
 #include "PLTTelescope.h"
 #include "PLTAlignment.h"
+#include "PLTEventArena.h"
 #include "PLTU.h"
 
 
@@ -28,6 +29,7 @@ class PLTTracking
     ~PLTTracking ();
 
     void SetTrackingAlignment (PLTAlignment*);
+    void SetTrackingArena (PLTEventArena* Arena) { fArena = Arena; }
     void SetTrackingAlgorithm (TrackingAlgorithm const);
     int  GetTrackingAlgorithm ();
     static bool CompareTrackD2 (PLTTrack*, PLTTrack*);
@@ -38,6 +40,7 @@ class PLTTracking
     void SetPlanesUnderTest(const std::vector<unsigned short>&); // 330033
     void SetPlaneUnderTestSandwich(int); // 303000
     bool IsPlaneUnderTest(unsigned i_plane) { return fUsePlanesForTracking.at(i_plane) == 0; }
+    bool IsPlaneRequired(unsigned i_plane) { return fUsePlanesForTracking.at(i_plane) >= 2; }
 
     void RunTracking (PLTTelescope&);
 
@@ -47,11 +50,20 @@ class PLTTracking
 
     void SortOutTracksNoOverlapBestD2(std::vector<PLTTrack*>&);
 
+    static bool UseRoadSearch;  // combine only the clusters inside a road around seeds from the outer planes instead of all combinations (approximate, off by default)
+    static float const RoadWidth;  // half width of the road in units of the plane errors
+
     bool DoingSinglePlaneEfficiency(){ return fDoSinglePlaneEfficiency; }
 
 
   private:
     PLTAlignment* fAlignment;
+    PLTEventArena* fArena = nullptr;  // owner of the tracks if set, otherwise the telescope owns them
+    PLTTrack* NewTrack () { return fArena != nullptr ? fArena->NewTrack() : new PLTTrack(); }
+    void MakeTrackCandidates (std::vector<std::vector<PLTCluster*> > const&, int, std::vector<PLTTrack*>&);
+    void AddAllCombinations (std::vector<std::vector<PLTCluster*> > const&, int, std::vector<PLTTrack*>&);
+    std::vector<std::vector<std::pair<float, size_t> > > fRoadIndex;  // (TX, index in the plane) of the clusters of each tracking plane sorted in TX
+    std::vector<size_t> fRoadSelection;  // indices of the clusters inside the road of one plane
 
 
      /**Which planes to use for tracking
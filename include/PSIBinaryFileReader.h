@@ -19,6 +19,8 @@ class PSIBinaryFileReader : public PSIFileReader
     bool ReadAddressesFromFile (std::string const);
 
     unsigned short readBinaryWordFromFile ();
+    static int HeaderCode (unsigned short word);
+    size_t FindNextHeader (size_t pos) const;
     int nextBinaryHeader ();
     int decodeBinaryData ();
     int GetNextEvent ();
@@ -30,15 +32,25 @@ class PSIBinaryFileReader : public PSIFileReader
 
     void DrawWaveform(TString const);
 
+  protected:
+    void ClusterizeAndTrack () override;
+
   private:
     int fHeader;
     int fNextHeader;
 
     static int const MAXNDATA = 2000;
-    int fBuffer[MAXNDATA];
+    unsigned short fBuffer[MAXNDATA];
+    const unsigned short * fEventWords;  // words of the current event, points into fBuffer or the mapped file
     int fBufferSize;
     bool fEOF;
     std::ifstream fInputBinaryFile;
+    /** memory mapped input, the stream is only used if the file cannot be mapped */
+    void * fMappedFile;
+    size_t fMappedSize;
+    const unsigned short * fMappedWords;
+    size_t fNMappedWords;
+    size_t fMappedPos;
     unsigned int fUpperTime;
     unsigned int fLowerTime;
 
@@ -3,19 +3,23 @@
 
 #include <fstream>
 #include <set>
+#include <memory>
 
 #include "PLTTelescope.h"
 #include "PLTGainCal.h"
 #include "PSIGainInterpolator.h"
 #include "PLTAlignment.h"
 #include "PLTTracking.h"
+#include "PLTEventCache.h"
+#include "PLTEventArena.h"
+#include "PLTPixelMask.h"
 
 class PSIFileReader : public PLTTelescope, public PLTTracking
 {
 
 public:
     PSIFileReader(bool track_only_telescope);
-    virtual ~PSIFileReader() = default;
+    virtual ~PSIFileReader();
 
     virtual bool OpenFile () = 0;
     virtual void ResetFile () = 0 ;
@@ -25,10 +29,16 @@ public:
     void ReadPixelMask (std::string const);
     void AddToPixelMask( int, int, int, int);
     bool IsPixelMasked (int const);
+    bool IsPixelMasked (int const ch, int const roc, int const col, int const row) const { return fPixelMask.IsMasked(ch, roc, col, row); }
 
     void DrawTracksAndHits (std::string const);
 
     virtual int GetNextEvent () = 0;
+    /** Two-phase read for the modes which only use tracked events: events which cannot have a hit in all required planes
+     *  (bit mask, -1 for the planes required by the configured tracking) with at most MaxMissing exceptions are returned
+     *  empty without decoding their hits. Only implemented by the readers which can load the hit planes separately. */
+    virtual void SetPrefilter (bool, int=-1, uint16_t=0) { }
+    int GetNextCachedEvent (PLTEventCache&);
     virtual unsigned GetEntries() = 0;
     virtual void CloseFile() = 0;
 
@@ -37,11 +47,17 @@ public:
 
     PLTGainCal * GetGainCal () { return &fGainCal; }
     PLTAlignment * GetAlignment() { return &fAlignment; }
-    const std::set<int> * GetPixelMask(){ return &fPixelMask; }
+    const PLTPixelMask * GetPixelMask(){ return &fPixelMask; }
+
+    static bool KeepCalibrations;  // keep the calibration, alignment and pixel masks of a telescope for the readers of further runs (batch mode)
 
 protected:
 
-    std::set<int> fPixelMask;
+    /** clusterize the planes of the current event and run the tracking */
+    virtual void ClusterizeAndTrack () = 0;
+
+    PLTPixelMask fPixelMask;
+    PLTEventArena fArena;  // storage of the hits, clusters and tracks of the current event
     std::vector<PLTHit*> fHits;
 
     PSIGainInterpolator fGainInterpolator;
@@ -50,13 +66,24 @@ protected:
 
     std::string fBinaryFileName;
 
-    std::map<int, PLTPlane> fPlaneMap;
+    std::vector<PLTPlane> fPlaneArray;  // one plane per ROC, set up once and cleared in place for every event
+    PLTPlane * PlaneOf (int const roc) { return (roc >= 0 and roc < fNPlanes) ? &fPlaneArray[roc] : nullptr; }
 
     std::string fBaseCalDir;
 
     std::vector<std::string> fCalibrationFile;
     std::vector<std::string> fRawCalibrationFile;
 
+private:
+    /** everything read from the calibration and alignment files of the configured telescope */
+    struct Calibration {
+      PLTGainCal GainCal;
+      PSIGainInterpolator GainInterpolator;
+      PLTAlignment Alignment;
+    };
+    static std::shared_ptr<const Calibration> LoadCalibration ();
+    PSIFileReader (bool, Calibration const&);
+
 };
 
 
@@ -19,21 +19,40 @@ class PSIRootFileReader : public PSIFileReader
     void ResetFile () override;
     int GetNextEvent () override;
     void CloseFile() override;
-    unsigned GetEntries() override { return fTree->GetEntries(); }
+    unsigned GetEntries() override { return unsigned(fNEntries - fFirstEntry); }  // entries in the selected range
+    void GoToEntry(int entry);
+    /** restrict the reader to the entries [first, last], also after ResetFile (last < 0: until the end of the tree) */
+    void SetEntryRange(int first, int last);
+    void SetPrefilter(bool use, int required_planes=-1, uint16_t max_missing=0) override;
+
+    /** pulse heights of all hits of the current entry, calibrated by the reader (the tree buffer on disk may be empty) */
+    const float * Charges() const { return f_charge; }
+    uint16_t NHitsTotal() const { return f_n_hits; }
 
     // Make tree accessible
     TTree * fTree;
     TMacro * fMacro;
     TFile * fRootFile;
 
+  protected:
+    void ClusterizeAndTrack () override;
+
   private:
     std::string fFileName;
 
+    /** planes which need a hit for the configured tracking */
+    int TrackingPlaneBits();
+    /** loads only the plane branch and checks whether the event can pass the tracking */
+    bool PassesPrefilter();
+    void ApplyEntryRange();
+
     const bool fOnlyAlign;
 
-    //  Current entry and total number of entries
+    //  Current entry and end of the selected entry range
     int fAtEntry;
     int fNEntries;
+    int fFirstEntry;
+    int fLastEntry;
 
     // Scalar Branches
     int32_t f_event_number;
@@ -47,6 +66,15 @@ class PSIRootFileReader : public PSIFileReader
     int16_t f_adc[UINT8_MAX + 1] {};
     float f_charge[UINT8_MAX + 1] {};
     float f_signal[UINT8_MAX + 1] {};
+
+    // Branches of the two-phase read
+    bool fUsePrefilter;
+    int fPrefilterPlanes;
+    uint16_t fPrefilterMaxMissing;
+    TBranch * fBranchNHits;
+    TBranch * fBranchPlane;
+    std::vector<TBranch*> fEventBranches;
+    std::vector<TBranch*> fHitBranches;
 };
 
 #endif
@@ -102,6 +102,7 @@ public:
      CONSTRUCTOR
      =================================*/
     RootItems(TString const RunNumber);
+    RootItems(const RootItems &, uint16_t shard);  // empty copy of all filled items for one thread of a parallel analysis
     ~RootItems();
 
 
@@ -156,6 +157,11 @@ public:
      MAIN FUNCTIONS
      =================================*/
      void SaveAllHistos();
+     void Merge(const RootItems &);
+     void MergeAveragePH(const RootItems &, uint16_t first_point, uint16_t n_points);
+     /** runs split over several processes: each process writes its items to a shard file, the shards are added in the order of the entries */
+     void WriteShard(TFile *, uint16_t first_point, uint16_t n_points);
+     void AddShard(TFile *);
 
 
     /** ============================
@@ -178,6 +184,13 @@ public:
     void DrawSaveChi2(TH1F*, TString);
     std::vector<std::vector<TGraphErrors*> > FillVecAvPH(std::vector<std::vector<TGraphErrors*> >);
     void AllocateArrAvPH();
+    template <typename T>
+    static std::vector<T*> CloneVector(const std::vector<T*> &, uint16_t shard);
+    template <typename T>
+    static T * GetShardItem(TFile *, const std::string & name);
+    std::vector<TH1*> MergeableHistos() const;
+    void AddAveragePH2D(uint16_t iRoc, uint16_t iCol, uint16_t iRow, double mean, int n);
+    void CopyAveragePH(const std::vector<std::vector<TGraphErrors*> > &, uint16_t first_point, uint16_t n_points);
     std::vector<TH2F*> FillVecResidual(std::vector<TH2F*>, TString name, uint16_t, float, float, uint16_t, float, float);
     /** Draw & Save */
     void DrawSaveCoincidence();
@@ -0,0 +1,61 @@
+#ifndef TRACKINGTELESCOPE_STAGETIMER_H
+#define TRACKINGTELESCOPE_STAGETIMER_H
+
+#include <chrono>
+#include <string>
+#include <cstdint>
+
+namespace tel {
+
+  /** stages of the event pipeline with their own wall time accumulators */
+  enum class Stage : uint8_t { Read = 0, Mask, GainCal, Align, Clusterize, Tracking, HistoFill, WriteTree, N };
+  const char * stage_name(Stage);
+
+  /** seconds of a monotonic wall clock */
+  double wall_time();
+
+  /** Per-thread accumulators of the time spent in each stage. Every thread adds to its own counters without locking,
+   *  the counters of finished threads are added to the totals when the thread exits. */
+  class StageTimer {
+  public:
+    using Clock = std::chrono::steady_clock;
+    static constexpr size_t NStages = size_t(Stage::N);
+
+    /** accumulator of the calling thread */
+    static StageTimer & local();
+    void add(Stage stage, Clock::duration duration) {
+      ns_[size_t(stage)] += uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count());
+      ++calls_[size_t(stage)];
+    }
+
+    /** sum over all threads, must not be called while other threads are timing */
+    static void reset();
+    static void print(const std::string & action, double wall);
+    static void writeJSON(const std::string & file_name, const std::string & action, double wall);
+
+    StageTimer();
+    ~StageTimer();
+    StageTimer(const StageTimer &) = delete;
+    StageTimer & operator=(const StageTimer &) = delete;
+
+  private:
+    uint64_t ns_[NStages];
+    uint64_t calls_[NStages];
+    static void collect(uint64_t * ns, uint64_t * calls);
+  };
+
+  /** adds the time until the end of the scope to the stage */
+  class ScopedStage {
+  public:
+    explicit ScopedStage(Stage stage): stage_(stage), start_(StageTimer::Clock::now()) {}
+    ~ScopedStage() { StageTimer::local().add(stage_, StageTimer::Clock::now() - start_); }
+    ScopedStage(const ScopedStage &) = delete;
+    ScopedStage & operator=(const ScopedStage &) = delete;
+
+  private:
+    Stage const stage_;
+    StageTimer::Clock::time_point const start_;
+  };
+}
+
+#endif //TRACKINGTELESCOPE_STAGETIMER_H
@@ -30,6 +30,7 @@ namespace tel{
   void print_banner(const std::string &message, char seperator='-');
   static size_t count_ = 0;
   void print_debug(std::string="", bool=false, uint8_t=4);
+  std::string pop_option(std::vector<std::string> & args, const std::string & name, const std::string & default_value);
 
 
   class ProgressBar {
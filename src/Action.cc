@@ -5,11 +5,14 @@
 #include "Action.h"
 #include <utility>
 #include "GetNames.h"
+#include "Utils.h"
 #include "PSIRootFileReader.h"
 #include "PSIBinaryFileReader.h"
 
 using namespace std;
 
+pair<uint32_t, int64_t> Action::entry_range_ = make_pair(0, -1);
+
 Action::Action(string file_name, const TString & run_number): in_file_name_(move(file_name)), run_number_(run_number), FR(nullptr) {
 
 }
@@ -17,8 +20,11 @@ Action::Action(string file_name, const TString & run_number): in_file_name_(move
 PSIFileReader * Action::InitFileReader() const {
   PSIFileReader * tmp;
   if (IsROOTFile(in_file_name_)){
-    tmp = new PSIRootFileReader(in_file_name_, false, true);
+    auto * reader = new PSIRootFileReader(in_file_name_, false, true);
+    if (entry_range_.first > 0 or entry_range_.second >= 0) { reader->SetEntryRange(int(entry_range_.first), int(entry_range_.second)); }
+    tmp = reader;
   } else {
+    if (entry_range_.first > 0 or entry_range_.second >= 0) { tel::warning("Entry ranges are only supported for ROOT files, reading all events"); }
     tmp = new PSIBinaryFileReader(in_file_name_);
   }
   tmp->GetAlignment()->SetErrors(tel::Config::telescope_id_, true);
@@ -6,21 +6,25 @@
 #include "GetNames.h"
 #include "TestPlaneEfficiencySilicon.h"
 #include "PLTPlane.h"
+#include "PLTLineFit.h"
 
 using namespace std;
 
 Alignment::Alignment(const string & in_file_name, const TString & run_number, uint16_t telescope_id, bool only_tel, uint16_t max_steps,
-                     float max_res, float max_angle, uint32_t max_events, int16_t sil_dut_roc):
+                     float max_res, float max_angle, uint32_t max_events, int16_t sil_dut_roc, bool save_plots, bool global):
   Action(in_file_name, run_number),
   telescope_id_(telescope_id),
   n_planes_(GetNPlanes()),
   align_only_telescope_(only_tel),
   at_step_(0),
   alignment_finished_(false),
+  save_plots_(save_plots),
+  global_(global),
   plots_dir_(GetPlotDir() + run_number),
   file_type_(".png"),
   angle_thresh_(max_angle),
   res_thresh_(max_res),
+  event_cache_(GetEventCacheMemory()),
   now_(clock()),
   maximum_steps_(max_steps),
   sil_dut_roc_(sil_dut_roc),
@@ -42,6 +46,12 @@ Alignment::Alignment(const string & in_file_name, const TString & run_number, ui
     inner_planes_ = vector<uint16_t>(ordered_planes_.begin() + 1, ordered_planes_.end() - 1);
     cout << "Inner planes: " << tel::to_string(inner_planes_) << endl;
 
+    if (global_) {
+      delete FR;
+      GlobalAlign();
+      return;
+    }
+
     while (not alignment_finished_) {
 
       SetPlanes();
@@ -65,7 +75,8 @@ Alignment::Alignment(const string & in_file_name, const TString & run_number, ui
 
       /** Apply Masking */
       FR->ReadPixelMask(GetMaskingFilename());
-      InitHistograms();
+      FR->SetPrefilter(true, TelescopePlaneBits());  /** only events with one cluster in all telescope planes are used */
+      if (save_plots_) { InitHistograms(); }
 
       cout << "\nStarting with Alignment: " << endl;
       PrintAlignment();
@@ -123,8 +134,9 @@ void Alignment::SetNextAlignmentStep() {
 
 void Alignment::EventLoop(const std::vector<uint16_t> & planes) {
   ProgressBar->reset();
-  ResetHistograms(); /** Reset residual histograms */
-  for (uint32_t i_event = 0; FR->GetNextEvent() >= 0; ++i_event) {
+  if (save_plots_) { ResetHistograms(); } /** Reset residual histograms */
+  residual_moments_.assign(n_planes_, ResidualMoments());
+  for (uint32_t i_event = 0; FR->GetNextCachedEvent(event_cache_) >= 0; ++i_event) {
     if (i_event >= max_event_number_) { break; }
     ++*ProgressBar; /** print progress */
 
@@ -145,20 +157,21 @@ void Alignment::EventLoop(const std::vector<uint16_t> & planes) {
       if (fdX.at(i_plane).second > 0 and fdY.at(i_plane).second > 0) {  // only check if the mean residual is not 0
         if (sqrt(pow(dR.first / fdX.at(i_plane).second, 2) + pow(dR.second / fdY.at(i_plane).second, 2)) > n_sigma_) { continue; } }
 
-      hResidual[i_plane].Fill(dR.first, dR.second); // dX vs dY
-      hResidualXdY[i_plane].Fill(Cluster->LX(), dR.second); // X vs dY
-      hResidualYdX[i_plane].Fill(Cluster->LY(), dR.first); // Y vs dX
+      residual_moments_[i_plane].Add(Cluster->LX(), Cluster->LY(), dR.first, dR.second);
+      if (save_plots_) {
+        hResidual[i_plane].Fill(dR.first, dR.second); // dX vs dY
+        hResidualXdY[i_plane].Fill(Cluster->LX(), dR.second); // X vs dY
+        hResidualYdX[i_plane].Fill(Cluster->LY(), dR.first); // Y vs dX
+      }
     }
   }
+  event_cache_.Close();
+  /** offsets and angles from the unbinned statistics: mean residuals and slopes of the linear regressions */
   for (auto i_plane: planes) {
-    fdX.at(i_plane) = make_pair(hResidual.at(i_plane).GetMean(1), hResidual.at(i_plane).GetRMS(1));
-    fdY.at(i_plane) = make_pair(hResidual.at(i_plane).GetMean(2), hResidual.at(i_plane).GetRMS(2));
-
-    pair<pair<float, float>, pair<float, float>> range = GetFitRange(i_plane);
-    TF1 fX = TF1("fX", "pol1"), fY = TF1("fY", "pol1");
-    hResidualXdY[i_plane].Fit(&fX, "q", "", range.first.first, range.first.second);
-    hResidualYdX[i_plane].Fit(&fY, "q", "", range.second.first, range.second.second);
-    fdA.at(i_plane) = make_pair(atan(fX.GetParameter(1)), atan(fY.GetParameter(1)));
+    const ResidualMoments & M = residual_moments_.at(i_plane);
+    fdX.at(i_plane) = make_pair(M.MeanDX, M.RMSDX());
+    fdY.at(i_plane) = make_pair(M.MeanDY, M.RMSDY());
+    fdA.at(i_plane) = make_pair(atan(M.SlopeXdY()), atan(M.SlopeYdX()));
   }
 } // end EventLoop
 
@@ -170,7 +183,8 @@ int Alignment::Align() {
     cout << "BEGIN ITERATION " << i_align + 1 << " OUT OF " << maximum_steps_ << endl;
     now_ = clock();
 
-    FR->ResetFile();
+    if (event_cache_.IsComplete()) { event_cache_.Rewind(); }
+    else { FR->ResetFile(); }
     FR->SetAllPlanes();
     if (not planes_under_test_.empty()) { FR->SetPlanesUnderTest(planes_under_test_); }
 
@@ -187,13 +201,15 @@ int Alignment::Align() {
       g_res_mean_.at(roc)->SetPoint(i_align, i_align, cm2um * sqrt(pow(fdX.at(roc).first, 2) + pow(fdY.at(roc).first, 2)));
       g_res_angle_.at(roc)->SetPoint(i_align, i_align, fabs((fdA.at(roc).first - fdA.at(roc).second) / 2));
     }
-    for (auto ipl:ordered_planes_) { SaveHistograms(ipl, i_align, at_step_); }
+    if (save_plots_) {
+      for (auto ipl:ordered_planes_) { SaveHistograms(ipl, i_align, at_step_); }
+    }
 
     CalcMaxResiduals();
     PrintResiduals(planes_to_align_);
     cout << "END ITERATION " << i_align + 1 << " OUT OF " << maximum_steps_ << endl << endl;
 
-    if (at_step_ == 1 and i_align == 0) { ResizeHistograms(); }  // resize histograms after first real tracking
+    if (save_plots_ and at_step_ == 1 and i_align == 0) { ResizeHistograms(); }  // resize histograms after first real tracking
 
     /** Stopping criteria: max_res/angle < res/angle_thresh or the change wrt to the previous step is smaller than delta_fac * thresh*/
     if (at_step_ == 0) { // step 0 is only a translation without fit...
@@ -207,7 +223,7 @@ int Alignment::Align() {
     }
   } // end alignment loop
 
-  SaveAllHistograms();
+  if (save_plots_) { SaveAllHistograms(); }
   SaveGraphs();
 
   PrintAlignment();
@@ -215,6 +231,12 @@ int Alignment::Align() {
   return 0;
 }
 
+int Alignment::TelescopePlaneBits() const {
+  int bits(0);
+  for (auto i_plane: telescope_planes_) { bits |= 1 << i_plane; }
+  return bits;
+}
+
 float Alignment::ReduceSigma(uint16_t step) const {
   /** reduce n_sigma_ with each iteration until only an ellipse of "3sigma" is used to exclude residual outliers.
    *  the function n(x) = a + b / (1 + exp((x-max_steps/7) * (25 / max_steps))) is tailored to fall from b to a within ~25% of the max_steps */
@@ -457,17 +479,248 @@ void Alignment::SaveGraphs() {
   cout << "\nSaved plots to: " << plots_dir_ << endl;
 }
 
-pair<pair<float, float>, pair<float, float>> Alignment::GetFitRange(uint16_t plane) {
-  /** set range of profiles so that there are at least 50 entries in every bin */
-  const float min = .05;
-  vector<float> values;
-  for (const auto & p: {hResidualXdY.at(plane), hResidualYdX.at(plane)}) {
-    float xmin(p.GetBinContent(1)), xmax(p.GetBinContent(p.GetNbinsX()));
-    for (auto ibin(1); ibin < p.GetNbinsX(); ibin++) { if (p.GetBinEntries(ibin) > min * p.GetEntries()) { xmin = p.GetBinCenter(ibin); break; } }
-    for (auto ibin(p.GetNbinsX()); ibin > 1; ibin--) { if (p.GetBinEntries(ibin) > min * p.GetEntries()) { xmax = p.GetBinCenter(ibin); break; } }
-    values.emplace_back(xmin);
-    values.emplace_back(xmax);
+
+namespace {
+  /** Normal equations of the global alignment parameters (Millepede). The local track parameters (offset and slope in x and y)
+   *  of every track are eliminated when the track is finished: C += Ct - H * Gamma^-1 * H^T, b += bt - H * Gamma^-1 * beta */
+  class GlobalSystem {
+  public:
+    explicit GlobalSystem(size_t n): n_(n), C_(n * n, 0), b_(n, 0), Ct_(n * n, 0), bt_(n, 0), H_(n * 4, 0), used_(n, false) { }
+
+    /** add a measurement m = l0 + l1 * z + sum_i g_i * d_i of one projection (0: x, 1: y) of the current track */
+    void Add(int proj, double m, double z, double w, const std::vector<std::pair<int, double>> & derivatives) {
+      double const L[2] = {1, z};
+      for (int i(0); i < 2; i++) {
+        for (int j(0); j < 2; j++) { Gamma_[proj][i][j] += w * L[i] * L[j]; }
+        beta_[proj][i] += w * L[i] * m;
+      }
+      for (const auto & d: derivatives) {
+        if (d.first < 0) { continue; }  /** fixed parameter */
+        if (not used_[d.first]) { used_[d.first] = true; track_params_.push_back(d.first); }
+        bt_[d.first] += w * d.second * m;
+        for (int i(0); i < 2; i++) { H_[d.first * 4 + proj * 2 + i] += w * d.second * L[i]; }
+        for (const auto & e: derivatives) {
+          if (e.first >= 0) { Ct_[d.first * n_ + e.first] += w * d.second * e.second; }
+        }
+      }
+    }
+
+    /** eliminate the local parameters of the current track, returns false if the track does not constrain them */
+    bool EndTrack() {
+      bool good(true);
+      double Ginv[2][2][2];
+      for (int p(0); p < 2; p++) {
+        double const det = Gamma_[p][0][0] * Gamma_[p][1][1] - Gamma_[p][0][1] * Gamma_[p][1][0];
+        if (det <= 0) { good = false; break; }
+        Ginv[p][0][0] = Gamma_[p][1][1] / det; Ginv[p][1][1] = Gamma_[p][0][0] / det;
+        Ginv[p][0][1] = -Gamma_[p][0][1] / det; Ginv[p][1][0] = -Gamma_[p][1][0] / det;
+      }
+      if (good) {
+        for (auto i: track_params_) {
+          b_[i] += bt_[i];
+          for (auto j: track_params_) { C_[i * n_ + j] += Ct_[i * n_ + j]; }
+          for (int p(0); p < 2; p++) {
+            /** (H Gamma^-1) of row i for projection p */
+            double const hg0 = H_[i * 4 + p * 2] * Ginv[p][0][0] + H_[i * 4 + p * 2 + 1] * Ginv[p][1][0];
+            double const hg1 = H_[i * 4 + p * 2] * Ginv[p][0][1] + H_[i * 4 + p * 2 + 1] * Ginv[p][1][1];
+            b_[i] -= hg0 * beta_[p][0] + hg1 * beta_[p][1];
+            for (auto j: track_params_) { C_[i * n_ + j] -= hg0 * H_[j * 4 + p * 2] + hg1 * H_[j * 4 + p * 2 + 1]; }
+          }
+        }
+        n_tracks_++;
+      }
+      Reset();
+      return good;
+    }
+
+    /** solve C * d = b with Gaussian elimination and partial pivoting */
+    std::vector<double> Solve() const {
+      std::vector<double> A(C_), x(b_);
+      for (size_t k(0); k < n_; k++) {
+        size_t piv = k;
+        for (size_t i(k + 1); i < n_; i++) { if (fabs(A[i * n_ + k]) > fabs(A[piv * n_ + k])) { piv = i; } }
+        if (fabs(A[piv * n_ + k]) < 1e-12) {
+          tel::warning(Form("Global alignment: parameter %zu is not constrained by the tracks", k));
+          A[k * n_ + k] = 1; x[k] = 0;
+          for (size_t j(0); j < n_; j++) { if (j != k) { A[k * n_ + j] = 0; } }
+          continue;
+        }
+        if (piv != k) {
+          for (size_t j(0); j < n_; j++) { std::swap(A[k * n_ + j], A[piv * n_ + j]); }
+          std::swap(x[k], x[piv]);
+        }
+        for (size_t i(k + 1); i < n_; i++) {
+          double const f = A[i * n_ + k] / A[k * n_ + k];
+          if (f == 0) { continue; }
+          for (size_t j(k); j < n_; j++) { A[i * n_ + j] -= f * A[k * n_ + j]; }
+          x[i] -= f * x[k];
+        }
+      }
+      for (size_t k(n_); k-- > 0;) {
+        for (size_t j(k + 1); j < n_; j++) { x[k] -= A[k * n_ + j] * x[j]; }
+        x[k] /= A[k * n_ + k];
+      }
+      return x;
+    }
+    uint64_t NTracks() const { return n_tracks_; }
+
+  private:
+    size_t n_;
+    std::vector<double> C_, b_;
+    std::vector<double> Ct_, bt_, H_;  /** contributions of the current track */
+    std::vector<bool> used_;
+    std::vector<int> track_params_;
+    double Gamma_[2][2][2] = {}, beta_[2][2] = {};
+    uint64_t n_tracks_ = 0;
+    void Reset() {
+      for (auto i: track_params_) {
+        used_[i] = false;
+        bt_[i] = 0;
+        for (auto j: track_params_) { Ct_[i * n_ + j] = 0; }
+        for (int j(0); j < 4; j++) { H_[i * 4 + j] = 0; }
+      }
+      track_params_.clear();
+      for (auto & g: Gamma_) { for (auto & r: g) { r[0] = r[1] = 0; } }
+      for (auto & b: beta_) { b[0] = b[1] = 0; }
+    }
+  };
+}
+
+void Alignment::GlobalAlign() {
+  /** Align all planes at once: the first plane in the beam and the last telescope plane define the frame. Their offsets fix
+   *  the position and direction of the beam and their rotations the global rotation and the twist (a rotation growing
+   *  linearly in z is absorbed by the track slopes for a parallel beam). The offsets and rotations of all other planes are
+   *  free parameters. More than one pass is only needed for the linearised rotations and the outlier cuts. */
+  tel::print_banner("GLOBAL ALIGNMENT");
+  planes_to_align_ = vector<uint16_t>(ordered_planes_.begin() + 1, ordered_planes_.end());
+  if (align_only_telescope_) { planes_to_align_ = vector<uint16_t>(telescope_planes_.begin() + 1, telescope_planes_.end()); }
+  cout << "Planes to align: " << tel::to_string(planes_to_align_) << endl;
+
+  /** global parameter index of dX, dY and dR of each plane (-1: fixed) */
+  vector<int> param_index(3 * n_planes_, -1);
+  int n_params(0);
+  for (auto i_plane: planes_to_align_) {
+    if (i_plane == telescope_planes_.back()) { continue; }
+    for (int i(0); i < 3; i++) { param_index.at(3 * i_plane + i) = n_params++; }
   }
-  return make_pair(make_pair(values.at(0), values.at(1)), make_pair(values.at(0), values.at(1)));
+
+  FR = InitFileReader();
+  FR->GetAlignment()->ResetPlane(1, ordered_planes_.at(0));
+  FR->ReadPixelMask(GetMaskingFilename());
+  FR->SetPrefilter(true, TelescopePlaneBits());
+  ProgressBar = new tel::ProgressBar(max_event_number_);
+  global_res_cut_.assign(n_planes_, .5);  /** 5mm in the first pass */
+  last_max_res_ = make_pair(0, 0);
+  delta_max_res_ = make_pair(0, 0);
+  cout << "\nStarting with Alignment: " << endl;
+  PrintAlignment();
+  InitGraphs();
+
+  for (uint16_t i_pass(0); i_pass < max_global_passes_; i_pass++) {
+    cout << "BEGIN PASS " << i_pass + 1 << " OUT OF " << max_global_passes_ << endl;
+    now_ = clock();
+    if (event_cache_.IsComplete()) { event_cache_.Rewind(); }
+    else { FR->ResetFile(); }
+    GlobalEventLoop(planes_to_align_, param_index);
+    cout << Form("\nLoop duration: %2.1f", (clock() - now_) / CLOCKS_PER_SEC) << endl;
+
+    const float cm2um = 1e4;
+    for (auto roc: planes_to_align_) {
+      g_res_mean_.at(roc)->SetPoint(i_pass, i_pass, cm2um * sqrt(pow(fdX.at(roc).first, 2) + pow(fdY.at(roc).first, 2)));
+      g_res_angle_.at(roc)->SetPoint(i_pass, i_pass, fabs(fdA.at(roc).first));
+    }
+    CalcMaxResiduals();
+    PrintResiduals(planes_to_align_);
+    cout << "END PASS " << i_pass + 1 << " OUT OF " << max_global_passes_ << endl << endl;
+    if (i_pass > 0 and GetMaxRes() < res_thresh_ and GetMaxAngle() < angle_thresh_) {
+      tel::warning(Form("STOPPING ALIGNMENT:  max correction < %1.1e and max angle < %1.1e\n", res_thresh_, angle_thresh_));
+      break;
+    }
+  }
+  at_step_ = 0;
+  SaveGraphs();
+  PrintAlignment();
+  FR->GetAlignment()->WriteAlignmentFile(telescope_id_, n_planes_);
+  FR->CloseFile();
+  delete FR;
+  alignment_finished_ = true;
 }
 
+void Alignment::GlobalEventLoop(const vector<uint16_t> & planes, const vector<int> & param_index) {
+
+  PLTAlignment * al = FR->GetAlignment();
+  FR->SetAllPlanes();
+  PLTTracking::TrackingAlgorithm const algorithm = FR->fTrackingAlgorithm;
+  FR->SetTrackingAlgorithm(PLTTracking::kTrackingAlgorithm_NoTracking);  /** the tracks are fitted here */
+
+  vector<uint16_t> track_planes = {ordered_planes_.at(0)};
+  track_planes.insert(track_planes.end(), planes.begin(), planes.end());
+  vector<float> ex(n_planes_), ey(n_planes_);
+  for (auto i_plane: track_planes) {  /** measurement errors, the fix point has no error in the iterative alignment */
+    ex.at(i_plane) = al->GetErrorX(i_plane) > 0 ? al->GetErrorX(i_plane) : PLTU::PIXELWIDTH / sqrt(12);
+    ey.at(i_plane) = al->GetErrorY(i_plane) > 0 ? al->GetErrorY(i_plane) : PLTU::PIXELHEIGHT / sqrt(12);
+  }
+
+  GlobalSystem system(count_if(param_index.begin(), param_index.end(), [](int i) { return i >= 0; }));
+  vector<PLTCluster*> clusters(n_planes_);
+  vector<double> sum_res2(n_planes_, 0);
+  vector<uint64_t> n_res(n_planes_, 0);
+  ProgressBar->reset();
+  for (uint32_t i_event = 0; FR->GetNextCachedEvent(event_cache_) >= 0; ++i_event) {
+    if (i_event >= max_event_number_) { break; }
+    ++*ProgressBar;
+    if (not FR->HaveOneCluster(telescope_planes_)) { continue; }
+
+    /** straight line fit with the current constants to reject outliers */
+    PLTLineFit fit_x, fit_y;
+    for (auto i_plane: track_planes) {
+      PLTPlane * Plane = FR->Plane(i_plane);
+      clusters.at(i_plane) = Plane->NClusters() == 1 ? Plane->Cluster(0) : nullptr;
+      if (clusters.at(i_plane) == nullptr) { continue; }
+      fit_x.Add(clusters.at(i_plane)->TZ(), clusters.at(i_plane)->TX(), ex.at(i_plane));
+      fit_y.Add(clusters.at(i_plane)->TZ(), clusters.at(i_plane)->TY(), ey.at(i_plane));
+    }
+    fit_x.Solve();
+    fit_y.Solve();
+    bool outlier(false);
+    for (auto i_plane: track_planes) {
+      PLTCluster * c = clusters.at(i_plane);
+      if (c == nullptr) { continue; }
+      float const dx = c->TX() - (fit_x.Slope * c->TZ() + fit_x.Offset), dy = c->TY() - (fit_y.Slope * c->TZ() + fit_y.Offset);
+      if (sqrt(dx * dx + dy * dy) > global_res_cut_.at(i_plane)) { outlier = true; break; }
+    }
+    if (outlier) { continue; }
+
+    for (auto i_plane: track_planes) {
+      PLTCluster * c = clusters.at(i_plane);
+      if (c == nullptr) { continue; }
+      float const tx = c->TX(), ty = c->TY(), tz = c->TZ();
+      float const dx = tx - (fit_x.Slope * tz + fit_x.Offset), dy = ty - (fit_y.Slope * tz + fit_y.Offset);
+      sum_res2.at(i_plane) += dx * dx + dy * dy;
+      n_res.at(i_plane)++;
+      /** corrected position: tx - dR * (ty - LY) + dX = track(z) -> tx = track(z) - dX + dR * (ty - LY), the same for y */
+      int const ix = param_index.at(3 * i_plane), iy = param_index.at(3 * i_plane + 1), ir = param_index.at(3 * i_plane + 2);
+      system.Add(0, tx, tz, 1 / pow(ex.at(i_plane), 2), {{ix, -1}, {ir, ty - al->LY(1, i_plane)}});
+      system.Add(1, ty, tz, 1 / pow(ey.at(i_plane), 2), {{iy, -1}, {ir, -(tx - al->LX(1, i_plane))}});
+    }
+    system.EndTrack();
+  }
+  event_cache_.Close();
+  FR->SetTrackingAlgorithm(algorithm);
+  cout << "\nUsed " << system.NTracks() << " tracks" << endl;
+
+  /** apply the corrections and set the outlier cuts of the next pass */
+  vector<double> d = system.Solve();
+  for (auto i_plane: track_planes) {
+    int const ix = param_index.at(3 * i_plane), iy = param_index.at(3 * i_plane + 1), ir = param_index.at(3 * i_plane + 2);
+    float const dx = ix >= 0 ? d.at(ix) : 0, dy = iy >= 0 ? d.at(iy) : 0, dr = ir >= 0 ? d.at(ir) : 0;
+    if (ir >= 0) { al->AddToLR(1, i_plane, dr); }
+    if (ix >= 0) { al->AddToLX(1, i_plane, dx); }
+    if (iy >= 0) { al->AddToLY(1, i_plane, dy); }
+    float const rms = n_res.at(i_plane) > 0 ? sqrt(sum_res2.at(i_plane) / n_res.at(i_plane)) : global_res_cut_.at(i_plane);
+    fdX.at(i_plane) = make_pair(dx, rms);
+    fdY.at(i_plane) = make_pair(dy, rms);
+    fdA.at(i_plane) = make_pair(dr, -dr);
+    global_res_cut_.at(i_plane) = min(global_res_cut_.at(i_plane), float(min_sigma_ * rms + sqrt(dx * dx + dy * dy)));
+  }
+}
@@ -1,91 +1,120 @@
 #include "FileWriterTracking.h"
 #include "Utils.h"
+#include "StageTimer.h"
 
-using std::cout; using std::string; using std::stringstream; using std::vector; using std::endl;
+#include "TChain.h"
+#include "TSystem.h"
+
+#include <algorithm>
+#include <cstring>
+
+using std::cout; using std::string; using std::stringstream; using std::vector; using std::endl; using std::copy;
 
 /** ============================
  CONSTRUCTOR
  =================================*/
-FileWriterTracking::FileWriterTracking(string InFileName, PSIFileReader * FR):
-  n_rocs_(GetNPlanes()), n_duts_(GetNDUTs()), FR_(FR) {
+FileWriterTracking::FileWriterTracking(string InFileName, PSIFileReader * FR, int16_t part, uint32_t first_entry, int16_t shard):
+  n_rocs_(GetNPlanes()), n_duts_(GetNDUTs()), FR_(FR), records_(WRITER_QUEUE_SIZE), next_entry_(first_entry), closing_(false) {
 
-  NewFileName = getFileName(InFileName);
+  NewFileName = getFileName(InFileName, part, shard);
   intree = ((PSIRootFileReader*) FR)->fTree;
   names = ((PSIRootFileReader*) FR)->fMacro;
+  /** the cloned branches share their buffers with the tree they were cloned from, so newtree is cloned from an own copy of the input tree */
+  in_file_ = new TFile(InFileName.c_str(), "READ");
+  copy_tree_ = dynamic_cast<TTree*>(in_file_->Get("tree"));
+  /** the reader calibrates the charges itself, so the charges on disk are replaced by the ones of the event loop */
+  bool const has_charge = copy_tree_->GetBranch("charge") != nullptr;
+  if (has_charge) { copy_tree_->SetBranchAddress("charge", charge_); }
   newfile = new TFile(NewFileName.c_str(), "RECREATE");
-  newtree = intree->CloneTree(0);
-
-  /** init arrays */
-  br_dia_track_pos_x = new float[n_duts_];
-  br_dia_track_pos_y = new float[n_duts_];
-  br_dia_track_pos_x_loc = new float[n_duts_];
-  br_dia_track_pos_y_loc = new float[n_duts_];
-  br_track_col = new float[n_duts_];
-  br_track_row = new float[n_duts_];
-  br_dist_to_dia = new float[n_duts_];
-  br_n_hits = new uint16_t[n_rocs_];
-  br_n_clusters = new uint8_t[n_rocs_];
-  br_sres = new float[n_rocs_];
-  br_sres_x = new float[n_rocs_];
-  br_sres_y = new float[n_rocs_];
+  newtree = copy_tree_->CloneTree(0);
+  if (has_charge) { newtree->SetBranchAddress("charge", charge_); }
+  initCopiedLeaves();
 
   /** init vectors */
-  br_residuals_x = new vector<vector<float> >;
-  br_residuals_y = new vector<vector<float> >;
-  br_residuals = new vector<vector<float> >;
-  br_track_x = new vector<vector<float> >;
-  br_track_y = new vector<vector<float> >;
-
-  br_cluster_size = new vector<vector<uint16_t> >;
-  br_cluster_col = new vector<vector<uint16_t> >;
-  br_cluster_row = new vector<vector<uint16_t> >;
-  br_cluster_xpos_tel = new vector<vector<float> >;
-  br_cluster_ypos_tel = new vector<vector<float> >;
-  br_cluster_xpos_local = new vector<vector<float> >;
-  br_cluster_ypos_local = new vector<vector<float> >;
-
-  br_cluster_charge = new vector<vector<float> >;
   br_aligned = new vector<bool>;
   is_aligned = new vector<bool>;
   resizeVectors();
   addBranches();
+
+  for (auto & record: records_) { free_records_.push_back(&record); }
+  writer_ = std::thread(&FileWriterTracking::writeLoop, this);
+}
+
+FileWriterTracking::~FileWriterTracking() {
+
+  if (writer_.joinable()) {
+    { std::lock_guard<std::mutex> lock(mutex_); closing_ = true; }
+    filled_cv_.notify_one();
+    writer_.join();
+  }
 }
 
 /** ============================
  AUXILIARY FUNCTIONS
  =================================*/
-string FileWriterTracking::getFileName(string & InFileName){
+void FileWriterTracking::initCopiedLeaves(){
+  /** the event loop has already read (and decompressed) every branch of intree, so the leaves of basic types are copied from there
+   *  instead of reading each entry a second time; only the other branches (objects, strings) are still read from copy_tree_ */
+  vector<string> reread;
+  TObjArray * leaves = intree->GetListOfLeaves();
+  for (int i = 0; i < leaves->GetEntriesFast(); i++) {
+    auto * in = (TLeaf*) leaves->UncheckedAt(i);
+    string const branch_name = in->GetBranch()->GetName();
+    if (branch_name == "charge") { continue; }
+    TBranch * out_branch = newtree->GetBranch(branch_name.c_str());
+    TLeaf * out = out_branch != nullptr ? out_branch->GetLeaf(in->GetName()) : nullptr;
+    if (out == nullptr or in->InheritsFrom("TLeafElement") or in->InheritsFrom("TLeafObject") or in->InheritsFrom("TLeafC")) {
+      if (std::find(reread.begin(), reread.end(), branch_name) == reread.end()) { reread.push_back(branch_name); }
+      continue;
+    }
+    /** branches without an address let their leaves allocate their own buffers (arrays with the maximum length of the file) */
+    if (in->GetValuePointer() == nullptr) { in->GetBranch()->SetAddress(nullptr); }
+    if (out->GetValuePointer() == nullptr) { out_branch->SetAddress(nullptr); }
+    copied_leaves_.push_back({in, out});
+  }
+  /** a branch with leaves of both kinds is read completely, the copied leaves are written afterwards */
+  reread_entries_ = not reread.empty();
+  copy_tree_->SetBranchStatus("*", false);
+  for (auto const & name: reread) { copy_tree_->SetBranchStatus(name.c_str(), true); }
+  for (auto & record: records_) { record.leaf_sizes.resize(copied_leaves_.size()); }
+}
 
+string FileWriterTracking::getFileName(const string & InFileName, int16_t part, int16_t shard){
+
+  string file_name;
   stringstream ss(InFileName);
-  while (getline(ss, NewFileName, '/') ){}
+  while (getline(ss, file_name, '/') ){}
   const uint8_t ending_size(5);  // .root
-  NewFileName.insert(unsigned(NewFileName.length() - ending_size), "_withTracks");
-  return NewFileName;
+  string suffix = "_withTracks";
+  if (shard >= 0) { suffix += Form("_shard%i", shard); }
+  if (part >= 0) { suffix += Form("_part%i", part); }
+  file_name.insert(unsigned(file_name.length() - ending_size), suffix);
+  return file_name;
 }
 void FileWriterTracking::addBranches(){
 
-  newtree->Branch("hit_plane_bits", &br_hit_plane_bits);
+  newtree->Branch("hit_plane_bits", &out_.hit_plane_bits);
   /** arrays */
-  newtree->Branch("dia_track_x", br_dia_track_pos_x, Form("dia_track_x[%d]/F", n_duts_));
-  newtree->Branch("dia_track_y", br_dia_track_pos_y, Form("dia_track_y[%d]/F", n_duts_));
-  newtree->Branch("dia_track_x_local", br_dia_track_pos_x_loc, Form("dia_track_x_local[%d]/F", n_duts_));
-  newtree->Branch("dia_track_y_local", br_dia_track_pos_y_loc, Form("dia_track_y_local[%d]/F", n_duts_));
-  newtree->Branch("dia_track_col", br_track_col, Form("dia_track_col[%d]/F", n_duts_));
-  newtree->Branch("dia_track_row", br_track_row, Form("dia_track_row[%d]/F", n_duts_));
-  newtree->Branch("dist_to_dia", br_dist_to_dia, Form("dist_to_dia[%d]/F", n_duts_));
-  newtree->Branch("n_hits", br_n_hits, Form("n_hits[%d]/s", n_rocs_));
-  newtree->Branch("n_clusters", br_n_clusters, Form("n_clusters[%d]/b", n_rocs_));
-  newtree->Branch("sres", br_sres, Form("sres[%d]/F", n_rocs_));
-  newtree->Branch("sres_x", br_sres_x, Form("sres_x[%d]/F", n_rocs_));
-  newtree->Branch("sres_y", br_sres_y, Form("sres_y[%d]/F", n_rocs_));
+  newtree->Branch("dia_track_x", out_.dia_track_pos_x.data(), Form("dia_track_x[%d]/F", n_duts_));
+  newtree->Branch("dia_track_y", out_.dia_track_pos_y.data(), Form("dia_track_y[%d]/F", n_duts_));
+  newtree->Branch("dia_track_x_local", out_.dia_track_pos_x_loc.data(), Form("dia_track_x_local[%d]/F", n_duts_));
+  newtree->Branch("dia_track_y_local", out_.dia_track_pos_y_loc.data(), Form("dia_track_y_local[%d]/F", n_duts_));
+  newtree->Branch("dia_track_col", out_.track_col.data(), Form("dia_track_col[%d]/F", n_duts_));
+  newtree->Branch("dia_track_row", out_.track_row.data(), Form("dia_track_row[%d]/F", n_duts_));
+  newtree->Branch("dist_to_dia", out_.dist_to_dia.data(), Form("dist_to_dia[%d]/F", n_duts_));
+  newtree->Branch("n_hits", out_.n_hits.data(), Form("n_hits[%d]/s", n_rocs_));
+  newtree->Branch("n_clusters", out_.n_clusters.data(), Form("n_clusters[%d]/b", n_rocs_));
+  newtree->Branch("sres", out_.sres.data(), Form("sres[%d]/F", n_rocs_));
+  newtree->Branch("sres_x", out_.sres_x.data(), Form("sres_x[%d]/F", n_rocs_));
+  newtree->Branch("sres_y", out_.sres_y.data(), Form("sres_y[%d]/F", n_rocs_));
   /** vectors */
-  newtree->Branch("chi2_tracks", &br_chi2);
-  newtree->Branch("chi2_x", &br_chi2_x);
-  newtree->Branch("chi2_y", &br_chi2_y);
-  newtree->Branch("angle_x", &br_angle_x);
-  newtree->Branch("angle_y", &br_angle_y);
-  newtree->Branch("n_tracks", &br_n_tracks);
-  newtree->Branch("total_clusters", &br_total_clusters);
+  newtree->Branch("chi2_tracks", &out_.chi2);
+  newtree->Branch("chi2_x", &out_.chi2_x);
+  newtree->Branch("chi2_y", &out_.chi2_y);
+  newtree->Branch("angle_x", &out_.angle_x);
+  newtree->Branch("angle_y", &out_.angle_y);
+  newtree->Branch("n_tracks", &out_.n_tracks);
+  newtree->Branch("total_clusters", &out_.total_clusters);
   newtree->Branch("cluster_col", &br_cluster_col);
   newtree->Branch("cluster_row", &br_cluster_row);
   newtree->Branch("cluster_charge", &br_cluster_charge);
@@ -101,12 +130,86 @@ void FileWriterTracking::addBranches(){
   newtree->Branch("track_y", &br_track_y);
 }
 
-void FileWriterTracking::fillTree(){
+void FileWriterTracking::fillTree(uint32_t entry){
+  tel::ScopedStage timer(tel::Stage::WriteTree);
+  /** hand the event to the writer thread, waits if the writer is WRITER_QUEUE_SIZE events behind */
+  Record * record;
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    free_cv_.wait(lock, [this] { return not free_records_.empty(); });
+    record = free_records_.back();
+    free_records_.pop_back();
+  }
+  event_.entry = entry;
+  event_.moveTo(*record);
+  auto * reader = (PSIRootFileReader*) FR_;
+  record->charge.assign(reader->Charges(), reader->Charges() + reader->NHitsTotal());
+  record->leaf_data.clear();
+  for (size_t i = 0; i < copied_leaves_.size(); i++) {
+    TLeaf * leaf = copied_leaves_[i].in;
+    auto const * data = (const char*) leaf->GetValuePointer();
+    record->leaf_sizes[i] = leaf->GetLen() * leaf->GetLenType();
+    record->leaf_data.insert(record->leaf_data.end(), data, data + record->leaf_sizes[i]);
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    filled_records_.push_back(record);
+  }
+  filled_cv_.notify_one();
+}
+
+void FileWriterTracking::writeLoop(){
+
+  while (true) {
+    Record * record;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      filled_cv_.wait(lock, [this] { return closing_ or not filled_records_.empty(); });
+      if (filled_records_.empty()) { break; }
+      record = filled_records_.front();
+      filled_records_.pop_front();
+    }
+    pending_records_[record->entry] = record;
+    /** write all records which are next in the order of the entries */
+    while (not pending_records_.empty() and pending_records_.begin()->first == next_entry_) {
+      writeRecord(pending_records_.begin()->second);
+      pending_records_.erase(pending_records_.begin());
+      next_entry_++;
+    }
+  }
+  /** the event loop is finished, write whatever is left (only if entries were skipped) */
+  for (auto & entry_record: pending_records_) { writeRecord(entry_record.second); }
+  pending_records_.clear();
+}
+
+void FileWriterTracking::writeRecord(Record * record){
+
+  if (reread_entries_) { copy_tree_->GetEntry(record->entry); }
+  const char * data = record->leaf_data.data();
+  for (size_t i = 0; i < copied_leaves_.size(); i++) {
+    std::memcpy(copied_leaves_[i].out->GetValuePointer(), data, record->leaf_sizes[i]);
+    data += record->leaf_sizes[i];
+  }
+  copy(record->charge.begin(), record->charge.end(), charge_);
+  record->moveTo(out_);
   newtree->Fill();
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    free_records_.push_back(record);
+  }
+  free_cv_.notify_one();
 }
 
 void FileWriterTracking::saveTree(){
 
+  /** wait until the writer thread has filled all events */
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    closing_ = true;
+  }
+  filled_cv_.notify_one();
+  writer_.join();
+
   newfile->cd();
   newtree->Write();
   if (names != nullptr) {
@@ -114,54 +217,122 @@ void FileWriterTracking::saveTree(){
   newfile->Write();
   newfile->Close();
   delete newfile;
+  in_file_->Close();
+  delete in_file_;
+}
+
+void FileWriterTracking::mergeFiles(const vector<string> & parts, const string & InFileName, TMacro * names, int16_t shard){
+  /** concatenate the trees of the partial files (in the given order) into the file with tracks (of the shard) and remove the parts */
+  TChain chain("tree");
+  for (const auto & part: parts) { chain.Add(part.c_str()); }
+  auto * out_file = new TFile(getFileName(InFileName, -1, shard).c_str(), "RECREATE");
+  chain.Merge(out_file, 0, "keep fast");
+  out_file->cd();
+  if (names != nullptr) {
+    names->Write(); }
+  out_file->Write();
+  out_file->Close();
+  delete out_file;
+  for (const auto & part: parts) { gSystem->Unlink(part.c_str()); }
 }
 
 void FileWriterTracking::clearVectors(){
 
   for (uint8_t iRoc = 0; iRoc != n_rocs_; iRoc++) {
-    br_cluster_col->at(iRoc).clear();
-    br_cluster_row->at(iRoc).clear();
-    br_cluster_xpos_tel->at(iRoc).clear();
-    br_cluster_ypos_tel->at(iRoc).clear();
-    br_cluster_xpos_local->at(iRoc).clear();
-    br_cluster_ypos_local->at(iRoc).clear();
-    br_cluster_charge->at(iRoc).clear();
-    br_cluster_size->at(iRoc).clear();
-    br_residuals_x->at(iRoc).clear();
-    br_residuals_y->at(iRoc).clear();
-    br_residuals->at(iRoc).clear();
-    br_track_x->at(iRoc).clear();
-    br_track_y->at(iRoc).clear();
+    event_.cluster_col.at(iRoc).clear();
+    event_.cluster_row.at(iRoc).clear();
+    event_.cluster_xpos_tel.at(iRoc).clear();
+    event_.cluster_ypos_tel.at(iRoc).clear();
+    event_.cluster_xpos_local.at(iRoc).clear();
+    event_.cluster_ypos_local.at(iRoc).clear();
+    event_.cluster_charge.at(iRoc).clear();
+    event_.cluster_size.at(iRoc).clear();
+    event_.residuals_x.at(iRoc).clear();
+    event_.residuals_y.at(iRoc).clear();
+    event_.residuals.at(iRoc).clear();
+    event_.track_x.at(iRoc).clear();
+    event_.track_y.at(iRoc).clear();
   }
 }
 
 void FileWriterTracking::resizeVectors() {
 
-  br_residuals_x->resize(n_rocs_);
-  br_residuals_y->resize(n_rocs_);
-  br_residuals->resize(n_rocs_);
-  br_track_x->resize(n_rocs_);
-  br_track_y->resize(n_rocs_);
+  event_.resize(n_rocs_, n_duts_);
+  out_.resize(n_rocs_, n_duts_);
+  for (auto & record: records_) { record.resize(n_rocs_, n_duts_); }
 
-  br_cluster_size->resize(n_rocs_);
+  br_residuals_x = &out_.residuals_x;
+  br_residuals_y = &out_.residuals_y;
+  br_residuals = &out_.residuals;
+  br_track_x = &out_.track_x;
+  br_track_y = &out_.track_y;
 
-  br_cluster_col->resize(n_rocs_);
-  br_cluster_row->resize(n_rocs_);
-  br_cluster_xpos_tel->resize(n_rocs_);
-  br_cluster_ypos_tel->resize(n_rocs_);
-  br_cluster_xpos_local->resize(n_rocs_);
-  br_cluster_ypos_local->resize(n_rocs_);
+  br_cluster_size = &out_.cluster_size;
 
-  br_cluster_charge->resize(n_rocs_);
+  br_cluster_col = &out_.cluster_col;
+  br_cluster_row = &out_.cluster_row;
+  br_cluster_xpos_tel = &out_.cluster_xpos_tel;
+  br_cluster_ypos_tel = &out_.cluster_ypos_tel;
+  br_cluster_xpos_local = &out_.cluster_xpos_local;
+  br_cluster_ypos_local = &out_.cluster_ypos_local;
+
+  br_cluster_charge = &out_.cluster_charge;
   is_aligned->resize(n_rocs_, true);
   br_aligned->resize(n_rocs_, true);
 }
 
+void FileWriterTracking::Record::resize(uint16_t n_rocs, uint8_t n_duts) {
+
+  for (auto * vec: {&dia_track_pos_x, &dia_track_pos_y, &dia_track_pos_x_loc, &dia_track_pos_y_loc, &dist_to_dia, &track_col, &track_row}) {
+    vec->resize(n_duts); }
+  for (auto * vec: {&sres_x, &sres_y, &sres}) { vec->resize(n_rocs); }
+  n_hits.resize(n_rocs);
+  n_clusters.resize(n_rocs);
+  for (auto * vec: {&residuals_x, &residuals_y, &residuals, &track_x, &track_y, &cluster_xpos_tel, &cluster_ypos_tel, &cluster_xpos_local,
+                    &cluster_ypos_local, &cluster_charge}) { vec->resize(n_rocs); }
+  for (auto * vec: {&cluster_size, &cluster_col, &cluster_row}) { vec->resize(n_rocs); }
+}
+
+void FileWriterTracking::Record::moveTo(Record & other) {
+  /** the fixed size arrays keep their size (the branch addresses stay valid), the cluster vectors are swapped without allocations */
+  other.entry = entry;
+  other.hit_plane_bits = hit_plane_bits;
+  other.n_tracks = n_tracks;
+  other.total_clusters = total_clusters;
+  other.chi2 = chi2; other.chi2_x = chi2_x; other.chi2_y = chi2_y;
+  other.angle_x = angle_x; other.angle_y = angle_y;
+  copy(dia_track_pos_x.begin(), dia_track_pos_x.end(), other.dia_track_pos_x.begin());
+  copy(dia_track_pos_y.begin(), dia_track_pos_y.end(), other.dia_track_pos_y.begin());
+  copy(dia_track_pos_x_loc.begin(), dia_track_pos_x_loc.end(), other.dia_track_pos_x_loc.begin());
+  copy(dia_track_pos_y_loc.begin(), dia_track_pos_y_loc.end(), other.dia_track_pos_y_loc.begin());
+  copy(dist_to_dia.begin(), dist_to_dia.end(), other.dist_to_dia.begin());
+  copy(track_col.begin(), track_col.end(), other.track_col.begin());
+  copy(track_row.begin(), track_row.end(), other.track_row.begin());
+  copy(sres_x.begin(), sres_x.end(), other.sres_x.begin());
+  copy(sres_y.begin(), sres_y.end(), other.sres_y.begin());
+  copy(sres.begin(), sres.end(), other.sres.begin());
+  copy(n_hits.begin(), n_hits.end(), other.n_hits.begin());
+  copy(n_clusters.begin(), n_clusters.end(), other.n_clusters.begin());
+  residuals_x.swap(other.residuals_x);
+  residuals_y.swap(other.residuals_y);
+  residuals.swap(other.residuals);
+  track_x.swap(other.track_x);
+  track_y.swap(other.track_y);
+  cluster_size.swap(other.cluster_size);
+  cluster_col.swap(other.cluster_col);
+  cluster_row.swap(other.cluster_row);
+  cluster_xpos_tel.swap(other.cluster_xpos_tel);
+  cluster_ypos_tel.swap(other.cluster_ypos_tel);
+  cluster_xpos_local.swap(other.cluster_xpos_local);
+  cluster_ypos_local.swap(other.cluster_ypos_local);
+  cluster_charge.swap(other.cluster_charge);
+}
+
 void FileWriterTracking::setSResidual(uint8_t iRoc, bool def) {
   /** Fill the single cluster residuals. */
-  br_sres_x[iRoc] = def ? br_residuals_x->at(iRoc).at(0) : DEF_VAL;
-  br_sres_y[iRoc] = def ? br_residuals_y->at(iRoc).at(0) : DEF_VAL;
-  br_sres[iRoc] = def ? br_residuals->at(iRoc).at(0) : DEF_VAL;
+  event_.sres_x[iRoc] = def ? event_.residuals_x.at(iRoc).at(0) : DEF_VAL;
+  event_.sres_y[iRoc] = def ? event_.residuals_y.at(iRoc).at(0) : DEF_VAL;
+  event_.sres[iRoc] = def ? event_.residuals.at(iRoc).at(0) : DEF_VAL;
 }
 
 void FileWriterTracking::set_dut_tracks(const vector<float> * z_dut) {
@@ -170,15 +341,15 @@ void FileWriterTracking::set_dut_tracks(const vector<float> * z_dut) {
     auto * track = FR_->Track(0);
     for (uint8_t i(0); i < z_dut->size(); i++) {
       float x_pos(track->ExtrapolateX(z_dut->at(i))), y_pos(track->ExtrapolateY(z_dut->at(i)));
-      br_dia_track_pos_x[i] = x_pos; br_dia_track_pos_y[i] = y_pos;
+      event_.dia_track_pos_x[i] = x_pos; event_.dia_track_pos_y[i] = y_pos;
       auto pos_loc = FR_->GetAlignment()->TtoLXY(x_pos, y_pos, 1, int(n_rocs_ - n_duts_ + i));
-      br_dia_track_pos_x_loc[i] = pos_loc.first; br_dia_track_pos_y_loc[i] = pos_loc.second;
-      br_track_col[i] = PLTAlignment::LX2PX(pos_loc.first); br_track_row[i] = PLTAlignment::LY2PY(pos_loc.second);
-      br_dist_to_dia[i] = sqrt(x_pos * x_pos + y_pos * y_pos);
+      event_.dia_track_pos_x_loc[i] = pos_loc.first; event_.dia_track_pos_y_loc[i] = pos_loc.second;
+      event_.track_col[i] = PLTAlignment::LX2PX(pos_loc.first); event_.track_row[i] = PLTAlignment::LY2PY(pos_loc.second);
+      event_.dist_to_dia[i] = sqrt(x_pos * x_pos + y_pos * y_pos);
     }
   } else {
     for (uint8_t i(0); i < n_duts_; i++) {
-      br_dia_track_pos_x[i] = br_dia_track_pos_y[i] = br_dia_track_pos_x_loc[i] = br_dia_track_pos_y_loc[i] = br_track_col[i] = br_track_row[i] = DEF_VAL;
+      event_.dia_track_pos_x[i] = event_.dia_track_pos_y[i] = event_.dia_track_pos_x_loc[i] = event_.dia_track_pos_y_loc[i] = event_.track_col[i] = event_.track_row[i] = DEF_VAL;
     }
   }
 }
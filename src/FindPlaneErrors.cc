@@ -6,6 +6,7 @@
 #include "GetNames.h"
 #include "PSIBinaryFileReader.h"
 #include "PSIRootFileReader.h"
+#include "PLTLineFit.h"
 #include "TF1.h"
 #include "Utils.h"
 #include "TH1F.h"
@@ -13,10 +14,11 @@
 
 using namespace std;
 
-FindPlaneErrors::FindPlaneErrors(const string & in_file_name, const TString & run_number, int16_t telescope_ID):
+FindPlaneErrors::FindPlaneErrors(const string & in_file_name, const TString & run_number, int16_t telescope_ID, bool single_pass):
   Action(in_file_name, run_number),
   TelescopeID(telescope_ID),
   NPlanes(GetNPlanes()),
+  SinglePass(single_pass),
   Threshold(.01),
   OutFileName(Form("ALIGNMENT/telescope%i.dat", telescope_ID)),
   PlotsDir("plots/"),
@@ -24,18 +26,21 @@ FindPlaneErrors::FindPlaneErrors(const string & in_file_name, const TString & ru
   FileType(".png"),
   MaxIterations(8),
   hChi2All(new TH1F("Chi2XAll", "Chi2XAll", 100, 0, 20), new TH1F("Chi2YAll", "Chi2YAll", 100, 0, 20)),
-  hChi2Res(new TH1F("Chi2XRes", "Chi2XRes", 100, 0, 20), new TH1F("Chi2YRes", "Chi2YRes", 100, 0, 20)),
   Chi2All(-999, -999),
   AllFit(InitFits()),
   ResFit(InitFits(true)) {
 
   gROOT->ProcessLine("gErrorIgnoreLevel = kError;");
 
+  for (unsigned i_plane(0); i_plane < NPlanes; i_plane++){
+    hChi2Res.emplace_back(new TH1F(Form("Chi2XRes%i", i_plane), "Chi2XRes", 100, 0, 20), new TH1F(Form("Chi2YRes%i", i_plane), "Chi2YRes", 100, 0, 20));
+  }
   Chi2Res.assign(NPlanes, make_pair(1, 1));
   RealChi2Res.assign(NPlanes, make_pair(1, 1));
 
   FR = InitFileReader();
   FR->ReadPixelMask(GetMaskingFilename()); /** Apply Masking */
+  FR->SetPrefilter(true);  /** only tracked events are used, skip decoding the others */
   OrderedPlanes = GetOrderedPlanes();
   MaxEventNumber = (FR->GetEntries() > 50000) ? 10000 : unsigned(FR->GetEntries());
   ProgressBar = new tel::ProgressBar(MaxEventNumber - 1);
@@ -46,6 +51,7 @@ FindPlaneErrors::FindPlaneErrors(const string & in_file_name, const TString & ru
 
 int FindPlaneErrors::Run() {
 
+  if (SinglePass) { ReadSample(); }
   PrintErrors();
   FillAllChi2();
   AdjustErrors();
@@ -76,20 +82,23 @@ int FindPlaneErrors::Run() {
 
 void FindPlaneErrors::FillAllChi2() {
 
-  FR->ResetFile();
-  FR->SetAllPlanes();
-  hChi2All.first->Reset();
-  hChi2All.second->Reset();
-  ProgressBar->reset();
-  ProgressBar->setNEvents(MaxEventNumber);
-
-  cout << "\nFilling chi2 histograms with all planes tracked." << endl;\
-  for (size_t i_event(0); FR->GetNextEvent() >= 0; ++i_event){
-    if (i_event >= MaxEventNumber) break;
-    if (FR->NTracks() != 1) { continue; }
-    ProgressBar->update(i_event);
-    hChi2All.first->Fill(FR->Track(0)->Chi2X());
-    hChi2All.second->Fill(FR->Track(0)->Chi2Y());
+  cout << "\nFilling chi2 histograms with all planes tracked." << endl;
+  if (SinglePass) {
+    FillSampleChi2(true, {});
+  } else {
+    FR->ResetFile();
+    FR->SetAllPlanes();
+    hChi2All.first->Reset();
+    hChi2All.second->Reset();
+    ProgressBar->reset();
+    ProgressBar->setNEvents(MaxEventNumber);
+    for (size_t i_event(0); FR->GetNextEvent() >= 0; ++i_event){
+      if (i_event >= MaxEventNumber) break;
+      if (FR->NTracks() != 1) { continue; }
+      ProgressBar->update(i_event);
+      hChi2All.first->Fill(FR->Track(0)->Chi2X());
+      hChi2All.second->Fill(FR->Track(0)->Chi2Y());
+    }
   }
   hChi2All.first->Scale(1 / hChi2All.first->Integral());
   hChi2All.second->Scale(1 / hChi2All.second->Integral());
@@ -101,9 +110,17 @@ void FindPlaneErrors::FillAllChi2() {
 void FindPlaneErrors::FillResChi2() {
 
   cout << "Filling Chi2 with planes under test." << endl;
+  Chi2Res.assign(NPlanes, make_pair(0, 0));
+  if (SinglePass) {
+    /** all planes under test in one pass over the sample */
+    FillSampleChi2(false, OrderedPlanes);
+    for (unsigned short i_plane(0); i_plane < NPlanes; i_plane++){
+      FitResChi2(i_plane);
+    }
+    return;
+  }
   ProgressBar->reset();
   ProgressBar->setNEvents(NPlanes * MaxEventNumber);
-  Chi2Res.assign(NPlanes, make_pair(0, 0));
   for (unsigned short i_plane(0); i_plane < NPlanes; i_plane++){
     FillResChi2(i_plane, false);
   }
@@ -111,30 +128,124 @@ void FindPlaneErrors::FillResChi2() {
 
 void FindPlaneErrors::FillResChi2(unsigned short i_plane, bool out) {
 
+  if (out) { cout << Form("Filling Chi2 with plane %i under test.", i_plane) << endl; }
+  if (SinglePass) {
+    FillSampleChi2(false, {i_plane});
+    FitResChi2(i_plane);
+    return;
+  }
   if (out) {
-    cout << Form("Filling Chi2 with plane %i under test.", i_plane) << endl;
     ProgressBar->reset();
     ProgressBar->setNEvents(MaxEventNumber);
   }
   FR->ResetFile();
   FR->SetPlaneUnderTest(i_plane);
-  hChi2Res.first->Reset();
-  hChi2Res.second->Reset();
+  hChi2Res.at(i_plane).first->Reset();
+  hChi2Res.at(i_plane).second->Reset();
   for (size_t i_event(0); FR->GetNextEvent() >= 0; ++i_event){
     if (i_event >= MaxEventNumber) break;
     ++*ProgressBar;
     if (FR->NTracks() != 1) { continue; }
-    hChi2Res.first->Fill(FR->Track(0)->Chi2X());
-    hChi2Res.second->Fill(FR->Track(0)->Chi2Y());
+    hChi2Res.at(i_plane).first->Fill(FR->Track(0)->Chi2X());
+    hChi2Res.at(i_plane).second->Fill(FR->Track(0)->Chi2Y());
   }
-  hChi2Res.first->Scale(1 / hChi2Res.first->Integral());
-  hChi2Res.second->Scale(1 / hChi2Res.second->Integral());
-  FitGammaDistRes();
+  FitResChi2(i_plane);
+}
+
+void FindPlaneErrors::FitResChi2(unsigned short i_plane) {
+
+  hChi2Res.at(i_plane).first->Scale(1 / hChi2Res.at(i_plane).first->Integral());
+  hChi2Res.at(i_plane).second->Scale(1 / hChi2Res.at(i_plane).second->Integral());
+  FitGammaDistRes(i_plane);
   SavePlots(i_plane);
   Chi2Res.at(i_plane) = make_pair(ResFit.first->GetParameter(0) - 1, ResFit.second->GetParameter(0) - 1); /** fill the deviation from the expected value of 1*/
   RealChi2Res.at(i_plane) = make_pair(ResFit.first->GetChisquare(), ResFit.second->GetChisquare());
 }
 
+void FindPlaneErrors::ReadSample() {
+  /** read and clusterize the first MaxEventNumber events once and store the cluster positions of all events with at most one
+   *  plane without exactly one cluster. The alignment does not change here, so only the errors (the weights of the fits) differ
+   *  between the iterations and every fit can be redone from the stored positions. */
+  cout << "\nReading the event sample." << endl;
+  FR->ResetFile();
+  FR->SetAllPlanes();
+  PLTTracking::TrackingAlgorithm const Algorithm = FR->fTrackingAlgorithm;
+  FR->SetTrackingAlgorithm(PLTTracking::kTrackingAlgorithm_NoTracking);  /** the tracks are fitted from the sample */
+  FR->SetPrefilter(true, (1 << NPlanes) - 1, 1);
+  ProgressBar->reset();
+  ProgressBar->setNEvents(MaxEventNumber);
+  SampleTX.clear(); SampleTY.clear(); SampleTZ.clear(); SampleFreePlane.clear();
+  vector<PLTCluster*> clusters(NPlanes);
+  for (size_t i_event(0); FR->GetNextEvent() >= 0; ++i_event){
+    if (i_event >= MaxEventNumber) break;
+    ProgressBar->update(i_event);
+    fill(clusters.begin(), clusters.end(), nullptr);
+    for (size_t i(0); i < FR->NPlanes(); i++){
+      PLTPlane * Plane = FR->Plane(i);
+      if (Plane->ROC() >= 0 and unsigned(Plane->ROC()) < NPlanes and Plane->NClusters() == 1) { clusters.at(Plane->ROC()) = Plane->Cluster(0); }
+    }
+    short free_plane(-1);
+    unsigned n_free(0);
+    for (unsigned short i_plane(0); i_plane < NPlanes; i_plane++){
+      if (clusters.at(i_plane) == nullptr) { free_plane = i_plane; n_free++; }
+    }
+    if (n_free > 1) { continue; }
+    for (unsigned short i_plane(0); i_plane < NPlanes; i_plane++){
+      PLTCluster * Cluster = clusters.at(i_plane);
+      SampleTX.emplace_back(Cluster != nullptr ? Cluster->TX() : 0);
+      SampleTY.emplace_back(Cluster != nullptr ? Cluster->TY() : 0);
+      SampleTZ.emplace_back(Cluster != nullptr ? Cluster->TZ() : 0);
+    }
+    SampleFreePlane.emplace_back(free_plane);
+  }
+  FR->SetTrackingAlgorithm(Algorithm);
+  FR->SetPrefilter(true);
+  cout << "\nStored " << SampleFreePlane.size() << " events" << endl;
+}
+
+void FindPlaneErrors::FillSampleChi2(bool all_planes, const vector<unsigned short> & planes_under_test) {
+  /** fit the stored events with all planes and/or leaving out each of the planes under test with the current errors.
+   *  The fits add the planes in the same order as the tracking, so the chi2s are the same as the ones of PLTTrack. */
+  PLTAlignment * al = FR->GetAlignment();
+  vector<float> ex(NPlanes), ey(NPlanes);
+  for (unsigned short i_plane(0); i_plane < NPlanes; i_plane++){
+    ex.at(i_plane) = al->GetErrorX(i_plane);
+    ey.at(i_plane) = al->GetErrorY(i_plane);
+  }
+  if (all_planes) {
+    hChi2All.first->Reset();
+    hChi2All.second->Reset();
+  }
+  for (auto i_plane: planes_under_test){
+    hChi2Res.at(i_plane).first->Reset();
+    hChi2Res.at(i_plane).second->Reset();
+  }
+  auto fit = [&](size_t i_event, int skip, TH1F * hx, TH1F * hy) {
+    PLTLineFit FitX, FitY;
+    unsigned n(0);
+    for (unsigned short i_plane(0); i_plane < NPlanes; i_plane++){
+      if (i_plane == skip) { continue; }
+      size_t const i = i_event * NPlanes + i_plane;
+      FitX.Add(SampleTZ[i], SampleTX[i], ex[i_plane]);
+      FitY.Add(SampleTZ[i], SampleTY[i], ey[i_plane]);
+      n++;
+    }
+    if (n > 2) {  /** tracks with two clusters have no degrees of freedom and a chi2 of 0 */
+      FitX.Solve();
+      FitY.Solve();
+    }
+    hx->Fill(float(FitX.Chi2));
+    hy->Fill(float(FitY.Chi2));
+  };
+  for (size_t i_event(0); i_event < SampleFreePlane.size(); i_event++){
+    short const free_plane = SampleFreePlane[i_event];
+    if (all_planes and free_plane == -1) { fit(i_event, -1, hChi2All.first, hChi2All.second); }
+    for (auto i_plane: planes_under_test){
+      if (free_plane == -1 or free_plane == i_plane) { fit(i_event, i_plane, hChi2Res.at(i_plane).first, hChi2Res.at(i_plane).second); }
+    }
+  }
+}
+
 pair<TF1*, TF1*> FindPlaneErrors::InitFits(bool dut) {
 
   unsigned short ndf = NPlanes - (dut ? 3 : 2);
@@ -158,24 +269,24 @@ void FindPlaneErrors::FitGammaDistAll() {
   hChi2All.second->Fit(AllFit.second, "q");
 }
 
-void FindPlaneErrors::FitGammaDistRes() {
+void FindPlaneErrors::FitGammaDistRes(unsigned short i_plane) {
 
   ResFit.first->SetParameters(1, .2);
   ResFit.second->SetParameters(1, .2);
-  hChi2Res.first->Fit(ResFit.first, "q");
-  hChi2Res.second->Fit(ResFit.second, "q");
+  hChi2Res.at(i_plane).first->Fit(ResFit.first, "q");
+  hChi2Res.at(i_plane).second->Fit(ResFit.second, "q");
 }
 
 void FindPlaneErrors::SavePlots(unsigned short i_plane) {
 
   TCanvas c;
   c.cd();
-  hChi2Res.first->SetLineColor(3);
-  hChi2Res.second->SetLineColor(3);
-  hChi2Res.first->Draw();
+  hChi2Res.at(i_plane).first->SetLineColor(3);
+  hChi2Res.at(i_plane).second->SetLineColor(3);
+  hChi2Res.at(i_plane).first->Draw();
   hChi2All.first->Draw("same");
   c.SaveAs(OutDir + Form("/FunWithChi2X_ROC%i", i_plane) + FileType);
-  hChi2Res.second->Draw();
+  hChi2Res.at(i_plane).second->Draw();
   hChi2All.second->Draw("same");
   c.SaveAs(OutDir + Form("/FunWithChi2Y_ROC%i", i_plane) + FileType);
 }
@@ -6,6 +6,7 @@
 #include <vector>
 #include <algorithm>
 #include <fstream>
+#include <stdexcept>
 #include "TString.h"
 #include "TSystem.h"
 #include "TFile.h"
@@ -85,6 +86,7 @@ AlignSettings ReadAlignSettings(vector<string> args, uint16_t n_actions) {
   struct AlignSettings AS;
   // read default
   s >> AS.max_events_ >> AS.n_iterations_ >> AS.res_thresh_ >> AS.angle_thresh_ >> AS.sil_roc_;
+  if (not (s >> AS.cache_memory_)) { AS.cache_memory_ = AlignSettings().cache_memory_; }  // optional column
   // overwrite default if argument is provided
   uint16_t i = n_actions + 2;
   if (args.size() > i) {AS.max_events_ = stoi(args.at(i++));   cout << Form("Using %i events", AS.max_events_) << endl;}
@@ -101,7 +103,7 @@ string GetMaskingFilename(){
   string path = GetDir() + Form("data/outer_pixel_masks/%i.txt", tel::Config::mask_);
   if (gSystem->AccessPathName(path.c_str())) {
     tel::critical(Form("The mask file \"%s\" does not exist!", tel::split(path, '/').back().c_str()));
-    throw;
+    throw std::runtime_error("The mask file " + path + " does not exist");
   }
   return path;
 }
@@ -111,7 +113,7 @@ string GetCalibrationPath(){
   string path = GetDir() + Form("data/calibrations/telescope%i/", tel::Config::calibration_);
   if (gSystem->OpenDirectory(path.c_str()) == nullptr) {
     tel::critical(Form("The calibration path \"%s\" does not exist!", tel::split(path, '/').back().c_str()));
-    throw;
+    throw std::runtime_error("The calibration path " + path + " does not exist");
   }
   return path + '/';
 }
@@ -163,7 +165,7 @@ int16_t GetRawID() {
   if (UseDigitalCalibration()) {
     if      (tel::Config::n_rocs_ == pl6) { return -3; }
     else if (tel::Config::n_rocs_ == pl7) { return -4; }
-    else    { tel::critical(Form("There is pixel raw alignment for %i planes!", tel::Config::n_rocs_)); throw; }
+    else    { tel::critical(Form("There is pixel raw alignment for %i planes!", tel::Config::n_rocs_)); throw std::runtime_error("no pixel raw alignment for this number of planes"); }
   } else {
     return tel::Config::year_ < year_of_change ? -1 : (tel::Config::year_ > 2020 ? -5 : -2);
   }
@@ -203,4 +205,16 @@ void ValidateDirectories(const string & run_number) {
   }
 }
 
+string GetRunNumber(const string & file_name) {
+  /** @returns: the run number in the name of a converted file (test<run>.root) */
+  return tel::trim(tel::trim(tel::split(file_name, '/').back(), "estro0"), ".");
+}
+
 bool UseGainInterpolator() { return false; }
+
+bool UseGainLookupTable() { return true; }
+
+uint64_t GetEventCacheMemory() {
+  /** @returns: memory budget of the alignment event cache in MB from config/align.txt, the remaining events are stored in a temporary file */
+  return ReadAlignSettings({}, 0).cache_memory_;
+}
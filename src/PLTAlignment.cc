@@ -2,6 +2,7 @@
 
 #include <map>
 #include <cstdlib>
+#include <stdexcept>
 #include "GetNames.h"
 #include "Utils.h"
 
@@ -35,7 +36,7 @@ void PLTAlignment::ReadAlignmentFile(const string & in_file_name, bool use_raw)
   if (!InFile.is_open()) {
     fIsGood = false;
     std::cerr << "ERROR: cannot open alignment constants filename: " << in_file_name << std::endl;
-    throw;
+    throw std::runtime_error("cannot open alignment constants filename: " + in_file_name);
   }
 
   // Read each line in file
@@ -105,7 +106,9 @@ void PLTAlignment::ReadAlignmentFile(const string & in_file_name, bool use_raw)
   if (fTelescopeMap.empty()){
     tel::warning(Form("Did not find telescope %i in the alignments file %s", tel::Config::telescope_id_, tel::split(in_file_name, '/').back().c_str()));
     ReadAlignmentFile(in_file_name, true);
+    return;
   }
+  UpdatePixelTables();
 } // end ReadAlignmentFile
 
 
@@ -142,7 +145,7 @@ void PLTAlignment::WriteAlignmentFile (const uint16_t telescop_id, const uint16_
   ifstream in(GetAlignmentFilename());
   if (!in) {
     std::cerr << "ERROR: cannot open file: " << GetAlignmentFilename() << endl;
-    throw;
+    throw std::runtime_error("cannot open file: " + GetAlignmentFilename());
   }
   cout << "Writing aligment to file " << GetAlignmentFilename() << endl;
   while (getline(in, line_str)) { lines.emplace_back(line_str); }
@@ -197,8 +200,88 @@ std::pair<float, float> PLTAlignment::PXYDistFromLXYDist (std::pair<float, float
 }
 
 
+void PLTAlignment::UpdatePixelTable (int const ch, int const roc)
+{
+  if (roc < 0 or GetCP(ch, roc) == 0x0) {
+    return;
+  }
+  if (roc >= int(fPixelTables.size())) {
+    fPixelTables.resize(roc + 1);
+  }
+  PixelTable & Table = fPixelTables[roc];
+  if (Table.Channel != -1 and Table.Channel != ch) {
+    return;  // only one channel per ROC has a table, the others use the direct calculation
+  }
+  Table.Channel = ch;
+  Table.Frame = MakeFrame(*GetCP(ch, roc));
+  Table.Pixels.resize(PLTU::NCOL * PLTU::NROW);
+
+  for (int PX = PLTU::FIRSTCOL; PX != PLTU::FIRSTCOL + PLTU::NCOL; ++PX) {
+    for (int PY = PLTU::FIRSTROW; PY != PLTU::FIRSTROW + PLTU::NROW; ++PY) {
+      PixelCoordinates & P = Table.Pixels[(PX - PLTU::FIRSTCOL) * PLTU::NROW + PY - PLTU::FIRSTROW];
+      P.LX = PXtoLX(PX);
+      P.LY = PYtoLY(PY);
+      XYZ const T = LtoT(P.LX, P.LY, ch, roc), G = TtoG(T, ch, roc);
+      P.TX = T.X; P.TY = T.Y; P.TZ = T.Z;
+      P.GX = G.X; P.GY = G.Y; P.GZ = G.Z;
+    }
+  }
+}
+
+
+PLTAlignment::PlaneFrame PLTAlignment::MakeFrame (CP const & C)
+{
+  return {cos(C.LR), sin(C.LR), C.LX, C.LY, C.LZ, cos(C.GRZ), sin(C.GRZ), cos(C.GRY), sin(C.GRY), C.GX, C.GY, C.GZ};
+}
+
+
+PLTAlignment::PlaneFrame const * PLTAlignment::FindFrameSlow (int const ch, int const roc)
+{
+  /** planes without pixel table (another channel on the same ROC) are calculated on every call */
+  CP* C = GetCP(ch, roc);
+  if (C == 0x0) {
+    return nullptr;
+  }
+  static thread_local PlaneFrame F;
+  F = MakeFrame(*C);
+  return &F;
+}
+
+
+PLTAlignment::PlaneFrame const & PLTAlignment::Frame (int const ch, int const roc)
+{
+  PlaneFrame const * F = FindFrame(ch, roc);
+  if (F == nullptr) {
+    std::string const Message = Form("cannot grab the constant map for this CH ROC: %i %i", ch, roc);
+    tel::critical(Message);
+    throw std::out_of_range(Message);
+  }
+  return *F;
+}
+
+
+void PLTAlignment::UpdatePixelTables ()
+{
+  fPixelTables.clear();
+  for (auto & it: fConstantMap) {
+    UpdatePixelTable(it.first.first, it.first.second);
+  }
+}
+
+
 void PLTAlignment::AlignHit (PLTHit& Hit)
 {
+  int const Col = Hit.Column() - PLTU::FIRSTCOL;
+  int const Row = Hit.Row() - PLTU::FIRSTROW;
+  int const ROC = Hit.ROC();
+  if (ROC < int(fPixelTables.size()) and fPixelTables[ROC].Channel == Hit.Channel() and Col >= 0 and Col < PLTU::NCOL and Row >= 0 and Row < PLTU::NROW) {
+    const PixelCoordinates & P = fPixelTables[ROC].Pixels[Col * PLTU::NROW + Row];
+    Hit.SetLXY(P.LX, P.LY);
+    Hit.SetTXYZ(P.TX, P.TY, P.TZ);
+    Hit.SetGXYZ(P.GX, P.GY, P.GZ);
+    return;
+  }
+
   // Grab the constants and check that they are there..
   CP* C = GetCP(Hit.Channel(), Hit.ROC());
   if (C == 0x0) {
@@ -213,26 +296,19 @@ void PLTAlignment::AlignHit (PLTHit& Hit)
   float LX = PXtoLX(PX);
   float LY = PYtoLY(PY);
 
-//  std::cout << LX << " " << LY << std::endl;
-
-  std::vector<float> TXYZ;
-  LtoTXYZ(TXYZ, LX, LY, Hit.Channel(), Hit.ROC());
-
+  XYZ const T = LtoT(LX, LY, Hit.Channel(), Hit.ROC());
 
   if (DEBUG) {
-    printf("TtoL - L XY DIFF %12.3f %12.3f\n",
-        TtoLX(TXYZ[0], TXYZ[1], Hit.Channel(), Hit.ROC()) - LX,
-        TtoLY(TXYZ[0], TXYZ[1], Hit.Channel(), Hit.ROC()) - LY);
+    std::pair<float, float> const L = TtoLXY(T.X, T.Y, Hit.Channel(), Hit.ROC());
+    printf("TtoL - L XY DIFF %12.3f %12.3f\n", L.first - LX, L.second - LY);
   }
 
-  std::vector<float> GXYZ;
-  TtoGXYZ(GXYZ, TXYZ[0], TXYZ[1], TXYZ[2], Hit.Channel(), Hit.ROC());
-
+  XYZ const G = TtoG(T, Hit.Channel(), Hit.ROC());
 
   // Set the local, telescope, and global hit coords
   Hit.SetLXY(LX, LY);
-  Hit.SetTXYZ(TXYZ[0], TXYZ[1], TXYZ[2]);
-  Hit.SetGXYZ(GXYZ[0], GXYZ[1], GXYZ[2]);
+  Hit.SetTXYZ(T.X, T.Y, T.Z);
+  Hit.SetGXYZ(G.X, G.Y, G.Z);
 
   //printf("Channel %2i ROC %1i  Col %2i Row %2i  %12.3E  %12.3E - %12.3E  %12.3E  %12.3E - %12.3E  %12.3E  %12.3E\n",
   //    Hit.Channel(), Hit.ROC(), Hit.Column(), Hit.Row(), LX, LY, TXYZ[0], TXYZ[1], TXYZ[2], GXYZ[0], GXYZ[1], GXYZ[2]);
@@ -249,214 +325,51 @@ void PLTAlignment::AlignHit (PLTHit& Hit)
 
 
 
-float PLTAlignment::GetTZ (int const Channel, int const ROC)
-{
-  return GetCP(Channel, ROC)->LZ;
-}
-
-
-
-
-float PLTAlignment::TtoLX (float const TX, float const TY, int const Channel, int const ROC)
-{
-  return TtoLXY(TX, TY, Channel, ROC).first;
-}
-
-
-float PLTAlignment::TtoLY (float const TX, float const TY, int const Channel, int const ROC)
-{
-  return TtoLXY(TX, TY, Channel, ROC).second;
-}
-
-
-std::pair<float, float> PLTAlignment::TtoLXY (float const TX, float const TY, int const Channel, int const ROC)
-{
-  std::pair<int, int> CHROC = std::make_pair(Channel, ROC);
-  CP* C = fConstantMap.count(CHROC) == 1 ? &fConstantMap[CHROC] : (CP*) 0x0;
-
-  if (!C) {
-//    std::cerr << "ERROR: cannot grab the constant mape for this CH ROC: " << CHROC.first << " " << CHROC.second << std::endl;
-    return std::make_pair(-999, -999);
-  }
-
-
-  float const LXA = TX - C->LX;
-  float const LYA = TY - C->LY;
-
-
-  float const cl = cos(C->LR);
-  float const sl = sin(C->LR);
-
-
-  float const LX =  LXA * cl + LYA * sl;
-  float const LY = -LXA * sl + LYA * cl;
-
-  //printf("XY DIFF %12.3f  %12.3f\n", TX - LX, TY - LY);
-
-  return std::make_pair(LX, LY);
-}
-
-
-void PLTAlignment::VTtoVGXYZ (std::vector<float>& VOUT, float const TX, float const TY, float const TZ, int const Channel, int const ROC)
-{
-  // Get the constants for this telescope/plane etc
-  std::pair<int, int> CHROC = std::make_pair(Channel, ROC);
-  CP* C = fConstantMap.count(CHROC) == 1 ? &fConstantMap[CHROC] : (CP*) 0x0;
-
-  if (!C) {
-    std::cerr << "ERROR: cannot grab the constant mape for this CH ROC: " << CHROC.first << " " << CHROC.second << std::endl;
-    return;
-    throw;
-  }
-
-  // Global rotation about Zaxis
-  float const cgz = cos(C->GRZ);
-  float const sgz = sin(C->GRZ);
-  float GXZ = TX * cgz - TY * sgz;
-  float GYZ = TX * sgz + TY * cgz;
-  float GZZ = TZ;
-
-
-  // Global rotation about Yaxis
-  float const cgy = cos(C->GRY);
-  float const sgy = sin(C->GRY);
-  float GXY = GXZ * cgy + GZZ * sgy;
-  float GYY = GYZ;
-  float GZY = GZZ * cgy - GXZ * sgy;
-
-  VOUT.resize(3, 0);
-  VOUT[0] = GXY;
-  VOUT[1] = GYY;
-  VOUT[2] = GZY;
-
-
-  return;
-}
-
 void PLTAlignment::LtoTXYZ (std::vector<float>& VOUT, float const LX, float const LY, int const Channel, int const ROC)
 {
-  std::pair<int, int> CHROC = std::make_pair(Channel, ROC);
-  CP* C = fConstantMap.count(CHROC) == 1 ? &fConstantMap[CHROC] : (CP*) 0x0;
-//  std::cout << C->LR << std::endl;
-
-  if (!C) {
-    std::cerr << "ERROR: cannot grab the constant map for this CH ROC: " << CHROC.first << " " << CHROC.second << std::endl;
-    throw;
-  }
-
-  // Start with local rotation
-  float const cl = cos(C->LR);
-  float const sl = sin(C->LR);
-  float TX = LX * cl - LY * sl;
-  float TY = LX * sl + LY * cl;
-  float TZ = C->LZ;
-
-  // Local translation
-  TX += C->LX;
-  TY += C->LY;
-
-  VOUT.resize(3);
-  VOUT[0] = TX;
-  VOUT[1] = TY;
-  VOUT[2] = TZ;
-
-  return;
+  XYZ const T = LtoT(LX, LY, Channel, ROC);
+  VOUT.assign({T.X, T.Y, T.Z});
 }
 
 
 void PLTAlignment::TtoGXYZ (std::vector<float>& VOUT, float const TX, float const TY, float const TZ, int const Channel, int const ROC)
 {
-  // Get the constants for this telescope/plane etc
-  std::pair<int, int> CHROC = std::make_pair(Channel, ROC);
-  CP* C = fConstantMap.count(CHROC) == 1 ? &fConstantMap[CHROC] : (CP*) 0x0;
-
-  if (!C) {
-    std::cerr << "ERROR: cannot grab the constant mape for this CH ROC: " << CHROC.first << " " << CHROC.second << std::endl;
+  if (FindFrame(Channel, ROC) == nullptr) {
+    std::cerr << "ERROR: cannot grab the constant map for this CH ROC: " << Channel << " " << ROC << std::endl;
     return;
-    throw;
   }
-
-  // Global rotation about Zaxis
-  float const cgz = cos(C->GRZ);
-  float const sgz = sin(C->GRZ);
-  float GXZ = TX * cgz - TY * sgz;
-  float GYZ = TX * sgz + TY * cgz;
-  float GZZ = TZ;
-
-  GXZ += C->GX;
-  GYZ += C->GY;
-  GZZ += C->GZ;
-
-
-  // Global rotation about Yaxis
-  float const cgy = cos(C->GRY);
-  float const sgy = sin(C->GRY);
-  float GXY = GXZ * cgy + GZZ * sgy;
-  float GYY = GYZ;
-  float GZY = GZZ * cgy - GXZ * sgy;
-
-  VOUT.resize(3, 0);
-  VOUT[0] = GXY;
-  VOUT[1] = GYY;
-  VOUT[2] = GZY;
-
-
-  return;
+  XYZ const G = TtoG({TX, TY, TZ}, Channel, ROC);
+  VOUT.assign({G.X, G.Y, G.Z});
 }
 
 
-
 void PLTAlignment::LtoGXYZ (std::vector<float>& VOUT, float const LX, float const LY, int const Channel, int const ROC)
 {
-  std::vector<float> T;
-  LtoTXYZ(T, LX, LY, Channel, ROC);
-  TtoGXYZ(VOUT, T[0], T[1], T[2], Channel, ROC);
+  XYZ const G = LtoG(LX, LY, Channel, ROC);
+  VOUT.assign({G.X, G.Y, G.Z});
 }
 
 
-
 void PLTAlignment::GtoTXYZ (std::vector<float>& VOUT, float const GX, float const GY, float const GZ, int const Channel, int const ROC)
 {
   // This translates global coordinates back to the telescope coordinates
-
-  // Get the constants for this telescope/plane etc
-  std::pair<int, int> CHROC = std::make_pair(Channel, ROC);
-  CP* C = fConstantMap.count(CHROC) == 1 ? &fConstantMap[CHROC] : (CP*) 0x0;
-
-  if (!C) {
-    std::cerr << "ERROR: cannot grab the constant mape for this CH ROC: " << CHROC.first << " " << CHROC.second << std::endl;
+  if (FindFrame(Channel, ROC) == nullptr) {
+    std::cerr << "ERROR: cannot grab the constant map for this CH ROC: " << Channel << " " << ROC << std::endl;
     return;
-    throw;
   }
+  XYZ const T = GtoT({GX, GY, GZ}, Channel, ROC);
+  VOUT.assign({T.X, T.Y, T.Z});
+}
 
-  // Global rotation about Yaxis
-  float const cgy = cos(C->GRY);
-  float const sgy = sin(C->GRY);
-  float GXY = GX * cgy - GZ * sgy;
-  float GYY = GY;
-  float GZY = GZ * cgy + GX * sgy;
-
-
-  float const GXA = GXY - C->GX;
-  float const GYA = GYY - C->GY;
-  float const GZA = GZY - C->GZ;
-
-
-  float const cl = cos(C->GRZ);
-  float const sl = sin(C->GRZ);
-
-
-  float const TX =  GXA * cl + GYA * sl;
-  float const TY = -GXA * sl + GYA * cl;
-  float const TZ =  GZA;
-
-
-  VOUT.resize(3);
-  VOUT[0] = TX;
-  VOUT[1] = TY;
-  VOUT[2] = TZ;
 
-  return;
+void PLTAlignment::VTtoVGXYZ (std::vector<float>& VOUT, float const TX, float const TY, float const TZ, int const Channel, int const ROC)
+{
+  if (FindFrame(Channel, ROC) == nullptr) {
+    std::cerr << "ERROR: cannot grab the constant map for this CH ROC: " << Channel << " " << ROC << std::endl;
+    return;
+  }
+  XYZ const G = VTtoVG({TX, TY, TZ}, Channel, ROC);
+  VOUT.assign({G.X, G.Y, G.Z});
 }
 
 
@@ -565,6 +478,7 @@ void PLTAlignment::AddToLR (int const ch, int const roc, float val)
 {
   float oldval = fConstantMap[ std::make_pair(ch, roc) ].LR;
   fConstantMap[ std::make_pair(ch, roc) ].LR = oldval+val;
+  UpdatePixelTable(ch, roc);
 }
 
 
@@ -572,6 +486,7 @@ void PLTAlignment::AddToLX (int const ch, int const roc, float val)
 {
   float oldval = fConstantMap[ std::make_pair(ch, roc) ].LX;
   fConstantMap[ std::make_pair(ch, roc) ].LX = oldval+val;
+  UpdatePixelTable(ch, roc);
 }
 
 
@@ -579,6 +494,7 @@ void PLTAlignment::AddToLY (int const ch, int const roc, float val)
 {
   float oldval = fConstantMap[ std::make_pair(ch, roc) ].LY;
   fConstantMap[ std::make_pair(ch, roc) ].LY = oldval+val;
+  UpdatePixelTable(ch, roc);
 }
 
 
@@ -586,6 +502,7 @@ void PLTAlignment::AddToLZ (int const ch, int const roc, float val)
 {
   float oldval = fConstantMap[ std::make_pair(ch, roc) ].LZ;
   fConstantMap[ std::make_pair(ch, roc) ].LZ = oldval+val;
+  UpdatePixelTable(ch, roc);
 }
 
 void PLTAlignment::AddToGX (int const ch, float val)
@@ -595,6 +512,7 @@ void PLTAlignment::AddToGX (int const ch, float val)
   fConstantMap[ std::make_pair(ch, 0) ].GX = oldval+val;
   fConstantMap[ std::make_pair(ch, 1) ].GX = oldval+val;
   fConstantMap[ std::make_pair(ch, 2) ].GX = oldval+val;
+  for (int roc = 0; roc != 3; ++roc) { UpdatePixelTable(ch, roc); }
 }
 
 
@@ -605,6 +523,7 @@ void PLTAlignment::AddToGY (int const ch, float val)
   fConstantMap[ std::make_pair(ch, 0) ].GY = oldval+val;
   fConstantMap[ std::make_pair(ch, 1) ].GY = oldval+val;
   fConstantMap[ std::make_pair(ch, 2) ].GY = oldval+val;
+  for (int roc = 0; roc != 3; ++roc) { UpdatePixelTable(ch, roc); }
 }
 
 
@@ -615,6 +534,7 @@ void PLTAlignment::AddToGZ (int const ch, float val)
   fConstantMap[ std::make_pair(ch, 0) ].GZ = oldval+val;
   fConstantMap[ std::make_pair(ch, 1) ].GZ = oldval+val;
   fConstantMap[ std::make_pair(ch, 2) ].GZ = oldval+val;
+  for (int roc = 0; roc != 3; ++roc) { UpdatePixelTable(ch, roc); }
 }
 
 void PLTAlignment::SetErrors(int telescopeID, bool initial){
@@ -767,4 +687,5 @@ void PLTAlignment::ResetPlane(int const ch, int const roc) {
   fConstantMap[std::make_pair(ch, roc)].LX = 0;
   fConstantMap[std::make_pair(ch, roc)].LY = 0;
   fConstantMap[std::make_pair(ch, roc)].LR = 0;
+  UpdatePixelTable(ch, roc);
 }
@@ -1,17 +1,30 @@
 #include "PLTAnalysis.h"
 #include "Utils.h"
+#include "StageTimer.h"
+
+#include <thread>
+#include <atomic>
+#include <memory>
+#include <algorithm>
+#include <stdexcept>
+#include "TROOT.h"
 
 using namespace std;
 
-PLTAnalysis::PLTAnalysis(string const & inFileName, TFile * Out_f,  TString const & runNumber, uint8_t const TelescopeID, bool TrackOnlyTelescope, uint64_t max_event_nr):
+PLTAnalysis::PLTAnalysis(string const & inFileName, TFile * Out_f,  TString const & runNumber, uint8_t const TelescopeID, bool TrackOnlyTelescope, uint64_t max_event_nr,
+                         uint16_t n_threads, int16_t process_shard, uint16_t n_process_shards):
     Action(inFileName, runNumber),
     telescopeID(TelescopeID),
-    now1(clock()), now2(clock()), loop(0), startProg(0), endProg(0), allProg(0), averTime(0),
+    now1(tel::wall_time()), now2(tel::wall_time()), loop(0), startProg(0), endProg(0), allProg(0), averTime(0),
     TimeWidth(20000), StartTime(0), NGraphPoints(0),
-    PHThreshold(3e5), is_root_file_(IsROOTFile(inFileName)), trackOnlyTelescope(TrackOnlyTelescope)
+    PHThreshold(3e5), is_root_file_(IsROOTFile(inFileName)), FW(nullptr), trackOnlyTelescope(TrackOnlyTelescope),
+    n_threads_(is_root_file_ ? max(n_threads, uint16_t(1)) : uint16_t(1)), shard_(-1), first_entry_(0), last_shard_(true),
+    process_shard_(n_process_shards > 1 ? process_shard : int16_t(-1)), n_process_shards_(max(n_process_shards, uint16_t(1))), n_drawn_tracks_(0)
 {
     out_f = Out_f;
     /** set up root */
+    /** the shards and the writer thread of the tracking tree read the input file in parallel */
+    if (n_threads_ > 1 or UseFileWriter()) { ROOT::EnableThreadSafety(); }
     gStyle->SetOptStat(0);
     gErrorIgnoreLevel = kWarning;
     /** single plane studies */
@@ -20,25 +33,77 @@ PLTAnalysis::PLTAnalysis(string const & inFileName, TFile * Out_f,  TString cons
     FR = InitFileReader();
     if (is_root_file_) nEntries = ((PSIRootFileReader*) FR)->fTree->GetEntries();
     stopAt = max_event_nr ? max_event_nr : nEntries;
+    last_entry_ = stopAt;
+    /** restrict to the selected entry range and to the part of this process if the run is split over several processes */
+    if (is_root_file_) {
+        first_entry_ = min(entry_range_.first, nEntries);
+        if (entry_range_.second >= 0) { last_entry_ = min(last_entry_, uint32_t(entry_range_.second)); }
+        if (first_entry_ > last_entry_ or first_entry_ >= nEntries) {
+            string const msg = Form("The entry range %u - %u does not contain any of the %u entries", first_entry_, last_entry_, nEntries);
+            tel::critical(msg);
+            throw invalid_argument(msg);
+        }
+    }
+    if (process_shard_ >= 0) {
+        if (not is_root_file_) {
+            string const msg = "Splitting a run over several processes requires a ROOT file";
+            tel::critical(msg);
+            throw invalid_argument(msg);
+        }
+        uint32_t const first = first_entry_, last = last_entry_;
+        if (n_process_shards_ > NPoints(first, last) or process_shard_ >= n_process_shards_) {
+            string const msg = Form("Cannot analyse shard %i of %i: the run has only %i pulse height points", process_shard_, n_process_shards_, NPoints(first, last));
+            tel::critical(msg);
+            throw invalid_argument(msg);
+        }
+        last_shard_ = process_shard_ + 1 == n_process_shards_;
+        first_entry_ = SplitEntry(first, last, uint32_t(process_shard_), n_process_shards_);
+        last_entry_ = last_shard_ ? last : SplitEntry(first, last, uint32_t(process_shard_ + 1), n_process_shards_) - 1;
+        tel::info(Form("Analysing the entries %u - %u as shard %i of %i", first_entry_, last_entry_, process_shard_, n_process_shards_));
+    }
+    ThisTime = first_entry_;
+    NGraphPoints = GraphPoint(first_entry_);
+    if (is_root_file_) { ((PSIRootFileReader*) FR)->SetEntryRange(int(first_entry_), int(last_entry_)); }
     /** apply masking */
     FR->ReadPixelMask(GetMaskingFilename());
     /** init histos */
     Histos = new RootItems(run_number_);
     DiaZ = getDiaZPositions();
     cout << "Output directory: " << Histos->getOutDir() << endl;
-    /** init file writer */
+    /** init file writer, the shards of a parallel analysis write their own parts */
+    if (UseFileWriter() and n_threads_ == 1)
+      FW = new FileWriterTracking(in_file_name_, FR, -1, first_entry_, process_shard_);
+    PBar = new tel::ProgressBar(last_entry_ - 1);
+}
+
+PLTAnalysis::PLTAnalysis(PLTAnalysis & main, int16_t shard, uint32_t first_entry, uint32_t last_entry, bool last_shard):
+    Action(main.in_file_name_, main.run_number_),
+    telescopeID(main.telescopeID), out_f(main.out_f),
+    now1(tel::wall_time()), now2(tel::wall_time()), loop(0), startProg(0), endProg(0), allProg(0), averTime(0),
+    TimeWidth(main.TimeWidth), StartTime(main.StartTime), ThisTime(first_entry), NGraphPoints(main.GraphPoint(first_entry)),
+    PHThreshold(main.PHThreshold), is_root_file_(main.is_root_file_), nEntries(main.nEntries), FW(nullptr), stopAt(main.stopAt),
+    trackOnlyTelescope(main.trackOnlyTelescope), DiaZ(main.DiaZ),
+    n_threads_(1), shard_(shard), first_entry_(first_entry), last_entry_(last_entry), last_shard_(last_shard),
+    process_shard_(main.process_shard_), n_process_shards_(main.n_process_shards_), n_drawn_tracks_(0)
+{
+    /** every shard reads the file with its own reader */
+    FR = InitFileReader();
+    FR->ReadPixelMask(GetMaskingFilename());
+    ((PSIRootFileReader*) FR)->GoToEntry(int(first_entry_));
+    Histos = new RootItems(*main.Histos, uint16_t(shard_));
     if (UseFileWriter())
-      FW = new FileWriterTracking(in_file_name_, FR);
-    PBar = new tel::ProgressBar(stopAt - 1);
+      FW = new FileWriterTracking(in_file_name_, FR, shard_, first_entry_, process_shard_);
+    PBar = shard_ == 0 ? new tel::ProgressBar(last_entry_) : nullptr;
 }
 
 PLTAnalysis::~PLTAnalysis()
 {
   if (UseFileWriter()) {
-    FW->saveTree();
+    if (FW != nullptr) { FW->saveTree(); }
     delete FR;
   }
     delete FW;
+    if (shard_ >= 0) { delete Histos; }
 //    delete Histos; // This causes it to crash for some unknown reason...
 }
 
@@ -49,16 +114,27 @@ PLTAnalysis::~PLTAnalysis()
  void PLTAnalysis::EventLoop(){
 
     getTime(now1, startProg);
-    now1 = clock();
+    now1 = tel::wall_time();
+    if (n_threads_ > 1) { ParallelEventLoop(); }
+    else { ProcessEvents(); }
+
+    cout << endl;
+    getTime(now1, loop);
+    now1 = tel::wall_time();
+ }
+ void PLTAnalysis::ProcessEvents(){
+
 //    cout << "stopAt = " << stopAt << endl;
 //        stopAt = 1e5;
-    for (uint32_t ievent = 0; FR->GetNextEvent() >= 0; ++ievent) {
-        if (ievent > stopAt) break;
+    for (uint32_t ievent = first_entry_; FR->GetNextEvent() >= 0; ++ievent) {
+        if (ievent > last_entry_) break;
         ThisTime = ievent;
 
-        PBar->update(ievent);
+        if (PBar != nullptr) { PBar->update(ievent); }
         /** file writer */
         if (is_root_file_) { WriteTrackingTree(); }
+        /** everything below fills the histograms */
+        tel::ScopedStage timer(tel::Stage::HistoFill);
 
         /** fill coincidence map */
         Histos->CoincidenceMap()->Fill(FR->HitPlaneBits() );
@@ -68,7 +144,7 @@ PLTAnalysis::~PLTAnalysis()
             MakeAvgPH();
 
         /** draw tracks if there is more than one hit*/
-        DrawTracks();
+        if (shard_ <= 0 and process_shard_ <= 0) { DrawTracks(); }
 
         /** loop over the planes */
         for (uint8_t iplane = 0; iplane != FR->NPlanes(); ++iplane) {
@@ -192,12 +268,42 @@ PLTAnalysis::~PLTAnalysis()
 
 
     } /** END OF EVENT LOOP */
-    /** add the last point to the average pulse height graph */
+    /** add the last point to the average pulse height graph, inside a parallel loop it is closed by the first entry of the next shard */
+    if (not last_shard_) { ThisTime = last_entry_ + 1; }
     MakeAvgPH();
-
-    cout << endl;
-    getTime(now1, loop);
-    now1 = clock();
+ }
+ void PLTAnalysis::ParallelEventLoop(){
+
+    /** split the entries at the borders of the average pulse height points such that each point is filled by a single shard */
+    uint32_t const n_shards = min(uint32_t(n_threads_), NPoints(first_entry_, last_entry_));
+    vector<PLTAnalysis*> shards;
+    for (uint32_t i = 0; i != n_shards; ++i) {
+        bool last = i + 1 == n_shards;
+        uint32_t first_entry = SplitEntry(first_entry_, last_entry_, i, n_shards);
+        uint32_t last_entry = last ? last_entry_ : SplitEntry(first_entry_, last_entry_, i + 1, n_shards) - 1;
+        shards.push_back(new PLTAnalysis(*this, int16_t(i), first_entry, last_entry, last and last_shard_));
+    }
+    tel::info(Form("Running the event loop with %i threads", n_shards));
+    vector<thread> threads;
+    for (auto * shard: shards) { threads.emplace_back(&PLTAnalysis::ProcessEvents, shard); }
+    for (auto & t: threads) { t.join(); }
+
+    /** merge the shards in the order of the entries */
+    vector<string> parts;
+    for (auto * shard: shards) {
+        Histos->Merge(*shard->Histos);
+        Histos->MergeAveragePH(*shard->Histos, GraphPoint(shard->first_entry_), shard->NGraphPoints);
+        NGraphPoints = shard->NGraphPoints;
+        ThisTime = shard->ThisTime;
+        if (shard->FW != nullptr) {
+            shard->FW->saveTree();
+            parts.push_back(shard->FW->FileName());
+            delete shard->FW;
+            shard->FW = nullptr;
+        }
+        delete shard;
+    }
+    if (not parts.empty()) { FileWriterTracking::mergeFiles(parts, in_file_name_, ((PSIRootFileReader*) FR)->fMacro, process_shard_); }
  }
 /** ============================
  AFTER LOOP -> FINISH
@@ -206,10 +312,15 @@ PLTAnalysis::~PLTAnalysis()
 
     out_f->cd();
 
-    Histos->SaveAllHistos();
+    /** the shards of a split run are only drawn after merging */
+    if (process_shard_ >= 0) {
+        Histos->WriteShard(out_f, GraphPoint(first_entry_), NGraphPoints);
+    } else {
+        Histos->SaveAllHistos();
 
-    /** make index.html as overview */
-  WriteHTML(Histos->getPlotsDir() + run_number_, telescopeID);
+        /** make index.html as overview */
+        WriteHTML(Histos->getPlotsDir() + run_number_, telescopeID);
+    }
 
     getTime(now1, endProg);
     getTime(now2, allProg);
@@ -224,9 +335,131 @@ PLTAnalysis::~PLTAnalysis()
 }
 
 
+void PLTAnalysis::MergeShards(string const & inFileName, TFile * Out_f, TString const & runNumber, uint8_t const TelescopeID, uint16_t n_shards){
+
+    /** add the shards in the order of the entries such that the average pulse height graphs are continuous */
+    Out_f->cd();
+    auto * Histos = new RootItems(runNumber);
+    vector<string> histo_files, parts;
+    for (uint16_t i = 0; i != n_shards; ++i) {
+        histo_files.push_back(ShardFileName(runNumber, int16_t(i)));
+        TFile f(histo_files.back().c_str());
+        if (not f.IsOpen()) {
+            string const msg = "Cannot open the shard file " + histo_files.back();
+            tel::critical(msg);
+            throw runtime_error(msg);
+        }
+        Histos->AddShard(&f);
+        f.Close();
+        string const tree_file = FileWriterTracking::shardFileName(inFileName, int16_t(i));
+        if (not gSystem->AccessPathName(tree_file.c_str())) { parts.push_back(tree_file); }
+    }
+    Out_f->cd();
+    Histos->SaveAllHistos();
+    WriteHTML(Histos->getPlotsDir() + runNumber, TelescopeID);
+    for (const auto & file_name: histo_files) { gSystem->Unlink(file_name.c_str()); }
+
+    /** the shard trees are concatenated like the parts of a parallel analysis */
+    if (not parts.empty()) {
+        TFile in_file(inFileName.c_str());
+        FileWriterTracking::mergeFiles(parts, inFileName, dynamic_cast<TMacro*>(in_file.Get("region_information")));
+    }
+    tel::info(Form("Merged %i shards of run %s", n_shards, runNumber.Data()));
+}
+
+
+int AnalyseRunList(string const & RunListFileName, uint16_t n_workers, uint16_t n_threads){
+
+    struct Run {
+        string FileName;
+        int16_t TelescopeID;
+        bool TrackOnlyTelescope;
+    };
+    ifstream f(RunListFileName);
+    if (not f.is_open()) {
+        tel::critical("Cannot open the run list " + RunListFileName);
+        return 1;
+    }
+    vector<Run> runs;
+    for (string line; getline(f, line); ) {
+        if (tel::trim(line).empty() or tel::trim(line).at(0) == '#') continue;
+        istringstream s(line);
+        Run R{"", 0, false};
+        int track_only = 0;
+        if (not (s >> R.FileName >> R.TelescopeID)) {
+            tel::warning("Skipping invalid line of the run list: " + line);
+            continue;
+        }
+        s >> track_only;
+        R.TrackOnlyTelescope = bool(track_only);
+        runs.push_back(R);
+    }
+    tel::info(Form("Analysing %zu runs with %i workers", runs.size(), max(n_workers, uint16_t(1))));
+
+    /** the configuration is global, so the telescopes are processed one after the other and only their runs in parallel */
+    stable_sort(runs.begin(), runs.end(), [] (const Run & a, const Run & b) { return a.TelescopeID < b.TelescopeID; });
+    PSIFileReader::KeepCalibrations = true;
+    if (n_workers > 1 or n_threads > 1) { ROOT::EnableThreadSafety(); }
+    int n_failed = 0;
+    for (auto first = runs.begin(); first != runs.end(); ) {
+        auto last = find_if(first, runs.end(), [&first] (const Run & R) { return R.TelescopeID != first->TelescopeID; });
+        auto const n_runs = size_t(last - first);
+        if (tel::Config::Read(first->TelescopeID) == 0) {
+            n_failed += int(n_runs);
+            first = last;
+            continue;
+        }
+        atomic<size_t> next(0);
+        auto worker = [&] () {
+            for (size_t i = next++; i < n_runs; i = next++) {
+                const Run & R = first[i];
+                string const run_number = GetRunNumber(R.FileName);
+                unique_ptr<TFile> out_f;
+                unique_ptr<PLTAnalysis> Analysis;
+                /** a failing run is counted and skipped, the other runs of the batch continue */
+                try {
+                    {
+                        lock_guard<mutex> lock(PLTAnalysis::RootMutex());
+                        tel::info(Form("Starting run %s of telescope %i", run_number.c_str(), R.TelescopeID));
+                        ValidateDirectories(run_number);
+                        out_f.reset(new TFile(Form("%s/plots/%s/histos.root", GetDir().c_str(), run_number.c_str()), "recreate"));
+                        Analysis.reset(new PLTAnalysis(R.FileName, out_f.get(), run_number, uint8_t(R.TelescopeID), R.TrackOnlyTelescope, 0, n_threads));
+                    }
+                    Analysis->EventLoop();
+                    lock_guard<mutex> lock(PLTAnalysis::RootMutex());
+                    Analysis->FinishAnalysis();
+                    Analysis.reset();
+                    out_f->Close();
+                } catch (const exception & e) {
+                    lock_guard<mutex> lock(PLTAnalysis::RootMutex());
+                    tel::critical(Form("Run %s of telescope %i failed: %s", run_number.c_str(), R.TelescopeID, e.what()));
+                    Analysis.reset();
+                    if (out_f) { out_f->Close(); }
+                    n_failed++;
+                }
+            }
+        };
+        vector<thread> threads;
+        for (size_t i = 0; i != min(size_t(max(n_workers, uint16_t(1))), n_runs); ++i) { threads.emplace_back(worker); }
+        for (auto & t: threads) { t.join(); }
+        first = last;
+    }
+    return n_failed;
+}
+
+
 /** ============================
  AUXILIARY FUNCTIONS
  =================================*/
+string PLTAnalysis::ShardFileName(TString const & runNumber, int16_t shard) {
+    return Form("%s/plots/%s/histos_shard%i.root", GetDir().c_str(), runNumber.Data(), shard);
+}
+
+mutex & PLTAnalysis::RootMutex() {
+    static mutex m;
+    return m;
+}
+
 void PLTAnalysis::SinglePlaneStudies(){
 
     if ((telescopeID == 1) || (telescopeID == 2)){
@@ -238,9 +471,28 @@ void PLTAnalysis::SinglePlaneStudies(){
     }
 }
 
-float PLTAnalysis::getTime(float now, float & time){
+uint16_t PLTAnalysis::GraphPoint(uint32_t entry) const {
+    /** point of the average pulse height graph which contains the entry */
+    return uint16_t(entry == 0 ? 0 : (entry - 1) / TimeWidth);
+}
+
+uint32_t PLTAnalysis::FirstEntry(uint16_t graph_point) const {
+    return graph_point == 0 ? 0 : graph_point * TimeWidth + 1;
+}
+
+uint32_t PLTAnalysis::NPoints(uint32_t first, uint32_t last) const {
+    /** points of the average pulse height graph touched by the entries [first, last] */
+    return uint32_t(GraphPoint(min(last, max(nEntries, 1u) - 1)) - GraphPoint(first) + 1);
+}
+
+uint32_t PLTAnalysis::SplitEntry(uint32_t first, uint32_t last, uint32_t i, uint32_t n) const {
+    /** all parts but the first start with a new point of the average pulse height graph such that each point is filled by a single part */
+    return i == 0 ? first : FirstEntry(uint16_t(GraphPoint(first) + i * NPoints(first, last) / n));
+}
+
+float PLTAnalysis::getTime(double now, float & time){
 
-    time += (clock() - now) / CLOCKS_PER_SEC;
+    time += float(tel::wall_time() - now);
     return time;
 }
 
@@ -275,8 +527,9 @@ void PLTAnalysis::WriteTrackingTree(){
             PLTPlane * Plane = FR->Plane(iplane);
             for (size_t icluster = 0; icluster != Plane->NClusters(); icluster++) {
                 PLTCluster * Cluster = Plane->Cluster(icluster);
-                float xl = FR->GetAlignment()->TtoLX(Track->ExtrapolateX(Cluster->TZ()), Track->ExtrapolateY(Cluster->TZ()), Cluster->Channel(), iplane);
-                float yl = FR->GetAlignment()->TtoLY(Track->ExtrapolateX(Cluster->TZ()), Track->ExtrapolateY(Cluster->TZ()), Cluster->Channel(), iplane);
+                std::pair<float, float> const LXY = FR->GetAlignment()->TtoLXY(Track->ExtrapolateX(Cluster->TZ()), Track->ExtrapolateY(Cluster->TZ()), Cluster->Channel(), iplane);
+                float xl = LXY.first;
+                float yl = LXY.second;
                 FW->setResidualXY(iplane, xl - Cluster->LX(), yl - Cluster->LY() );
                 FW->setResidual(iplane, float(tel::distance(make_pair(xl, yl), make_pair(Cluster->LX(), Cluster->LY()))) );
                 FW->setTrackPos(iplane, Track->ExtrapolateX(Plane->TZ()), Track->ExtrapolateY(Plane->TZ()) );
@@ -289,7 +542,7 @@ void PLTAnalysis::WriteTrackingTree(){
         FW->setAngle(-999, -999);
     }
 
-    FW->fillTree();
+    FW->fillTree(ThisTime);
 }
 void PLTAnalysis::MakeAvgPH(){
 
@@ -308,12 +561,12 @@ void PLTAnalysis::MakeAvgPH(){
 }
 void PLTAnalysis::DrawTracks(){
 
-    static int ieventdraw = 0;
-    if (ieventdraw < 20) {
+    if (n_drawn_tracks_ < 20) {
         auto hp = uint16_t(FR->HitPlaneBits());
         if (hp == pow(2, FR->NPlanes() ) -1){
-            FR->DrawTracksAndHits(TString::Format(Histos->getOutDir() + "/Tracks_Ev%i.png", ++ieventdraw).Data() );
-            if (ieventdraw == 20) cout << endl;
+            lock_guard<mutex> lock(RootMutex());
+            FR->DrawTracksAndHits(TString::Format(Histos->getOutDir() + "/Tracks_Ev%i.png", ++n_drawn_tracks_).Data() );
+            if (n_drawn_tracks_ == 20) cout << endl;
         }
     }
 }
@@ -124,7 +124,7 @@ bool PLTBinaryFileReader::DecodeSpyDataFifo (uint32_t  word, std::vector<PLTHit*
       if (roc <= 2) {
 
         // Check the pixel mask
-        if ( !IsPixelMasked( chan*100000 + roc*10000 + mycol*100 + abs(convPXL((word & pxlmsk) >> 8)) ) ) {
+        if ( !fPixelMask.IsMasked(chan, roc, mycol, abs(convPXL((word & pxlmsk) >> 8))) ) {
 
           //printf("IN OUT: %10i %10i\n", (word & pxlmsk) >> 8, convPXL((word & pxlmsk) >> 8));
           PLTHit* Hit = new PLTHit((int) chan, (int) roc, (int) mycol, (int) abs(convPXL((word & pxlmsk) >> 8)), (int) (word & plsmsk));
@@ -276,7 +276,7 @@ int PLTBinaryFileReader::ReadEventHitsText (std::ifstream& InFile, std::vector<P
       break;
     }
 
-    if ( !IsPixelMasked( Channel*100000 + ROC*10000 + Col*100 + Row ) ) {
+    if ( !fPixelMask.IsMasked(Channel, ROC, Col, Row) ) {
       PLTHit* Hit = new PLTHit(Channel, ROC, Col, Row, ADC);
       // only keep hits on the diamond
       if (PLTPlane::IsFiducial(fPlaneFiducialRegion, Hit)) {
@@ -321,7 +321,7 @@ void PLTBinaryFileReader::ReadPixelMask (std::string const InFileName)
     linestream.str(line);
     linestream >> ch >> roc >> col >> row;
 
-    fPixelMask.insert( ch*100000 + roc*10000 + col*100 + row );
+    fPixelMask.Add(ch, roc, col, row);
   }
 
   return;
@@ -330,10 +330,7 @@ void PLTBinaryFileReader::ReadPixelMask (std::string const InFileName)
 
 bool PLTBinaryFileReader::IsPixelMasked (int const ChannelPixel)
 {
-  if (fPixelMask.count(ChannelPixel)) {
-    return true;
-  }
-  return false;
+  return fPixelMask.IsMasked(ChannelPixel);
 }
 
 
@@ -18,6 +18,7 @@ void PLTCluster::AddHit (PLTHit* Hit)
 {
   // Add a hit
   fHits.push_back(Hit);
+  fCentersValid = false;
   return;
 }
 
@@ -92,13 +93,13 @@ int PLTCluster::ROC ()
 
 float PLTCluster::LX ()
 {
-  return LCenter().first;
+  return CenterOfMass<Frame::Local>().first;
 }
 
 
 float PLTCluster::LY ()
 {
-  return LCenter().second;
+  return CenterOfMass<Frame::Local>().second;
 }
 
 
@@ -112,13 +113,13 @@ std::pair<float, float> PLTCluster::LCenter ()
 
 float PLTCluster::TX ()
 {
-  return TCenter().first;
+  return CenterOfMass<Frame::Telescope>().first;
 }
 
 
 float PLTCluster::TY ()
 {
-  return TCenter().second;
+  return CenterOfMass<Frame::Telescope>().second;
 }
 
 
@@ -136,13 +137,13 @@ std::pair<float, float> PLTCluster::TCenter ()
 
 float PLTCluster::GX ()
 {
-  return GCenter().first;
+  return CenterOfMass<Frame::Global>().first;
 }
 
 
 float PLTCluster::GY ()
 {
-  return GCenter().second;
+  return CenterOfMass<Frame::Global>().second;
 }
 
 
@@ -158,12 +159,10 @@ std::pair<float, float> PLTCluster::GCenter ()
   //return std::make_pair<float, float>(SeedHit()->GX(), SeedHit()->GY());
 }
 
-std::pair<float, float> PLTCluster::CenterOfMass(std::string type) {
+void PLTCluster::ComputeCenters () {
 
-  /** Return the coordinates based on a charge weighted average of pixel hits
-
-     X, Y, and Total Charge */
-  float X(0.0), Y(0.0);
+  /** Store the coordinates based on a charge weighted average of pixel hits in the local, telescope and global frame */
+  float X[3] = {}, Y[3] = {};
   float ChargeSum(0.0);
   bool FoundZeroCharge = false;
 
@@ -175,28 +174,19 @@ std::pair<float, float> PLTCluster::CenterOfMass(std::string type) {
   // Loop over each hit in the cluster
   for (auto &fHit : fHits) {
     float iCharge = (FoundZeroCharge ? 1 : fHit->Charge());
-    float iX, iY;
-    if (type.find("local") != std::string::npos){
-      iX = fHit->LX();
-      iY = fHit->LY();
-    }
-    else if ((type.find("global") != std::string::npos)){
-      iX = fHit->GX();
-      iY = fHit->GY();
-    }
-    else {
-      iX = fHit->TX();
-      iY = fHit->TY();
-    }
-
-    X += iX * iCharge;
-    Y += iY * iCharge;
+    X[size_t(Frame::Local)] += fHit->LX() * iCharge;
+    Y[size_t(Frame::Local)] += fHit->LY() * iCharge;
+    X[size_t(Frame::Telescope)] += fHit->TX() * iCharge;
+    Y[size_t(Frame::Telescope)] += fHit->TY() * iCharge;
+    X[size_t(Frame::Global)] += fHit->GX() * iCharge;
+    Y[size_t(Frame::Global)] += fHit->GY() * iCharge;
     ChargeSum += fHit->Charge();
   }
 
-  /** If charge sum is zero or less or we have a zero charge return average */
-  if (ChargeSum <= 0.0 or FoundZeroCharge)
-    return std::make_pair<float, float>(X / (float) NHits(), Y / (float) NHits());
-
-  return std::make_pair<float, float>(X / ChargeSum, Y / ChargeSum);
+  /** If charge sum is zero or less or we have a zero charge take the average */
+  float const Norm = (ChargeSum <= 0.0 or FoundZeroCharge) ? (float) NHits() : ChargeSum;
+  for (size_t i = 0; i != 3; ++i) {
+    fCenters[i] = std::make_pair(X[i] / Norm, Y[i] / Norm);
+  }
+  fCentersValid = true;
 }
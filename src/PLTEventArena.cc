@@ -0,0 +1,33 @@
+#include "PLTEventArena.h"
+
+
+PLTHit* PLTEventArena::NewHit (int const Channel, int const ROC, int const Column, int const Row, int const ADC)
+{
+  PLTHit* Hit = fHits.Get();
+  *Hit = PLTHit(Channel, ROC, Column, Row, ADC);
+  return Hit;
+}
+
+
+PLTCluster* PLTEventArena::NewCluster ()
+{
+  PLTCluster* Cluster = fClusters.Get();
+  Cluster->Clear();
+  return Cluster;
+}
+
+
+PLTTrack* PLTEventArena::NewTrack ()
+{
+  PLTTrack* Track = fTracks.Get();
+  Track->Clear();
+  return Track;
+}
+
+
+void PLTEventArena::Reset ()
+{
+  fHits.Reset();
+  fClusters.Reset();
+  fTracks.Reset();
+}
@@ -0,0 +1,99 @@
+#include "PLTEventCache.h"
+#include "Utils.h"
+
+#include <stdexcept>
+
+#include "TString.h"
+
+using namespace std;
+
+
+PLTEventCache::PLTEventCache (uint64_t const max_memory_mb):
+  fMaxHits(max_memory_mb * 1024 * 1024 / sizeof(Hit)),
+  fNMemoryEvents(0),
+  fSpillFile(nullptr),
+  fComplete(false),
+  fFailed(false),
+  fAtEvent(0),
+  fAtHit(0) {
+}
+
+
+PLTEventCache::~PLTEventCache ()
+{
+  if (fSpillFile) {
+    fclose(fSpillFile);  // tmpfile is removed on close
+  }
+}
+
+
+void PLTEventCache::AddEvent (const vector<PLTHit*> & hits)
+{
+  /** store the hits of the next event, switch to the temporary file if the memory budget is exhausted */
+  if (fComplete or fFailed) { return; }
+  if (not fSpillFile and fHits.size() + hits.size() > fMaxHits) {
+    fSpillFile = tmpfile();
+    if (not fSpillFile) {
+      tel::warning("Could not create temporary file for the event cache, reading the input file instead");
+      fFailed = true;
+      fHits = vector<Hit>();
+      return;
+    }
+    tel::info(Form("Event cache exceeds %lu MB after %lu events, storing the remaining events in a temporary file",
+                   (unsigned long) (fMaxHits * sizeof(Hit) / 1024 / 1024), (unsigned long) fNHits.size()));
+    fNMemoryEvents = fNHits.size();
+  }
+  fBuffer.clear();
+  vector<Hit> & dest = fSpillFile ? fBuffer : fHits;
+  for (auto * h: hits) {
+    dest.push_back({int8_t(h->ROC()), int8_t(h->Column()), int8_t(h->Row()), int16_t(h->ADC()), h->Charge()});
+  }
+  if (fSpillFile and not fBuffer.empty() and fwrite(fBuffer.data(), sizeof(Hit), fBuffer.size(), fSpillFile) != fBuffer.size()) {
+    tel::warning("Could not write to the temporary event cache file, reading the input file instead");
+    fFailed = true;
+    return;
+  }
+  fNHits.push_back(uint16_t(hits.size()));
+  if (not fSpillFile) { fNMemoryEvents = fNHits.size(); }
+}
+
+
+void PLTEventCache::Close ()
+{
+  /** all events are stored, from now on the cache can be replayed */
+  if (fComplete) { return; }
+  fComplete = true;
+  fHits.shrink_to_fit();
+  if (fSpillFile) { fflush(fSpillFile); }
+  Rewind();
+}
+
+
+void PLTEventCache::Rewind ()
+{
+  fAtEvent = 0;
+  fAtHit = 0;
+  if (fSpillFile) { rewind(fSpillFile); }
+}
+
+
+bool PLTEventCache::NextEvent (const Hit *& hits, uint16_t & n_hits)
+{
+  /** sets hits to the hits of the next event (valid until the next call)
+   *  @returns: false if there are no more events */
+  if (fAtEvent == fNHits.size()) { return false; }
+  n_hits = fNHits[fAtEvent];
+  if (fAtEvent++ < fNMemoryEvents) {
+    hits = fHits.data() + fAtHit;
+    fAtHit += n_hits;
+    return true;
+  }
+  fBuffer.resize(n_hits);
+  if (n_hits and fread(fBuffer.data(), sizeof(Hit), n_hits, fSpillFile) != n_hits) {
+    string const msg = "Could not read the temporary event cache file";
+    tel::critical(msg);
+    throw std::runtime_error(msg);
+  }
+  hits = fBuffer.data();
+  return true;
+}
@@ -0,0 +1,179 @@
+#include "PLTEventGenerator.h"
+#include "Utils.h"
+#include "GetNames.h"
+
+#include <algorithm>
+#include <numeric>
+#include <cmath>
+#include <tuple>
+#include <stdexcept>
+
+#include "TFile.h"
+#include "TTree.h"
+
+using namespace std;
+
+
+PLTEventGenerator::PLTEventGenerator (Settings const & S):
+  fSettings(S), fNPlanes(GetNPlanes()), fPlaneOrder(fNPlanes), fGainCal(fNPlanes, true), fRandom(S.Seed)
+{
+  /** geometry and plane errors of the telescope */
+  fAlignment.ReadAlignmentFile(GetAlignmentFilename());
+  fAlignment.SetErrors(tel::Config::telescope_id_);
+  iota(fPlaneOrder.begin(), fPlaneOrder.end(), 0);
+  sort(fPlaneOrder.begin(), fPlaneOrder.end(), [this] (uint16_t a, uint16_t b) { return fAlignment.LZ(1, a) < fAlignment.LZ(1, b); });
+  for (uint16_t iroc = 0; iroc != fNPlanes; ++iroc) {
+    fResolutionX.push_back(float(sqrt(max(0., pow(fAlignment.GetErrorX(iroc), 2) - pow(PLTU::PIXELWIDTH, 2) / 12))));
+    fResolutionY.push_back(float(sqrt(max(0., pow(fAlignment.GetErrorY(iroc), 2) - pow(PLTU::PIXELHEIGHT, 2) / 12))));
+  }
+
+  /** the pulse heights are calculated with the external calibration function of every pixel */
+  string const Path = S.CalibrationPath.empty() ? GetCalibrationPath() : S.CalibrationPath + "/";
+  tel::info("Reading calibration files from " + Path);
+  for (int iroc = 0; iroc != fNPlanes; ++iroc) {
+    fGainCal.ReadGainCalFile(Path + Form("ROC%i.txt", iroc), iroc);
+  }
+
+  /** Highland formula for the width of the scattering angle in one plane */
+  double const Mass = .13957, Beta = S.Momentum / sqrt(S.Momentum * S.Momentum + Mass * Mass);
+  fScatteringAngle = S.PlaneX0 > 0 ? float(.0136 / (Beta * S.Momentum) * sqrt(S.PlaneX0) * (1 + .038 * log(S.PlaneX0))) : 0;
+}
+
+
+void PLTEventGenerator::Generate (string const & OutFileName)
+{
+  TFile File(OutFileName.c_str(), "RECREATE");
+  if (not File.IsOpen()) {
+    string const msg = "Cannot create output file: " + OutFileName;
+    tel::critical(msg);
+    throw std::runtime_error(msg);
+  }
+  auto * Tree = new TTree("tree", "simulated telescope events");  // owned by the file
+
+  /** branches of the converted beam test files */
+  int32_t EventNumber;
+  double Time;
+  UShort_t NHits;
+  uint8_t Plane[MAXHITS], Col[MAXHITS], Row[MAXHITS];
+  int16_t ADC[MAXHITS];
+  float Charge[MAXHITS];
+  Tree->Branch("event_number", &EventNumber, "event_number/I");
+  Tree->Branch("time", &Time, "time/D");
+  Tree->Branch("n_hits_tot", &NHits, "n_hits_tot/s");
+  Tree->Branch("plane", Plane, "plane[n_hits_tot]/b");
+  Tree->Branch("col", Col, "col[n_hits_tot]/b");
+  Tree->Branch("row", Row, "row[n_hits_tot]/b");
+  Tree->Branch("adc", ADC, "adc[n_hits_tot]/S");
+  Tree->Branch("charge", Charge, "charge[n_hits_tot]/F");
+  /** ground truth */
+  uint8_t NTracks;
+  float TrueX[MAXHITS], TrueY[MAXHITS], TrueSlopeX[MAXHITS], TrueSlopeY[MAXHITS];
+  Tree->Branch("n_true_tracks", &NTracks, "n_true_tracks/b");
+  Tree->Branch("true_x", TrueX, "true_x[n_true_tracks]/F");
+  Tree->Branch("true_y", TrueY, "true_y[n_true_tracks]/F");
+  Tree->Branch("true_slope_x", TrueSlopeX, "true_slope_x[n_true_tracks]/F");
+  Tree->Branch("true_slope_y", TrueSlopeY, "true_slope_y[n_true_tracks]/F");
+
+  tel::info(Form("Simulating %u events with %.2f tracks and %.2f noise hits per plane on average, scattering angle per plane: %.2g rad",
+                 fSettings.NEvents, fSettings.TracksPerEvent, fSettings.NoiseHitsPerPlane, fScatteringAngle));
+  tel::ProgressBar PBar(fSettings.NEvents);
+  vector<Pixel> Pixels;
+  uint32_t NTruncated = 0;
+  for (uint32_t ievent = 0; ievent != fSettings.NEvents; ++ievent) {
+    PBar.update(ievent + 1);
+    Pixels.clear();
+    NTracks = uint8_t(min(fRandom.Poisson(fSettings.TracksPerEvent), int(UINT8_MAX)));
+    for (uint8_t itrack = 0; itrack != NTracks; ++itrack) {
+      Track const T = NewTrack();
+      TrueX[itrack] = T.X; TrueY[itrack] = T.Y; TrueSlopeX[itrack] = T.SlopeX; TrueSlopeY[itrack] = T.SlopeY;
+      TrackHits(T, Pixels);
+    }
+    NoiseHits(Pixels);
+
+    /** pixels hit by several tracks or noise collect the sum of the charges, the readout sorts by plane */
+    sort(Pixels.begin(), Pixels.end(), [] (Pixel const & a, Pixel const & b) { return tie(a.ROC, a.Column, a.Row) < tie(b.ROC, b.Column, b.Row); });
+    NHits = 0;
+    for (size_t i = 0; i != Pixels.size(); ++i) {
+      Pixel P = Pixels[i];
+      for (; i + 1 != Pixels.size() and tie(Pixels[i + 1].ROC, Pixels[i + 1].Column, Pixels[i + 1].Row) == tie(P.ROC, P.Column, P.Row); ++i) {
+        P.Charge += Pixels[i + 1].Charge;
+      }
+      if (P.Charge < fSettings.Threshold) { continue; }
+      if (NHits == MAXHITS) { ++NTruncated; break; }
+      Plane[NHits] = P.ROC; Col[NHits] = P.Column; Row[NHits] = P.Row;
+      ADC[NHits] = int16_t(fGainCal.GetADC(1, P.ROC, P.Column, P.Row, P.Charge));
+      Charge[NHits] = P.Charge;
+      ++NHits;
+    }
+    EventNumber = int32_t(ievent);
+    Time = ievent;
+    Tree->Fill();
+  }
+  if (NTruncated) { tel::warning(Form("%u events had more than %i hits and were truncated", NTruncated, MAXHITS)); }
+
+  File.cd();
+  Tree->Write();
+  File.Close();
+  tel::info("Wrote the simulated events to " + OutFileName);
+}
+
+
+PLTEventGenerator::Track PLTEventGenerator::NewTrack ()
+{
+  /** the beam spot is centred on the middle of the first plane */
+  pair<float, float> const Centre = {PLTU::PIXELWIDTH * (PLTU::NCOL / 2.f - PLTU::DIACENTERX), PLTU::PIXELHEIGHT * (PLTU::NROW / 2.f - PLTU::DIACENTERY)};
+  PLTAlignment::XYZ const T = fAlignment.LtoT(Centre.first, Centre.second, 1, fPlaneOrder.front());
+  return {float(fRandom.Gaus(T.X, fSettings.BeamSigma)), float(fRandom.Gaus(T.Y, fSettings.BeamSigma)),
+          float(fRandom.Gaus(0, fSettings.Divergence)), float(fRandom.Gaus(0, fSettings.Divergence))};
+}
+
+
+void PLTEventGenerator::TrackHits (Track const & T, vector<Pixel> & Pixels)
+{
+  /** propagate the track through the planes in z and add a scattering kink after each plane */
+  float X = T.X, Y = T.Y, Z = 0, SlopeX = T.SlopeX, SlopeY = T.SlopeY;
+  for (auto const iroc: fPlaneOrder) {
+    float const PlaneZ = fAlignment.LZ(1, iroc);
+    X += SlopeX * (PlaneZ - Z);
+    Y += SlopeY * (PlaneZ - Z);
+    Z = PlaneZ;
+    pair<float, float> const L = fAlignment.TtoLXY(X + float(fRandom.Gaus(0, fResolutionX[iroc])), Y + float(fRandom.Gaus(0, fResolutionY[iroc])), 1, iroc);
+    float const Charge = max(0.f, float(fRandom.Landau(fSettings.ChargeMPV, fSettings.ChargeSigma)));
+    DepositCharge(iroc, L.first, L.second, Charge, Pixels);
+    SlopeX += float(fRandom.Gaus(0, fScatteringAngle));
+    SlopeY += float(fRandom.Gaus(0, fScatteringAngle));
+  }
+}
+
+
+void PLTEventGenerator::DepositCharge (int const ROC, float const LX, float const LY, float const Charge, vector<Pixel> & Pixels)
+{
+  /** a gaussian charge cloud shares its charge with the neighbour pixels in x and y */
+  float const PX = PLTAlignment::LX2PX(LX), PY = PLTAlignment::LY2PY(LY);
+  int const Col = int(lround(PX)), Row = int(lround(PY));
+  if (Col < 0 or Col >= PLTU::NCOL or Row < 0 or Row >= PLTU::NROW) { return; }
+  /** fraction of the cloud beyond the closer pixel edge and the direction of that neighbour */
+  auto Share = [this] (float const Distance, float const Pitch) {
+    return float(.5 * erfc((.5 - fabs(Distance)) * Pitch / (sqrt(2.) * fSettings.ChargeCloud)));
+  };
+  float const ShareX = Share(PX - Col, PLTU::PIXELWIDTH), ShareY = Share(PY - Row, PLTU::PIXELHEIGHT);
+  int const DCol = PX > Col ? 1 : -1, DRow = PY > Row ? 1 : -1;
+  float const Fractions[4] = {(1 - ShareX) * (1 - ShareY), ShareX * (1 - ShareY), (1 - ShareX) * ShareY, ShareX * ShareY};
+  int const Cols[4] = {Col, Col + DCol, Col, Col + DCol}, Rows[4] = {Row, Row, Row + DRow, Row + DRow};
+  for (int i = 0; i != 4; ++i) {
+    if (Cols[i] < 0 or Cols[i] >= PLTU::NCOL or Rows[i] < 0 or Rows[i] >= PLTU::NROW or Fractions[i] * Charge < 1) { continue; }
+    Pixels.push_back({uint8_t(ROC), uint8_t(Cols[i]), uint8_t(Rows[i]), Fractions[i] * Charge});
+  }
+}
+
+
+void PLTEventGenerator::NoiseHits (vector<Pixel> & Pixels)
+{
+  /** noise hits are single pixels with a charge just above threshold */
+  for (uint16_t iroc = 0; iroc != fNPlanes; ++iroc) {
+    for (int i = fRandom.Poisson(fSettings.NoiseHitsPerPlane); i > 0; --i) {
+      Pixels.push_back({uint8_t(iroc), uint8_t(fRandom.Integer(PLTU::NCOL)), uint8_t(fRandom.Integer(PLTU::NROW)),
+                        fSettings.Threshold + float(fRandom.Exp(fSettings.Threshold))});
+    }
+  }
+}
@@ -1,18 +1,29 @@
 #include "PLTGainCal.h"
 #include "Utils.h"
 #include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <stdexcept>
+#include "TSystem.h"
 
 #define DEF_CHARGE -9999
 #define MAX_VCAL 7 * 255
+#define MAX_ADC 4096
+#define LUT_TOLERANCE 1e-2
 
 using namespace std;
 
+bool PLTGainCal::UseCache = true;
+
 
 PLTGainCal::PLTGainCal () {
   ResetGC();
 }
 
-PLTGainCal::PLTGainCal (int nrocs, bool isExternalFunction ): NROCS(nrocs) {
+PLTGainCal::PLTGainCal (int nrocs, bool isExternalFunction, bool useLookupTable): NROCS(nrocs), fUseLookupTable(useLookupTable) {
   ResetGC();
   fIsExternalFunction = isExternalFunction;
   ReadVcalCal();
@@ -35,15 +46,20 @@ float PLTGainCal::GetCharge(int const ch, int const roc, int const col, int cons
 
   double vcal;
 
-  if (fIsExternalFunction) {  /** external calibration */
-    for (int ipar = 0; ipar < fNParams; ++ipar) { fFitFunction.SetParameter(ipar, GC[ich][iroc][icol][irow][ipar]);}
+  if (fIsExternalFunction and fUseLookupTable and size_t(iroc) < fLUT.size() and not fLUT.at(iroc).empty()) {  /** external calibration from the lookup table */
+    const LUTPixel & P = fLUTPixels[iroc][icol * PLTU::NROW + irow];
+    if (adc < P.MinADC or adc > P.MaxADC or adc == 0 and tel::Config::telescope_id_ == 22) { return DEF_CHARGE; }
+    vcal = fLUT[iroc][P.Offset + adc - P.MinADC];
+  }
+  else if (fIsExternalFunction) {  /** external calibration */
+    for (int ipar = 0; ipar < fNParams; ++ipar) { fFitFunction.SetParameter(ipar, Par(ich, iroc, icol, irow, ipar));}
     if (adc + 1 > fFitFunction.GetMaximum() or adc - 1 < fFitFunction.GetMinimum() or adc == 0 and tel::Config::telescope_id_ == 22) { return DEF_CHARGE; }
     vcal = min(max(fFitFunction.GetX(adc), 0.), double(MAX_VCAL));  // contain vcal in range [0, MAX_VCAL]
   }
   else {  /** old calibration */
-    if (fNParams == 3) { vcal = float(adc * adc) * GC[ich][iroc][icol][irow][2] + float(adc) * GC[ich][iroc][icol][irow][1] + GC[ich][iroc][icol][irow][0]; }
-    else if (fNParams == 5) { vcal = (TMath::Power( (float) adc, 2) * GC[ich][iroc][icol][irow][0] + (float) adc * GC[ich][iroc][icol][irow][1] + GC[ich][iroc][icol][irow][2]
-                                   + (GC[ich][iroc][icol][irow][4] != 0 ? TMath::Exp( (adc - GC[ich][iroc][icol][irow][3]) / GC[ich][iroc][icol][irow][4] ) : 0) ); }
+    if (fNParams == 3) { vcal = float(adc * adc) * Par(ich, iroc, icol, irow, 2) + float(adc) * Par(ich, iroc, icol, irow, 1) + Par(ich, iroc, icol, irow, 0); }
+    else if (fNParams == 5) { vcal = (TMath::Power( (float) adc, 2) * Par(ich, iroc, icol, irow, 0) + (float) adc * Par(ich, iroc, icol, irow, 1) + Par(ich, iroc, icol, irow, 2)
+                                   + (Par(ich, iroc, icol, irow, 4) != 0 ? TMath::Exp( (adc - Par(ich, iroc, icol, irow, 3)) / Par(ich, iroc, icol, irow, 4) ) : 0) ); }
     else { tel::critical(Form("ERROR: PLTGainCal::GetCharge() I do not know of that number of fit parameters: %d", fNParams)); exit(1);}
   }
 
@@ -52,6 +68,59 @@ float PLTGainCal::GetCharge(int const ch, int const roc, int const col, int cons
   return VC.at(iroc).first * vcal + VC.at(iroc).second;
 }
 
+void PLTGainCal::GetCharges(size_t const n, const uint8_t * roc, const uint8_t * col, const uint8_t * row, const int16_t * adc, float * charge) {
+  /** the external calibration is inverted hit by hit */
+  if (fIsExternalFunction) {
+    for (size_t i = 0; i != n; ++i) { charge[i] = GetCharge(1, roc[i], col[i], row[i], adc[i]); }
+    return;
+  }
+  if (fNParams != 3 and fNParams != 5) { tel::critical(Form("ERROR: PLTGainCal::GetCharges() I do not know of that number of fit parameters: %d", fNParams)); exit(1); }
+
+  /** gather the parameters of each block of hits into separate arrays, then evaluate the polynomials block by block.
+   *  The float and double parts of the arithmetic are the same as in GetCharge, so both give identical charges. */
+  static size_t const BLOCK = 64;
+  static float const NoPars[NPARS] = {};
+  float x[BLOCK], p0[BLOCK], p1[BLOCK], p2[BLOCK], p3[BLOCK], p4[BLOCK], gain[BLOCK], offset[BLOCK];
+  double vcal[BLOCK];
+  bool valid[BLOCK];
+  for (size_t first = 0; first < n; first += BLOCK) {
+    size_t const m = min(BLOCK, n - first);
+    for (size_t j = 0; j != m; ++j) {
+      int const iroc = RocIndex(roc[first + j]), icol = ColIndex(col[first + j]), irow = RowIndex(row[first + j]);
+      valid[j] = iroc < NROCS and size_t(iroc) < VC.size() and icol >= 0 and icol < PLTU::NCOL and irow >= 0 and irow < PLTU::NROW;
+      const float * P = valid[j] ? &Par(0, iroc, icol, irow, 0) : NoPars;
+      x[j] = adc[first + j];
+      p0[j] = P[0]; p1[j] = P[1]; p2[j] = P[2]; p3[j] = P[3]; p4[j] = P[4];
+      gain[j] = valid[j] ? VC[iroc].first : 0;
+      offset[j] = valid[j] ? VC[iroc].second : 0;
+    }
+    if (fNParams == 3) {
+      for (size_t j = 0; j != m; ++j) { vcal[j] = x[j] * x[j] * p2[j] + x[j] * p1[j] + p0[j]; }
+    } else {
+      for (size_t j = 0; j != m; ++j) {
+        float const arg = p4[j] != 0 ? (x[j] - p3[j]) / p4[j] : -INFINITY;  // exp(-inf) = 0 without the exponential term
+        vcal[j] = double(x[j]) * x[j] * p0[j] + x[j] * p1[j] + p2[j] + exp(double(arg));
+      }
+    }
+    for (size_t j = 0; j != m; ++j) { charge[first + j] = valid[j] ? float(gain[j] * vcal[j] + offset[j]) : DEF_CHARGE; }
+  }
+}
+
+int PLTGainCal::GetADC(int const ch, int const roc, int const col, int const row, float const charge) {
+  /** pulse height of a charge in electrons, only the external calibration function (vcal -> adc) can be evaluated in this direction */
+  if (not fIsExternalFunction) {
+    string const msg = "PLTGainCal::GetADC() needs the external calibration function";
+    tel::critical(msg);
+    throw std::logic_error(msg);
+  }
+  int16_t irow = RowIndex(row), icol = ColIndex(col), ich  = ChIndex(ch), iroc = RocIndex(roc);
+  if (irow < 0 || icol < 0 || ich < 0 || iroc < 0) { return 0; }
+  if (irow >= PLTU::NROW || icol >= PLTU::NCOL || ich >= NCHNS || iroc >= NROCS) { return 0; }
+  for (int ipar = 0; ipar < fNParams; ++ipar) { fFitFunction.SetParameter(ipar, Par(ich, iroc, icol, irow, ipar));}
+  double const vcal = (charge - VC.at(iroc).second) / VC.at(iroc).first;
+  return int(lround(fFitFunction.Eval(min(max(vcal, 0.), double(MAX_VCAL)))));
+}
+
 void PLTGainCal::ReadGainCalFile (const string & GainCalFileName, int roc) {
 
   if (GainCalFileName.empty()) {
@@ -62,13 +131,17 @@ void PLTGainCal::ReadGainCalFile (const string & GainCalFileName, int roc) {
   ifstream f(GainCalFileName.c_str());
   if (!f.is_open()) {
     tel::critical(Form("Cannot open gaincal file: %s", GainCalFileName.c_str()));
-    throw;
+    throw std::runtime_error("Cannot open gaincal file: " + GainCalFileName);
   }
 
   std::string line;
   getline(f, line);  // read first line
   fIsExternalFunction = line.find("Parameters of the vcal vs. pulse height fits") != string::npos;
 
+  /** parsing the text and building the lookup table of an external calibration is slow, so they are cached in binary form */
+  uint64_t const Hash = fIsExternalFunction and UseCache ? SourceHash(GainCalFileName) : 0;
+  if (fIsExternalFunction and UseCache and ReadCache(GainCalFileName, roc, Hash)) { return; }
+
   for (; std::getline(f, line); ) { if (line.empty() ) { break; } }  // Loop over header lines in the input data file
 
   getline(f, line);
@@ -78,13 +151,16 @@ void PLTGainCal::ReadGainCalFile (const string & GainCalFileName, int roc) {
   f.close();
   fNParams = i;
 
-  if (fIsExternalFunction) { ReadGainCalFileExt(GainCalFileName, roc); }
+  if (fIsExternalFunction) {
+    ReadGainCalFileExt(GainCalFileName, roc);
+    if (UseCache) { WriteCache(GainCalFileName, roc, Hash); }
+  }
   else {
     if (fNParams == 5) { ReadGainCalFile5(GainCalFileName); }
     else if (fNParams == 3) { ReadGainCalFile3(GainCalFileName); }
     else {
       tel::critical("ERROR: I have no idea how many params you have");
-      throw;
+      throw std::runtime_error(Form("PLTGainCal: unknown number of fit parameters %i", fNParams));
     }
   }
 }
@@ -106,7 +182,7 @@ void PLTGainCal::ReadGainCalFile5 (const string & GainCalFileName)
   ifstream f(GainCalFileName.c_str());
   if (!f) {
     std::cerr << "ERROR: cannot open file: " << GainCalFileName << std::endl;
-    throw;
+    throw std::runtime_error("cannot open file: " + GainCalFileName);
   }
 
   // Loop over header lines in the input data file
@@ -150,17 +226,17 @@ void PLTGainCal::ReadGainCalFile5 (const string & GainCalFileName)
       continue;
     }
 
-    ss >> GC[ich][roc][icol][irow][0]
-       >> GC[ich][roc][icol][irow][1]
-       >> GC[ich][roc][icol][irow][2]
-       >> GC[ich][roc][icol][irow][3]
-       >> GC[ich][roc][icol][irow][4];
+    ss >> Par(ich, roc, icol, irow, 0)
+       >> Par(ich, roc, icol, irow, 1)
+       >> Par(ich, roc, icol, irow, 2)
+       >> Par(ich, roc, icol, irow, 3)
+       >> Par(ich, roc, icol, irow, 4);
 
     // dude, you really don't want to do this..
     if (PLTGainCal::DEBUGLEVEL) {
       for (int i = 0; i != NROCS; ++i) {
         for (int j = 0; j != 5; ++j) {
-          printf("%6.2E ", GC[ich][i][icol][irow][j]);
+          printf("%6.2E ", Par(ich, i, icol, irow, j));
         }
       }
       printf("\n");
@@ -190,7 +266,7 @@ void PLTGainCal::ReadGainCalFileExt (const string & GainCalFileName, int const r
   ifstream f(GainCalFileName.c_str());
   if (!f) {
     std::cerr << "ERROR: cannot open file: " << GainCalFileName << std::endl;
-    throw;
+    throw std::runtime_error("cannot open file: " + GainCalFileName);
   }
 
   // Loop over header lines in the input data file
@@ -200,9 +276,7 @@ void PLTGainCal::ReadGainCalFileExt (const string & GainCalFileName, int const r
   FunctionLine.ReplaceAll("par[", "[");
 
   // Set the root function
-  TF1 MyFunction("GainCalFitFunction", FunctionLine, -MAX_VCAL, MAX_VCAL);
-  fFitFunction = MyFunction;
-  fFitFunction.SetNpx(180);
+  SetFitFunction(FunctionLine.Data());
 
   // Get blank line out of the way
   FunctionLine.ReadLine(f);
@@ -247,14 +321,14 @@ void PLTGainCal::ReadGainCalFileExt (const string & GainCalFileName, int const r
     }
 
     for (int ipar = 0; ipar < fNParams; ++ipar) {
-      GC[ich][roc][icol][irow][ipar] = Coefs[ipar];
+      Par(ich, roc, icol, irow, ipar) = Coefs[ipar];
     }
 
     // dude, you really don't want to do this..
     if (PLTGainCal::DEBUGLEVEL) {
       for (int i = 0; i != NROCS; ++i) {
         for (int j = 0; j != 5; ++j) {
-          printf("%6.2E ", GC[ich][i][icol][irow][j]);
+          printf("%6.2E ", Par(ich, i, icol, irow, j));
         }
       }
       printf("\n");
@@ -265,11 +339,222 @@ void PLTGainCal::ReadGainCalFileExt (const string & GainCalFileName, int const r
   // Apparently this file was read no problem...
   fIsGood = true;
 
+  if (fUseLookupTable) {
+    BuildLookupTable(roc);
+    int const n_bad = CheckLookupTable(roc);
+    if (n_bad > 0) {
+      tel::warning(Form("%i entries of the gain lookup table of ROC %i deviate by more than %.3g vcal from the fit function, using the fit function", n_bad, roc, LUT_TOLERANCE));
+      fLUT.at(roc).clear();
+    }
+  }
 
   return;
 }
 
 
+void PLTGainCal::SetFitFunction (const string & Formula)
+{
+  fFormula = Formula;
+  TF1 MyFunction("GainCalFitFunction", Formula.c_str(), -MAX_VCAL, MAX_VCAL);
+  fFitFunction = MyFunction;
+  fFitFunction.SetNpx(180);
+}
+
+
+uint64_t PLTGainCal::SourceHash (const string & FileName)
+{
+  /** 64 bit FNV-1a hash of the file content */
+  ifstream f(FileName.c_str(), ios::binary);
+  uint64_t Hash = 14695981039346656037ULL;
+  char Buffer[1 << 16];
+  while (f.read(Buffer, sizeof Buffer) or f.gcount() > 0) {
+    for (streamsize i = 0; i != f.gcount(); ++i) {
+      Hash = (Hash ^ uint8_t(Buffer[i])) * 1099511628211ULL;
+    }
+  }
+  return Hash;
+}
+
+
+bool PLTGainCal::ReadCache (const string & GainCalFileName, int const roc, uint64_t const Hash)
+{
+  /** @returns: whether the cache exists and belongs to the current content of the calibration file and to the settings */
+  if (roc < 0 or roc >= NROCS) { return false; }
+  int fd = open(CacheFileName(GainCalFileName).c_str(), O_RDONLY);
+  if (fd < 0) { return false; }
+  struct stat st {};
+  void * Mapped = MAP_FAILED;
+  if (fstat(fd, &st) == 0 and size_t(st.st_size) >= sizeof(CacheHeader)) {
+    Mapped = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+  }
+  close(fd);
+  if (Mapped == MAP_FAILED) { return false; }
+
+  auto const * Data = static_cast<const char*>(Mapped);
+  CacheHeader H {};
+  memcpy(&H, Data, sizeof H);
+  size_t const FileSize = size_t(st.st_size);
+  size_t const NPixelPars = size_t(PLTU::NCOL) * PLTU::NROW * NPARS;
+  /** the sizes are checked against the file size first, such that the total size below cannot overflow */
+  bool const Matches = memcmp(H.Magic, "PLTGCAL", 8) == 0 and H.Version == CacheVersion and H.SourceHash == Hash and H.UseLookupTable == uint32_t(fUseLookupTable);
+  bool Valid = Matches and H.NParams >= 0 and H.NParams <= 4 and H.FormulaSize > 0 and H.FormulaSize <= MaxFormulaSize and H.NPixelPars == NPixelPars
+               and (H.NLUTPixels == 0 ? H.NLUT == 0 : H.NLUTPixels == PLTU::NCOL * PLTU::NROW and H.NLUT > 0 and H.NLUT <= FileSize / sizeof(float))
+               and FileSize == sizeof H + H.FormulaSize + H.NPixelPars * sizeof(float) + H.NLUTPixels * sizeof(LUTPixel) + H.NLUT * sizeof(float);
+  /** every lookup in GetCharge has to stay inside the table of the ROC */
+  vector<LUTPixel> Pixels(Valid ? H.NLUTPixels : 0);
+  if (not Pixels.empty()) {
+    memcpy(Pixels.data(), Data + sizeof H + H.FormulaSize + NPixelPars * sizeof(float), Pixels.size() * sizeof(LUTPixel));
+    for (auto const & P: Pixels) {
+      if (P.MinADC <= P.MaxADC and uint64_t(P.Offset) + uint64_t(P.MaxADC - P.MinADC) >= H.NLUT) {
+        Valid = false;
+        break;
+      }
+    }
+  }
+  if (Valid) {
+    Data += sizeof H;
+    fNParams = H.NParams;
+    SetFitFunction(string(Data, H.FormulaSize));
+    Data += H.FormulaSize;
+    memcpy(&Par(ChIndex(1), roc, 0, 0, 0), Data, NPixelPars * sizeof(float));
+    Data += NPixelPars * sizeof(float) + H.NLUTPixels * sizeof(LUTPixel);
+    if (fLUT.size() < size_t(NROCS)) {
+      fLUT.resize(NROCS);
+      fLUTPixels.resize(NROCS);
+    }
+    fLUTPixels.at(roc) = move(Pixels);
+    fLUT.at(roc).resize(H.NLUT);
+    if (H.NLUT > 0) { memcpy(fLUT.at(roc).data(), Data, H.NLUT * sizeof(float)); }
+    fHardwareMap[1] = 1000 + roc;
+    fIsExternalFunction = true;
+    fIsGood = true;
+  } else if (Matches) {
+    tel::warning(Form("Ignoring the corrupt calibration cache %s", CacheFileName(GainCalFileName).c_str()));
+  }
+  munmap(Mapped, size_t(st.st_size));
+  return Valid;
+}
+
+
+void PLTGainCal::WriteCache (const string & GainCalFileName, int const roc, uint64_t const Hash)
+{
+  /** the cache is written to a temporary file and renamed, such that concurrent readers never see a partial file */
+  if (roc < 0 or roc >= NROCS) { return; }
+  bool const HasLUT = size_t(roc) < fLUT.size() and not fLUT.at(roc).empty();
+  CacheHeader H {};
+  memcpy(H.Magic, "PLTGCAL", 8);
+  H.Version = CacheVersion;
+  H.UseLookupTable = uint32_t(fUseLookupTable);
+  H.SourceHash = Hash;
+  H.NParams = fNParams;
+  H.FormulaSize = uint32_t(fFormula.size());
+  H.NPixelPars = uint32_t(PLTU::NCOL * PLTU::NROW * NPARS);
+  H.NLUTPixels = HasLUT ? uint32_t(fLUTPixels.at(roc).size()) : 0;
+  H.NLUT = HasLUT ? fLUT.at(roc).size() : 0;
+
+  string const FileName = CacheFileName(GainCalFileName), TmpFileName = FileName + Form(".%i", gSystem->GetPid());
+  ofstream f(TmpFileName.c_str(), ios::binary);
+  f.write(reinterpret_cast<const char*>(&H), sizeof H);
+  f.write(fFormula.data(), streamsize(fFormula.size()));
+  f.write(reinterpret_cast<const char*>(&Par(ChIndex(1), roc, 0, 0, 0)), streamsize(H.NPixelPars * sizeof(float)));
+  if (HasLUT) {
+    f.write(reinterpret_cast<const char*>(fLUTPixels.at(roc).data()), streamsize(H.NLUTPixels * sizeof(LUTPixel)));
+    f.write(reinterpret_cast<const char*>(fLUT.at(roc).data()), streamsize(H.NLUT * sizeof(float)));
+  }
+  f.close();
+  if (not f or rename(TmpFileName.c_str(), FileName.c_str()) != 0) {
+    tel::warning("Cannot write the calibration cache " + FileName);
+    gSystem->Unlink(TmpFileName.c_str());
+  }
+}
+
+
+double PLTGainCal::InvertFitFunction(double adc, double lo, double hi) const {
+  /** solve f(x) = adc within the bracket [lo, hi] of the monotonic fit function (Illinois variant of regula falsi)
+   *  @returns: x */
+  double f_lo = fFitFunction.Eval(lo) - adc, f_hi = fFitFunction.Eval(hi) - adc;
+  if (f_lo == 0) { return lo; }
+  if (f_hi == 0) { return hi; }
+  double x = lo;
+  for (int side = 0, i = 0; i < 200 and hi - lo > 1e-9; ++i) {
+    x = (lo * f_hi - hi * f_lo) / (f_hi - f_lo);
+    double f_x = fFitFunction.Eval(x) - adc;
+    if (f_x == 0 or fabs(f_x) < 1e-10) { return x; }
+    if ((f_x > 0) == (f_hi > 0)) {
+      hi = x; f_hi = f_x;
+      if (side == -1) { f_lo /= 2; }
+      side = -1;
+    } else {
+      lo = x; f_lo = f_x;
+      if (side == 1) { f_hi /= 2; }
+      side = 1;
+    }
+  }
+  return x;
+}
+
+
+void PLTGainCal::BuildLookupTable(int const roc) {
+  /** invert the external calibration function of every pixel of the ROC for all valid (integer) adc values.
+   *  The valid window is the same as in the fit function path: adc + 1 <= max(f) and adc - 1 >= min(f) */
+  if (not fIsExternalFunction) { return; }
+  if (fLUT.size() < size_t(NROCS)) {
+    fLUT.resize(NROCS);
+    fLUTPixels.resize(NROCS);
+  }
+  vector<float> & lut = fLUT.at(roc);
+  vector<LUTPixel> & pixels = fLUTPixels.at(roc);
+  lut.clear();
+  pixels.assign(PLTU::NCOL * PLTU::NROW, LUTPixel());
+  int const ich = ChIndex(1);
+  for (int icol = 0; icol != PLTU::NCOL; ++icol) {
+    for (int irow = 0; irow != PLTU::NROW; ++irow) {
+      for (int ipar = 0; ipar < fNParams; ++ipar) { fFitFunction.SetParameter(ipar, Par(ich, roc, icol, irow, ipar)); }
+      double f_max = fFitFunction.GetMaximum(), f_min = fFitFunction.GetMinimum();
+      int min_adc = max(int(ceil(f_min + 1)), -MAX_ADC), max_adc = min(int(floor(f_max - 1)), MAX_ADC);
+      for (; min_adc - 1 < f_min; ++min_adc) { }  // protect against rounding in the window edges
+      for (; max_adc + 1 > f_max; --max_adc) { }
+      if (min_adc > max_adc) { continue; }
+      LUTPixel & P = pixels[icol * PLTU::NROW + irow];
+      P.MinADC = int16_t(min_adc);
+      P.MaxADC = int16_t(max_adc);
+      P.Offset = uint32_t(lut.size());
+      /** march through the adc values, the previous solution bounds the next one */
+      bool rising = fFitFunction.Eval(MAX_VCAL) > fFitFunction.Eval(-MAX_VCAL);
+      double x = rising ? -MAX_VCAL : MAX_VCAL;
+      for (int adc = min_adc; adc <= max_adc; ++adc) {
+        x = rising ? InvertFitFunction(adc, x, MAX_VCAL) : InvertFitFunction(adc, -MAX_VCAL, x);
+        lut.push_back(float(min(max(x, 0.), double(MAX_VCAL))));  // contain vcal in range [0, MAX_VCAL]
+      }
+    }
+  }
+  lut.shrink_to_fit();
+}
+
+
+int PLTGainCal::CheckLookupTable(int const roc) {
+  /** check every entry of the lookup table against the fit function without inverting it again: for the monotonic function
+   *  the solution lies within LUT_TOLERANCE of the entry if the adc value lies between the values of the function at the
+   *  edges of this window. Entries clamped to the vcal range only need the solution beyond the clamped edge.
+   *  @returns: the number of entries which deviate by more than LUT_TOLERANCE */
+  if (size_t(roc) >= fLUT.size() or fLUT.at(roc).empty()) { return 0; }
+  int const ich = ChIndex(1);
+  int n_bad = 0;
+  for (int i = 0; i < PLTU::NCOL * PLTU::NROW; ++i) {
+    const LUTPixel & P = fLUTPixels.at(roc).at(i);
+    if (P.MinADC > P.MaxADC) { continue; }
+    for (int ipar = 0; ipar < fNParams; ++ipar) { fFitFunction.SetParameter(ipar, Par(ich, roc, i / PLTU::NROW, i % PLTU::NROW, ipar)); }
+    for (int adc = P.MinADC; adc <= P.MaxADC; ++adc) {
+      double const vcal = fLUT.at(roc).at(P.Offset + adc - P.MinADC);
+      double const f_low = fFitFunction.Eval(vcal <= 0 ? -MAX_VCAL : vcal - LUT_TOLERANCE);
+      double const f_high = fFitFunction.Eval(vcal >= MAX_VCAL ? MAX_VCAL : vcal + LUT_TOLERANCE);
+      n_bad += adc < min(f_low, f_high) or adc > max(f_low, f_high);
+    }
+  }
+  return n_bad;
+}
+
+
 void PLTGainCal::CheckGainCalFile(std::string const GainCalFileName, int const Channel)
 {
   ReadGainCalFile(GainCalFileName, 0);
@@ -284,11 +569,11 @@ void PLTGainCal::CheckGainCalFile(std::string const GainCalFileName, int const C
       for (int m = 0; m != PLTU::NROW; ++m) {
         ++NTotal;
         if (
-          GC[ich][j][k][m][0] == 0 &&
-          GC[ich][j][k][m][1] == 0 &&
-          GC[ich][j][k][m][2] == 0 &&
-          GC[ich][j][k][m][3] == 0 &&
-          GC[ich][j][k][m][4] == 0) {
+          Par(ich, j, k, m, 0) == 0 &&
+          Par(ich, j, k, m, 1) == 0 &&
+          Par(ich, j, k, m, 2) == 0 &&
+          Par(ich, j, k, m, 3) == 0 &&
+          Par(ich, j, k, m, 4) == 0) {
           printf("Missing Coefs: iCh %2i  iRoc %1i  iCol %2i  iRow %2i\n", ich, j, k, m);
           ++NMissing;
         }
@@ -311,7 +596,7 @@ void PLTGainCal::PrintGainCal5 ()
         for (int irow = 0; irow != 80; ++irow) {
 
           for (int j = 0; j != 5; ++j) {
-            printf("%6.2E ", GC[ich][iroc][icol][irow][j]);
+            printf("%6.2E ", Par(ich, iroc, icol, irow, j));
           }
           printf("\n");
         }
@@ -338,9 +623,9 @@ void PLTGainCal::PrintGainCal (FILE* f)
           }
           for (int j = 0; j != fNParams; ++j) {
             if (f) {
-              fprintf(f, "%15.6E ", GC[ich][iroc][icol][irow][j]);
+              fprintf(f, "%15.6E ", Par(ich, iroc, icol, irow, j));
             } else {
-              printf("%15.6E ", GC[ich][iroc][icol][irow][j]);
+              printf("%15.6E ", Par(ich, iroc, icol, irow, j));
             }
           }
           if (f) {
@@ -368,7 +653,7 @@ void PLTGainCal::ReadGainCalFile3 (const string & GainCalFileName)
   ifstream f(GainCalFileName.c_str());
   if (!f) {
     std::cerr << "ERROR: cannot open file: " << GainCalFileName << std::endl;
-    throw;
+    throw std::runtime_error("cannot open file: " + GainCalFileName);
   }
 
 
@@ -402,16 +687,16 @@ void PLTGainCal::ReadGainCalFile3 (const string & GainCalFileName)
       continue;
     }
 
-    ss >> GC[ich][iroc][icol][irow][0]
-       >> GC[ich][iroc][icol][irow][1]
-       >> GC[ich][iroc][icol][irow][2];
+    ss >> Par(ich, iroc, icol, irow, 0)
+       >> Par(ich, iroc, icol, irow, 1)
+       >> Par(ich, iroc, icol, irow, 2);
 
     // dude, you really don't want to do this..
     if (PLTGainCal::DEBUGLEVEL) {
       for (int i = 0; i != NROCS; ++i) {
         printf("%1i %1i %2i %1i %2i %2i", mFec, mFecChannel, hubAddress, roc, col, row);
         for (int j = 0; j != 3; ++j) {
-          printf(" %9.1E", GC[ich][i][icol][irow][j]);
+          printf(" %9.1E", Par(ich, i, icol, irow, j));
         }
         printf("\n");
       }
@@ -457,7 +742,7 @@ void PLTGainCal::ReadTesterGainCalFile (std::string const GainCalFileName)
   ifstream f(GainCalFileName.c_str());
   if (!f) {
     std::cerr << "ERROR: cannot open file: " << GainCalFileName << std::endl;
-    throw;
+    throw std::runtime_error("cannot open file: " + GainCalFileName);
   }
 
 
@@ -483,16 +768,16 @@ void PLTGainCal::ReadTesterGainCalFile (std::string const GainCalFileName)
       continue;
     }
 
-    ss >> GC[ich][iroc][icol][irow][0]
-       >> GC[ich][iroc][icol][irow][1]
-       >> GC[ich][iroc][icol][irow][2];
+    ss >> Par(ich, iroc, icol, irow, 0)
+       >> Par(ich, iroc, icol, irow, 1)
+       >> Par(ich, iroc, icol, irow, 2);
 
     // dude, you really don't want to do this..
     if (PLTGainCal::DEBUGLEVEL) {
       for (int i = 0; i != NROCS; ++i) {
         printf("%1i %1i %2i %1i %2i %2i", mFec, mFecChannel, hubAddress, roc, col, row);
         for (int j = 0; j != 3; ++j) {
-          printf(" %9.1E", GC[ich][i][icol][irow][j]);
+          printf(" %9.1E", Par(ich, i, icol, irow, j));
         }
         printf("\n");
       }
@@ -509,37 +794,7 @@ void PLTGainCal::ReadTesterGainCalFile (std::string const GainCalFileName)
 
 void PLTGainCal::ResetGC ()
 {
-  GC.resize(0);
-
-  // Reset everything
-  for (int i = 0; i != NCHNS; ++i) {
-
-    std::vector<std::vector<std::vector<std::vector<float> > > > tmp_4d;
-
-    for (int j = 0; j != NROCS; ++j) {
-
-      std::vector<std::vector<std::vector<float> > > tmp_3d;
-
-      for (int k = 0; k != PLTU::NCOL; ++k) {
-
-	std::vector<std::vector<float> > tmp_2d;
-
-        for (int m = 0; m != PLTU::NROW; ++m) {
-
-	  std::vector<float> tmp_1d;
-          for (int n = 0; n != 5; ++n) {
-	    tmp_1d.push_back(0.);
-          }
-
-	tmp_2d.push_back(tmp_1d);
-        }
-      tmp_3d.push_back(tmp_2d);
-      }
-    tmp_4d.push_back(tmp_3d);
-    }
-  GC.push_back(tmp_4d);
-  }
-  return;
+  GC.assign(size_t(NCHNS) * NROCS * PLTU::NCOL * PLTU::NROW * NPARS, 0);
 }
 
 void PLTGainCal::ReadVcalCal() {
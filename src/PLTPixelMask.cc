@@ -0,0 +1,110 @@
+#include "PLTPixelMask.h"
+
+#include <iostream>
+
+
+namespace {
+  uint8_t const UnmaskedMap[PLTU::NCOL * PLTU::NROW] = {};
+}
+
+
+uint8_t * PLTPixelMask::MakeMap (int const Channel, int const ROC)
+{
+  if (Channel < 0 or Channel >= MAXCHANNEL or ROC < 0 or ROC >= MAXROC) {
+    std::cerr << "WARNING: PLTPixelMask cannot mask pixels of channel " << Channel << " ROC " << ROC << std::endl;
+    return nullptr;
+  }
+  size_t const i = size_t(Channel) * MAXROC + size_t(ROC);
+  if (i >= fMaps.size()) {
+    fMaps.resize(i + 1);
+  }
+  if (fMaps[i].empty()) {
+    fMaps[i].assign(PLTU::NCOL * PLTU::NROW, 0);
+  }
+  return fMaps[i].data();
+}
+
+
+void PLTPixelMask::Add (int const Channel, int const ROC, int const Col, int const Row)
+{
+  if (not InRange(Col, Row)) {
+    std::cerr << "WARNING: PLTPixelMask ignoring pixel outside of the ROC: col " << Col << " row " << Row << std::endl;
+    return;
+  }
+  uint8_t * Map = MakeMap(Channel, ROC);
+  if (Map != nullptr) {
+    Map[Col * PLTU::NROW + Row] = 1;
+  }
+}
+
+
+void PLTPixelMask::AddColumn (int const Channel, int const ROC, int const Col)
+{
+  for (int Row = 0; Row != PLTU::NROW; ++Row) {
+    Add(Channel, ROC, Col, Row);
+  }
+}
+
+
+void PLTPixelMask::AddRow (int const Channel, int const ROC, int const Row)
+{
+  for (int Col = 0; Col != PLTU::NCOL; ++Col) {
+    Add(Channel, ROC, Col, Row);
+  }
+}
+
+
+void PLTPixelMask::Clear ()
+{
+  fMaps.clear();
+}
+
+
+size_t PLTPixelMask::Filter (int const Channel, uint8_t const* ROC, uint8_t const* Col, uint8_t const* Row, size_t const NHits, uint16_t* Good) const
+{
+  /** Look up all hits without branches: hits of ROCs without a map or outside of the pixel matrix read the unmasked map.
+   *  Every index is written and the output position only advances for unmasked hits. */
+  uint8_t const * Maps[MAXROC];
+  for (int iROC = 0; iROC != MAXROC; ++iROC) {
+    uint8_t const * Map = GetMap(Channel, iROC);
+    Maps[iROC] = Map != nullptr ? Map : UnmaskedMap;
+  }
+
+  size_t NGood = 0;
+  for (size_t i = 0; i != NHits; ++i) {
+    bool const Inside = (ROC[i] < MAXROC) & (Col[i] < PLTU::NCOL) & (Row[i] < PLTU::NROW);
+    uint8_t const * Map = Maps[Inside ? ROC[i] : 0];
+    uint8_t const Masked = Map[Inside ? Col[i] * PLTU::NROW + Row[i] : 0];
+    Good[NGood] = uint16_t(i);
+    NGood += 1 - Masked;
+  }
+  return NGood;
+}
+
+
+size_t PLTPixelMask::NMasked () const
+{
+  size_t N = 0;
+  for (auto const & Map: fMaps) {
+    for (auto const Masked: Map) {
+      N += Masked;
+    }
+  }
+  return N;
+}
+
+
+std::vector<int> PLTPixelMask::GetMaskedPixels () const
+{
+  std::vector<int> Pixels;
+  for (size_t i = 0; i != fMaps.size(); ++i) {
+    for (size_t iPixel = 0; iPixel != fMaps[i].size(); ++iPixel) {
+      if (fMaps[i][iPixel]) {
+        int const Channel = int(i) / MAXROC, ROC = int(i) % MAXROC;
+        int const Col = int(iPixel) / PLTU::NROW, Row = int(iPixel) % PLTU::NROW;
+        Pixels.push_back(Channel * 100000 + ROC * 10000 + Col * 100 + Row);
+      }
+    }
+  }
+  return Pixels;
+}
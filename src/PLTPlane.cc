@@ -1,4 +1,20 @@
 #include "PLTPlane.h"
+#include "PLTEventArena.h"
+#include <stdexcept>
+
+namespace {
+  /** Occupancy grid: index of the first hit in each pixel and the next hit in the same pixel (-1 = none).
+   *  The grid is only touched at the positions of the hits and reset after clustering. */
+  thread_local std::vector<int> HitGridFirst(PLTU::NCOL * PLTU::NROW, -1);
+  thread_local std::vector<int> HitGridNext;
+  thread_local std::vector<char> HitIsClustered;
+  thread_local std::vector<std::pair<int, int> > HitStack;  // (hit index, last checked neighbour index)
+  thread_local std::vector<int> HitWindow;
+
+  inline int GridCell (int const Col, int const Row) { return (Col - PLTU::FIRSTCOL) * PLTU::NROW + Row - PLTU::FIRSTROW; }
+}
+
+bool PLTPlane::UseGridClustering = true;
 
 
 PLTPlane::PLTPlane ()
@@ -16,7 +32,8 @@ PLTPlane::PLTPlane (int const Channel)
 
 PLTPlane::~PLTPlane ()
 {
-  // The Clusters belong to the Plane so we need to delete them
+  // The Clusters belong to the Plane (unless they are from the event arena) so we need to delete them
+  if (fArena != nullptr) return;
   for (size_t i = 0; i != fClusters.size(); ++i) {
     delete fClusters[i];
   }
@@ -69,7 +86,7 @@ bool PLTPlane::AddClusterFromSeedNxN (PLTHit* Hit, int const mCol, int const mRo
   }
 
   // New cluster
-  PLTCluster* Cluster = new PLTCluster();
+  PLTCluster* Cluster = NewCluster();
 
   if ( std::count(fClusterizedHits.begin(), fClusterizedHits.end(), Hit) != 0 ) {
     std::cout << "HIHIHI" << std::endl;
@@ -141,6 +158,28 @@ void PLTPlane::Clusterize (Clustering const Clust, FiducialRegion const FidR)
   // I sort hits here so that the largest charge hits are picked up first.
   // Use that if you want, otherwise unsorted..
 
+  bool const UseGrid = UseGridClustering and (Clust <= kClustering_Seed_9x9 or Clust == kClustering_AllTouching);
+  if (UseGrid) {
+    if (Clust != kClustering_AllTouching) {
+      std::sort(fHits.begin(), fHits.end(), PLTPlane::CompareChargeReverse);
+    }
+    if (FillHitGrid()) {
+      switch (Clust) {
+        case kClustering_Seed_3x3: ClusterizeFromSeedNxNGrid(1, 1, FidR); break;
+        case kClustering_Seed_5x5: ClusterizeFromSeedNxNGrid(2, 2, FidR); break;
+        case kClustering_Seed_9x9: ClusterizeFromSeedNxNGrid(4, 4, FidR); break;
+        default: ClusterizeAllTouchingGrid();
+      }
+      for (size_t i = 0; i != fHits.size(); ++i) {
+        if (!HitIsClustered[i]) {
+          fUnclusteredHits.push_back(fHits[i]);
+        }
+      }
+      ClearHitGrid();
+      return;
+    }
+  }
+
   switch (Clust) {
     case kClustering_Seed_3x3:
       std::sort(fHits.begin(), fHits.end(), PLTPlane::CompareChargeReverse);
@@ -157,7 +196,7 @@ void PLTPlane::Clusterize (Clustering const Clust, FiducialRegion const FidR)
     case kClustering_NNeighbors:
       //ClusterizeNNeighbors();
       std::cerr << "PLTPlane::ClusterizeNNeighbors not written yet" << std::endl;
-      throw;
+      throw std::logic_error("PLTPlane::ClusterizeNNeighbors not written yet");
       break;
     case kClustering_AllTouching:
       ClusterizeAllTouching(FidR);
@@ -228,7 +267,7 @@ void PLTPlane::ClusterizeAllTouching (FiducialRegion const FidR)
     if (std::find(fClusterizedHits.begin(), fClusterizedHits.end(), fHits[i]) != fClusterizedHits.end()) {
       continue;
     }
-    PLTCluster* Cluster = new PLTCluster();
+    PLTCluster* Cluster = NewCluster();
     Cluster->AddHit(fHits[i]);
     fClusterizedHits.push_back(fHits[i]);
     AddAllHitsTouching(Cluster, fHits[i], FidR);
@@ -247,7 +286,7 @@ void PLTPlane::ClusterizeOnePixOneCluster()
     if (std::find(fClusterizedHits.begin(), fClusterizedHits.end(), fHits[i]) != fClusterizedHits.end()) {
       continue;
     }
-    PLTCluster* Cluster = new PLTCluster();
+    PLTCluster* Cluster = NewCluster();
     Cluster->AddHit(fHits[i]);
     fClusterizedHits.push_back(fHits[i]);
     fClusters.push_back(Cluster);
@@ -258,6 +297,160 @@ void PLTPlane::ClusterizeOnePixOneCluster()
 
 
 
+bool PLTPlane::FillHitGrid ()
+{
+  // Put the indices of all hits in the occupancy grid, fails if a hit is outside of the pixel matrix
+  for (size_t i = 0; i != fHits.size(); ++i) {
+    int const Col = fHits[i]->Column(), Row = fHits[i]->Row();
+    if (Col < PLTU::FIRSTCOL || Col > PLTU::LASTCOL || Row < PLTU::FIRSTROW || Row > PLTU::LASTROW) {
+      return false;
+    }
+  }
+  HitGridNext.assign(fHits.size(), -1);
+  HitIsClustered.assign(fHits.size(), 0);
+  // fill backwards so that hits in the same pixel are chained in increasing index
+  for (int i = int(fHits.size()) - 1; i >= 0; --i) {
+    int & First = HitGridFirst[GridCell(fHits[i]->Column(), fHits[i]->Row())];
+    HitGridNext[i] = First;
+    First = i;
+  }
+  return true;
+}
+
+
+void PLTPlane::ClearHitGrid ()
+{
+  for (size_t i = 0; i != fHits.size(); ++i) {
+    HitGridFirst[GridCell(fHits[i]->Column(), fHits[i]->Row())] = -1;
+  }
+}
+
+
+PLTCluster* PLTPlane::NewCluster ()
+{
+  return fArena != nullptr ? fArena->NewCluster() : new PLTCluster();
+}
+
+
+void PLTPlane::AddToCluster (PLTCluster* Cluster, int const i)
+{
+  Cluster->AddHit(fHits[i]);
+  fClusterizedHits.push_back(fHits[i]);
+  HitIsClustered[i] = 1;
+}
+
+
+int PLTPlane::NextTouchingHit (int const iHit, int const Last)
+{
+  // Lowest index > Last of an unclustered hit touching hit iHit (-1 if there is none).
+  // This is the order in which the recursive AddAllHitsTouching picks up the hits.
+  int const Col = fHits[iHit]->Column(), Row = fHits[iHit]->Row();
+  int Next = -1;
+  for (int iCol = std::max(Col - 1, PLTU::FIRSTCOL); iCol <= std::min(Col + 1, PLTU::LASTCOL); ++iCol) {
+    for (int iRow = std::max(Row - 1, PLTU::FIRSTROW); iRow <= std::min(Row + 1, PLTU::LASTROW); ++iRow) {
+      for (int j = HitGridFirst[GridCell(iCol, iRow)]; j != -1; j = HitGridNext[j]) {
+        if (j > Last && j != iHit && !HitIsClustered[j] && (Next == -1 || j < Next)) {
+          Next = j;
+        }
+      }
+    }
+  }
+  return Next;
+}
+
+
+void PLTPlane::ClusterizeAllTouchingGrid ()
+{
+  // Same clusters (and hit order) as ClusterizeAllTouching, depth first search with an explicit stack
+  for (size_t i = 0; i != fHits.size(); ++i) {
+    if (HitIsClustered[i]) {
+      continue;
+    }
+    PLTCluster* Cluster = NewCluster();
+    AddToCluster(Cluster, int(i));
+    HitStack.assign(1, std::make_pair(int(i), -1));
+    while (!HitStack.empty()) {
+      int const Next = NextTouchingHit(HitStack.back().first, HitStack.back().second);
+      if (Next == -1) {
+        HitStack.pop_back();
+        continue;
+      }
+      HitStack.back().second = Next;
+      AddToCluster(Cluster, Next);
+      HitStack.push_back(std::make_pair(Next, -1));
+    }
+    fClusters.push_back(Cluster);
+  }
+
+  return;
+}
+
+
+bool PLTPlane::IsBiggestHitInNxNGrid (int const iHit, int const mRow, int const mCol)
+{
+  // Same as IsBiggestHitInNxN, but only looks at the pixels in the window
+  int const Col = fHits[iHit]->Column(), Row = fHits[iHit]->Row();
+  for (int iCol = std::max(Col - mCol, PLTU::FIRSTCOL); iCol <= std::min(Col + mCol, PLTU::LASTCOL); ++iCol) {
+    for (int iRow = std::max(Row - mRow, PLTU::FIRSTROW); iRow <= std::min(Row + mRow, PLTU::LASTROW); ++iRow) {
+      if (iCol == Col && iRow == Row) {
+        continue;
+      }
+      for (int j = HitGridFirst[GridCell(iCol, iRow)]; j != -1; j = HitGridNext[j]) {
+        if (fHits[j]->Charge() > fHits[iHit]->Charge()) {
+          return false;
+        }
+      }
+    }
+  }
+
+  return true;
+}
+
+
+void PLTPlane::AddClusterFromSeedNxNGrid (int const iHit, int const mCol, int const mRow)
+{
+  // Same as AddClusterFromSeedNxN, the hits in the window are added in the order of fHits
+  if (HitIsClustered[iHit]) {
+    return;
+  }
+  PLTCluster* Cluster = NewCluster();
+  AddToCluster(Cluster, iHit);
+
+  int const Col = fHits[iHit]->Column(), Row = fHits[iHit]->Row();
+  HitWindow.clear();
+  for (int iCol = std::max(Col - mCol, PLTU::FIRSTCOL); iCol <= std::min(Col + mCol, PLTU::LASTCOL); ++iCol) {
+    for (int iRow = std::max(Row - mRow, PLTU::FIRSTROW); iRow <= std::min(Row + mRow, PLTU::LASTROW); ++iRow) {
+      if (iCol == Col && iRow == Row) {
+        continue;
+      }
+      for (int j = HitGridFirst[GridCell(iCol, iRow)]; j != -1; j = HitGridNext[j]) {
+        if (!HitIsClustered[j]) {
+          HitWindow.push_back(j);
+        }
+      }
+    }
+  }
+  std::sort(HitWindow.begin(), HitWindow.end());
+  for (size_t i = 0; i != HitWindow.size(); ++i) {
+    AddToCluster(Cluster, HitWindow[i]);
+  }
+
+  fClusters.push_back(Cluster);
+}
+
+
+void PLTPlane::ClusterizeFromSeedNxNGrid (int const mCol, int const mRow, FiducialRegion const FidR)
+{
+  for (size_t i = 0; i != fHits.size(); ++i) {
+    if (IsBiggestHitInNxNGrid(int(i), mCol, mRow) && IsFiducial(FidR, fHits[i])) {
+      AddClusterFromSeedNxNGrid(int(i), mCol, mRow);
+    }
+  }
+  return;
+}
+
+
+
 float PLTPlane::TZ ()
 {
   // Get the z-coord of this plane in the telescope
@@ -428,6 +621,21 @@ int PLTPlane::ROC ()
 }
 
 
+void PLTPlane::Clear ()
+{
+  /** empty the plane for the next event, the vectors keep their capacity */
+  if (fArena == nullptr) {
+    for (size_t i = 0; i != fClusters.size(); ++i) {
+      delete fClusters[i];
+    }
+  }
+  fHits.clear();
+  fClusterizedHits.clear();
+  fUnclusteredHits.clear();
+  fClusters.clear();
+}
+
+
 void PLTPlane::SetChannel (int const in)
 {
   fChannel = in;
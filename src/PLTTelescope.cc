@@ -2,7 +2,7 @@
 #include <algorithm>
 #include <memory>
 
-PLTTelescope::PLTTelescope ()
+PLTTelescope::PLTTelescope (): fOwnsTracks(true)
 {
   // Con me
 }
@@ -11,7 +11,7 @@ PLTTelescope::PLTTelescope ()
 PLTTelescope::~PLTTelescope ()
 {
     /** delete the constructed pointers*/
-    for (size_t itrack = 0; itrack != fTracks.size(); ++itrack)
+    for (size_t itrack = 0; itrack != fTracks.size() and fOwnsTracks; ++itrack)
         delete fTracks[itrack];
     for (size_t iplane = 0; iplane != fPlanes.size(); ++iplane)
         delete fPlanes[iplane];
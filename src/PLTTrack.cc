@@ -1,9 +1,14 @@
 #include <cmath>
+#include <tuple>
 #include <PLTTrack.h>
 
 
 #include "PLTTrack.h"
 #include "PLTTelescope.h"
+#include "PLTLineFit.h"
+
+
+bool PLTTrack::UseRootFit = false;
 
 
 PLTTrack::PLTTrack ()
@@ -98,11 +103,11 @@ int PLTTrack::MakeTrack (PLTAlignment& Alignment, int nPlanes)
     // Compute the points in telescope coords where line passes each plane
     for (int iPlane = 0; iPlane < nPlanes; ++iPlane) {
 
-      PLTAlignment::CP* C = Alignment.GetCP(Channel, iPlane);
+      float const LZ = Alignment.Frame(Channel, iPlane).LZ;
 
-      XT[iPlane] = (C->LZ - fClusters[0]->TZ()) * fSlopeX + fClusters[0]->TX();
-      YT[iPlane] = (C->LZ - fClusters[0]->TZ()) * fSlopeY + fClusters[0]->TY();
-      ZT[iPlane] =  C->LZ;
+      XT[iPlane] = (LZ - fClusters[0]->TZ()) * fSlopeX + fClusters[0]->TX();
+      YT[iPlane] = (LZ - fClusters[0]->TZ()) * fSlopeY + fClusters[0]->TY();
+      ZT[iPlane] =  LZ;
     }
   }
 //  else if (NClusters() == 3) {
@@ -160,45 +165,72 @@ int PLTTrack::MakeTrack (PLTAlignment& Alignment, int nPlanes)
   // >3 clusters
   else{
 
-    // Use Tgraphs to fit the x/y-coordinates
-    // Graph: 1st coord / 2nd coord:
-    // gX: Z / X
-    // gY: Z / Y
-    TGraphErrors gX( NClusters() );
-    TGraphErrors gY( NClusters() );
+    double SlopeX, SlopeY, OffsetX, OffsetY;
 
-    // Fill the graph with telescope coordinates
-    for (uint8_t iCl=0; iCl < NClusters(); iCl++){
-      gX.SetPoint( iCl, fClusters[iCl]->TZ(), fClusters[iCl]->TX());
-      gY.SetPoint( iCl, fClusters[iCl]->TZ(), fClusters[iCl]->TY());
+    if (UseRootFit or NClusters() > PLTLineFit::MaxPoints) {
+      // Use Tgraphs to fit the x/y-coordinates
+      // Graph: 1st coord / 2nd coord:
+      // gX: Z / X
+      // gY: Z / Y
+      TGraphErrors gX( NClusters() );
+      TGraphErrors gY( NClusters() );
 
-      gX.SetPointError( iCl, 0, Alignment.GetErrorX(fClusters[iCl]->ROC() ));
-      gY.SetPointError( iCl, 0, Alignment.GetErrorY(fClusters[iCl]->ROC() ));
-    }
+      // Fill the graph with telescope coordinates
+      for (uint8_t iCl=0; iCl < NClusters(); iCl++){
+        gX.SetPoint( iCl, fClusters[iCl]->TZ(), fClusters[iCl]->TX());
+        gY.SetPoint( iCl, fClusters[iCl]->TZ(), fClusters[iCl]->TY());
+
+        gX.SetPointError( iCl, 0, Alignment.GetErrorX(fClusters[iCl]->ROC() ));
+        gY.SetPointError( iCl, 0, Alignment.GetErrorY(fClusters[iCl]->ROC() ));
+      }
 
-    TF1 funX("funX","[0]*x+[1]");
-    TF1 funY("funY","[0]*x+[1]");
+      TF1 funX("funX","[0]*x+[1]");
+      TF1 funY("funY","[0]*x+[1]");
 
-    gX.Fit( &funX, "Q" );
-    gY.Fit( &funY, "Q" );
+      gX.Fit( &funX, "Q" );
+      gY.Fit( &funY, "Q" );
+
+      SlopeX = funX.GetParameter(0);
+      SlopeY = funY.GetParameter(0);
+      OffsetX = funX.GetParameter(1);
+      OffsetY = funY.GetParameter(1);
+      fChi2X = funX.GetChisquare();
+      fChi2Y = funY.GetChisquare();
+    }
+    else {
+      // Closed form weighted least squares of TX and TY vs. TZ (same chi2 as the TF1 fit, no allocations)
+      PLTLineFit FitX, FitY;
+      for (size_t iCl = 0; iCl != NClusters(); ++iCl) {
+        float const TZ = fClusters[iCl]->TZ();
+        FitX.Add(TZ, fClusters[iCl]->TX(), Alignment.GetErrorX(fClusters[iCl]->ROC()));
+        FitY.Add(TZ, fClusters[iCl]->TY(), Alignment.GetErrorY(fClusters[iCl]->ROC()));
+      }
+      FitX.Solve();
+      FitY.Solve();
+
+      SlopeX = FitX.Slope;
+      SlopeY = FitY.Slope;
+      OffsetX = FitX.Offset;
+      OffsetY = FitY.Offset;
+      fChi2X = float(FitX.Chi2);
+      fChi2Y = float(FitY.Chi2);
+    }
 
     // Store fit results
-    fAngleX = float(atan(funX.GetParameter(0)) * 180 / M_PI);
-    fAngleY = float(atan(funY.GetParameter(0)) * 180 / M_PI);
-    fAngleRadX = funX.GetParameter(0);
-    fAngleRadY = funY.GetParameter(0);
-    fOffsetX = float(funX.GetParameter(1));
-    fOffsetY = float(funY.GetParameter(1));
+    fAngleX = float(atan(SlopeX) * 180 / M_PI);
+    fAngleY = float(atan(SlopeY) * 180 / M_PI);
+    fAngleRadX = SlopeX;
+    fAngleRadY = SlopeY;
+    fOffsetX = float(OffsetX);
+    fOffsetY = float(OffsetY);
     fSlopeX = fAngleRadX;
     fSlopeY = fAngleRadY;
 
-    VX = funX.GetParameter(0);
-    VY = funY.GetParameter(0);
+    VX = SlopeX;
+    VY = SlopeY;
     VZ = 1;
 
-    fChi2X = funX.GetChisquare();
-    fChi2Y = funY.GetChisquare();
-    fChi2 = funX.GetChisquare() + funY.GetChisquare();
+    fChi2 = fChi2X + fChi2Y;
 
     // Length
     float const Mod = sqrt(VX*VX + VY*VY + VZ*VZ);
@@ -213,11 +245,11 @@ int PLTTrack::MakeTrack (PLTAlignment& Alignment, int nPlanes)
     // Compute the points in telescope coords where line passes each plane
     for (int ip = 0; ip < nPlanes ; ++ip) {
 
-      PLTAlignment::CP* C = Alignment.GetCP(Channel, ip);
+      float const LZ = Alignment.Frame(Channel, ip).LZ;
 
-        XT[ip] = (C->LZ ) * funX.GetParameter(0) + funX.GetParameter(1);
-        YT[ip] = (C->LZ ) * funY.GetParameter(0) + funY.GetParameter(1);
-        ZT[ip] = C->LZ;
+        XT[ip] = (LZ ) * SlopeX + OffsetX;
+        YT[ip] = (LZ ) * SlopeY + OffsetY;
+        ZT[ip] = LZ;
       }
 
   }
@@ -231,17 +263,15 @@ int PLTTrack::MakeTrack (PLTAlignment& Alignment, int nPlanes)
   fTOZ = ZT[0];
 
   // These "G" quantities are defined to be point on ROC0
-  std::vector<float> GV;
   // Rotate vector only..
-  Alignment.VTtoVGXYZ(GV, fTVX, fTVY, fTVZ, Channel, 0);
-  fGVX = GV[0];
-  fGVY = GV[1];
-  fGVZ = GV[2];
-  std::vector<float> GO;
-  Alignment.TtoGXYZ(GO, fTOX, fTOY, fTOZ, Channel, 0);
-  fGOX = GO[0];
-  fGOY = GO[1];
-  fGOZ = GO[2];
+  PLTAlignment::XYZ const GV = Alignment.VTtoVG({fTVX, fTVY, fTVZ}, Channel, 0);
+  fGVX = GV.X;
+  fGVY = GV.Y;
+  fGVZ = GV.Z;
+  PLTAlignment::XYZ const GO = Alignment.TtoG({fTOX, fTOY, fTOZ}, Channel, 0);
+  fGOX = GO.X;
+  fGOY = GO.Y;
+  fGOZ = GO.Z;
 
   // Compute where this track passes through each X=0, Y=0, Z=0 planes // DA: TODO this computes the tracks coords in planes x=0, y=0 and z=0
   fPlaner[0][0] = fGOX - fGOX / fGVX * fGVX;
@@ -270,8 +300,7 @@ int PLTTrack::MakeTrack (PLTAlignment& Alignment, int nPlanes)
     //int const Channel = Cluster->SeedHit()->Channel();
     int const ROC     = Cluster->SeedHit()->ROC();
 
-    XL[ROC] = Alignment.TtoLX(XT[ROC], YT[ROC], Channel, ROC);
-    YL[ROC] = Alignment.TtoLY(XT[ROC], YT[ROC], Channel, ROC);
+    std::tie(XL[ROC], YL[ROC]) = Alignment.TtoLXY(XT[ROC], YT[ROC], Channel, ROC);
 
     fLResidualX[ROC] = XL[ROC] - Cluster->LX();
     fLResidualY[ROC] = YL[ROC] - Cluster->LY();
@@ -357,12 +386,9 @@ float PLTTrack::TY (float const Z)
 
 std::pair<float, float> PLTTrack::GXYatGZ (float const GZ, PLTAlignment& Alignment)
 {
-  std::vector<float> T;
-  Alignment.GtoTXYZ(T, GZ, 0, 0, fClusters[0]->Channel(), 0);
-
-  std::vector<float> G;
-  Alignment.TtoGXYZ(G, TX(T[2]), TY(T[2]), T[2], fClusters[0]->Channel(), 0);
-  return std::make_pair(G[0], G[1]);
+  PLTAlignment::XYZ const T = Alignment.GtoT({GZ, 0, 0}, fClusters[0]->Channel(), 0);
+  PLTAlignment::XYZ const G = Alignment.TtoG({TX(T.Z), TY(T.Z), T.Z}, fClusters[0]->Channel(), 0);
+  return std::make_pair(G.X, G.Y);
 }
 
 
@@ -376,8 +402,9 @@ std::pair<float, float> PLTTrack::GetResiduals(PLTCluster & Cluster, PLTAlignmen
   float track_TX = InterPolateX(Cluster.TZ());
   float track_TY = InterPolateY(Cluster.TZ());
 
-  float track_LX = Alignment.TtoLX(track_TX, track_TY, 1, Cluster.ROC()); // Local position of the track in the plane under test
-  float track_LY = Alignment.TtoLY(track_TX, track_TY, 1, Cluster.ROC());
+  std::pair<float, float> const track_L = Alignment.TtoLXY(track_TX, track_TY, 1, Cluster.ROC()); // Local position of the track in the plane under test
+  float track_LX = track_L.first;
+  float track_LY = track_L.second;
 
   float d_LX =  (track_LX - Cluster.LX()); // residuals of track local position and the cluster local position
   float d_LY =  (track_LY - Cluster.LY());
@@ -1,5 +1,6 @@
 
 #include <PLTTracking.h>
+#include <stdexcept>
 
 // Types to hold vector-of-clusters (ClusterVector) and vector-of-vector-of-clusters (VectorClusterVectors)
 using ClusterVector = std::vector<PLTCluster *>;
@@ -14,6 +15,9 @@ struct Digits {
 };
 using Vd = std::vector<Digits>;
 
+bool PLTTracking::UseRoadSearch = false;
+float const PLTTracking::RoadWidth = 5;
+
 
 PLTTracking::PLTTracking (int nplanes, bool TrackOnlyTelescope) : fNPlanes(nplanes), trackOnlyTelescope(TrackOnlyTelescope)
 {
@@ -187,7 +191,7 @@ void PLTTracking::RunTracking (PLTTelescope& Telescope)
       break;
     default:
       std::cerr << "ERROR: PLTTracking::RunTracking() has no idea what tracking algorithm you want to use" << std::endl;
-      throw;
+      throw std::logic_error("PLTTracking::RunTracking() unknown tracking algorithm");
   }
 
   return;
@@ -264,7 +268,7 @@ void PLTTracking::TrackFinder_01to2_All (PLTTelescope& Telescope)
         // If it's not too far off, keep it!
         if (Distance < 0.2000) {
           // Keep as possible track..
-          PLTTrack* Track012 = new PLTTrack();
+          PLTTrack* Track012 = NewTrack();
           Track012->AddCluster(P0->Cluster(iCL0));
           Track012->AddCluster(P1->Cluster(iCL1));
           Track012->AddCluster(P2->Cluster(iCL2));
@@ -344,61 +348,10 @@ void PLTTracking::TrackFinder_AllPlanesHit (PLTTelescope& Telescope)
 
   // Vector to keep track of tracks that we're interested in
   std::vector<PLTTrack*> MyTracks;
-
-  // Code adapted from:
-  // http://stackoverflow.com/questions/5279051/how-can-i-create-cartesian-product-of-vector-of-vectors
-  // Idea is to have a vector of "Digit" objects that store the information to
-  // loop over a vector<cluster*>.
-  // Start all of the iterators at the beginning.
-  Vd vd;
-  for(VectorClusterVectors::const_iterator it = ClustersForTracking.begin();
-    it != ClustersForTracking.end();
-      ++it) {
-    Digits d = {(*it).begin(), (*it).end(), (*it).begin()};
-    vd.push_back(d);
-  } // end of initializing the digits
-
-  // Make sure we have at least two planes with hits
-  // otherwise it will be hard to make tracks
-//  if (vd.size() < 2)
-  if (vd.size() < 1)
+  if (ClustersForTracking.empty()) {
     return;
-
-  // Actual track creation
-  bool keepRunning = true;
-  while(keepRunning) {
-
-    PLTTrack* Track = new PLTTrack();
-    // Construct the firsr track track by accessing
-    // the iterators in the Vd object
-    for(Vd::const_iterator it = vd.begin(); it != vd.end(); it++)
-        Track->AddCluster(*(it->me));
-
-    Track->MakeTrack(*fAlignment, Telescope.NPlanes() );
-    MyTracks.push_back(Track);
-
-
-    // Increment the Digits
-    for(Vd::iterator it = vd.begin(); ; ) {
-        // Start with the left one
-        ++(it->me);
-        // If it hits its end:
-        if(it->me == it->end) {
-          // test if we are at the right end
-          if(it+1 == vd.end()) {
-            keepRunning = false;
-            break;
-          // Otherwise cascade (set to zero, increment next one on the right)
-          } else {
-              it->me = it->begin;
-              ++it;
-            }
-        // Normal increase - no cascading necessary
-        } else {
-            break;
-          }
-    } // end of incrementing the digits
-  } // end track creation
+  }
+  MakeTrackCandidates(ClustersForTracking, Telescope.NPlanes(), MyTracks);
 
   int const NTracksBefore = (int) MyTracks.size();
 
@@ -472,7 +425,44 @@ void PLTTracking::TrackFinder_ETH (PLTTelescope& Telescope)
 
   // Vector to keep track of tracks that we're interested in
   std::vector<PLTTrack*> MyTracks;
+  if (ClustersForTracking.empty()) {
+    return;
+  }
+  MakeTrackCandidates(ClustersForTracking, 4, MyTracks);
+
+  int const NTracksBefore = (int) MyTracks.size();
+
+  // Grab the best tracks first and don't let there be overlap..
+  SortOutTracksNoOverlapBestD2(MyTracks);
+
+  if (DEBUG) {
+    printf("Found NTracks possible: %4i   Kept NTracks: %4i\n", NTracksBefore, (int) MyTracks.size());
+  }
+
+  for (size_t i = 0; i != MyTracks.size(); ++i) {
+    Telescope.AddTrack(MyTracks[i]);
+  }
+//  std::cout << "TRACK:" << std::endl;
+//  for (uint8_t i = 0; i != Telescope.Track(0)->NClusters(); i++ ){
+//    if (Telescope.Track(0)->Cluster(0)->TX() - Telescope.Track(0)->Cluster(1)->TX() > 0.2){
+//        std::cout.precision(3);
+//        std::cout << Telescope.Track(0)->Cluster(i)->LX() << "\t" << Telescope.Track(0)->Cluster(i)->TX() << "\t" << Telescope.Track(0)->Cluster(i)->Hit(0)->Column();
+//        std::cout << "\t" << Telescope.Track(0)->Cluster(i)->Hit(0)->ROC() << std::endl;
+//        std::cout << Telescope.Track(0)->Cluster(i)->LY() << "\t" << Telescope.Track(0)->Cluster(i)->TY() << "\t" << Telescope.Track(0)->Cluster(i)->Hit(0)->Row() << std::endl;
+//    }
+//  }
+//  std::cout << std::endl;
+  return;
+}
+
+
+
+
 
+
+
+void PLTTracking::AddAllCombinations (std::vector<std::vector<PLTCluster*> > const& ClustersForTracking, int const NPlanes, std::vector<PLTTrack*>& MyTracks)
+{
   // Code adapted from:
   // http://stackoverflow.com/questions/5279051/how-can-i-create-cartesian-product-of-vector-of-vectors
   // Idea is to have a vector of "Digit" objects that store the information to
@@ -480,27 +470,24 @@ void PLTTracking::TrackFinder_ETH (PLTTelescope& Telescope)
   // Start all of the iterators at the beginning.
   Vd vd;
   for (VectorClusterVectors::const_iterator it = ClustersForTracking.begin(); it != ClustersForTracking.end(); ++it) {
+    if (it->empty()) {
+      return;
+    }
     Digits d = {(*it).begin(), (*it).end(), (*it).begin()};
     vd.push_back(d);
   } // end of initializing the digits
 
-  // Make sure we have at least two planes with hits
-  // otherwise it will be hard to make tracks
-//  if (vd.size() < 2)
-  if (vd.size() < 1)
-    return;
-
   // Actual track creation
   bool keepRunning = true;
   while(keepRunning) {
 
-    PLTTrack* Track = new PLTTrack();
+    PLTTrack* Track = NewTrack();
     // Construct the firsr track track by accessing
     // the iterators in the Vd object
     for(Vd::const_iterator it = vd.begin(); it != vd.end(); it++)
         Track->AddCluster(*(it->me));
 
-    Track->MakeTrack(*fAlignment, 4 );
+    Track->MakeTrack(*fAlignment, NPlanes );
     MyTracks.push_back(Track);
 
 
@@ -525,36 +512,97 @@ void PLTTracking::TrackFinder_ETH (PLTTelescope& Telescope)
           }
     } // end of incrementing the digits
   } // end track creation
+}
 
-  int const NTracksBefore = (int) MyTracks.size();
-
-  // Grab the best tracks first and don't let there be overlap..
-  SortOutTracksNoOverlapBestD2(MyTracks);
 
-  if (DEBUG) {
-    printf("Found NTracks possible: %4i   Kept NTracks: %4i\n", NTracksBefore, (int) MyTracks.size());
+void PLTTracking::MakeTrackCandidates (std::vector<std::vector<PLTCluster*> > const& ClustersForTracking, int const NPlanes, std::vector<PLTTrack*>& MyTracks)
+{
+  /** Road search: seed with all pairs of clusters in the two outermost planes and predict the position on the inner planes
+      with the straight line through the seed. Only the clusters inside a window of RoadWidth times the plane errors around
+      the prediction are combined (the closest cluster if there is none inside). This is an approximation and therefore
+      opt-in: SortOutTracksNoOverlapBestD2 has no quality cut, so the full product can keep tracks outside of every road
+      (e.g. from the clusters left over by a better track) which are missing here. The candidates are also created in a
+      different order and std::sort does not keep the order of tracks with the same D2. */
+  size_t const NTrackingPlanes = ClustersForTracking.size();
+  size_t NCombinations = 1;
+  for (auto const & Clusters: ClustersForTracking) {
+    NCombinations *= Clusters.size();
   }
-
-  for (size_t i = 0; i != MyTracks.size(); ++i) {
-    Telescope.AddTrack(MyTracks[i]);
+  if (not UseRoadSearch or NTrackingPlanes < 3 or NCombinations == 1) {
+    AddAllCombinations(ClustersForTracking, NPlanes, MyTracks);
+    return;
   }
-//  std::cout << "TRACK:" << std::endl;
-//  for (uint8_t i = 0; i != Telescope.Track(0)->NClusters(); i++ ){
-//    if (Telescope.Track(0)->Cluster(0)->TX() - Telescope.Track(0)->Cluster(1)->TX() > 0.2){
-//        std::cout.precision(3);
-//        std::cout << Telescope.Track(0)->Cluster(i)->LX() << "\t" << Telescope.Track(0)->Cluster(i)->TX() << "\t" << Telescope.Track(0)->Cluster(i)->Hit(0)->Column();
-//        std::cout << "\t" << Telescope.Track(0)->Cluster(i)->Hit(0)->ROC() << std::endl;
-//        std::cout << Telescope.Track(0)->Cluster(i)->LY() << "\t" << Telescope.Track(0)->Cluster(i)->TY() << "\t" << Telescope.Track(0)->Cluster(i)->Hit(0)->Row() << std::endl;
-//    }
-//  }
-//  std::cout << std::endl;
-  return;
-}
-
-
 
+  // the outermost planes in z are the seed planes
+  size_t First = 0, Last = 0;
+  for (size_t i = 0; i != NTrackingPlanes; ++i) {
+    if (ClustersForTracking[i][0]->TZ() < ClustersForTracking[First][0]->TZ()) { First = i; }
+    if (ClustersForTracking[i][0]->TZ() > ClustersForTracking[Last][0]->TZ()) { Last = i; }
+  }
 
+  // spatial index of each plane: the clusters sorted in TX, together with their index in the plane
+  fRoadIndex.resize(NTrackingPlanes);
+  for (size_t i = 0; i != NTrackingPlanes; ++i) {
+    fRoadIndex[i].clear();
+    for (size_t j = 0; j != ClustersForTracking[i].size(); ++j) {
+      fRoadIndex[i].emplace_back(ClustersForTracking[i][j]->TX(), j);
+    }
+    std::sort(fRoadIndex[i].begin(), fRoadIndex[i].end(), [](std::pair<float, size_t> const& a, std::pair<float, size_t> const& b) { return a.first < b.first; });
+  }
 
+  VectorClusterVectors Road(NTrackingPlanes);
+  for (auto Seed0: ClustersForTracking[First]) {
+    for (auto Seed1: ClustersForTracking[Last]) {
+      float const DZ = Seed1->TZ() - Seed0->TZ();
+      float const SlopeX = DZ != 0 ? (Seed1->TX() - Seed0->TX()) / DZ : 0;
+      float const SlopeY = DZ != 0 ? (Seed1->TY() - Seed0->TY()) / DZ : 0;
+      float const SeedErrorX2 = pow(fAlignment->GetErrorX(Seed0->ROC()), 2) + pow(fAlignment->GetErrorX(Seed1->ROC()), 2);
+      float const SeedErrorY2 = pow(fAlignment->GetErrorY(Seed0->ROC()), 2) + pow(fAlignment->GetErrorY(Seed1->ROC()), 2);
+
+      for (size_t i = 0; i != NTrackingPlanes; ++i) {
+        Road[i].clear();
+        if (i == First or i == Last) {
+          Road[i].push_back(i == First ? Seed0 : Seed1);
+          continue;
+        }
+        std::vector<PLTCluster*> const & Clusters = ClustersForTracking[i];
+        int const ROC = Clusters[0]->ROC();
+        float const Z = Clusters[0]->TZ() - Seed0->TZ();
+        float const X = Seed0->TX() + SlopeX * Z;
+        float const Y = Seed0->TY() + SlopeY * Z;
+        float const WX = RoadWidth * std::sqrt(SeedErrorX2 + pow(fAlignment->GetErrorX(ROC), 2));
+        float const WY = RoadWidth * std::sqrt(SeedErrorY2 + pow(fAlignment->GetErrorY(ROC), 2));
+
+        fRoadSelection.clear();
+        auto const Begin = std::lower_bound(fRoadIndex[i].begin(), fRoadIndex[i].end(), X - WX, [](std::pair<float, size_t> const& a, float x) { return a.first < x; });
+        for (auto it = Begin; it != fRoadIndex[i].end() and it->first <= X + WX; ++it) {
+          if (fabs(Clusters[it->second]->TY() - Y) <= WY) {
+            fRoadSelection.push_back(it->second);
+          }
+        }
+        if (fRoadSelection.empty()) {
+          // nothing inside the window: keep the closest cluster as every combination of the full product has one on this plane
+          size_t Closest = 0;
+          float MinDistance = 0;
+          for (size_t j = 0; j != Clusters.size(); ++j) {
+            float const Distance = pow((Clusters[j]->TX() - X) / WX, 2) + pow((Clusters[j]->TY() - Y) / WY, 2);
+            if (j == 0 or Distance < MinDistance) {
+              Closest = j;
+              MinDistance = Distance;
+            }
+          }
+          fRoadSelection.push_back(Closest);
+        }
+        // keep the clusters in the same order as in the plane
+        std::sort(fRoadSelection.begin(), fRoadSelection.end());
+        for (auto j: fRoadSelection) {
+          Road[i].push_back(Clusters[j]);
+        }
+      }
+      AddAllCombinations(Road, NPlanes, MyTracks);
+    }
+  }
+}
 
 
 void PLTTracking::SortOutTracksNoOverlapBestD2 (std::vector<PLTTrack*>& MyTracks)
@@ -599,7 +647,7 @@ void PLTTracking::SortOutTracksNoOverlapBestD2 (std::vector<PLTTrack*>& MyTracks
   MyTracks = UsedTracks;
 
   // Delete the unused tracks
-  for (size_t i = 0; i != SkippedTracks.size(); ++i) {
+  for (size_t i = 0; i != SkippedTracks.size() and fArena == nullptr; ++i) {
     delete SkippedTracks[i];
   }
 
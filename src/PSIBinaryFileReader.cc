@@ -1,9 +1,16 @@
 #include "PSIBinaryFileReader.h"
+#include "StageTimer.h"
 
 #include <iostream>
 #include <string>
 #include <stdint.h>
 #include <stdlib.h>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <stdexcept>
 
 #include "TGraph.h"
 #include "TString.h"
@@ -13,13 +20,14 @@
 #include "TMarker.h"
 #include "TLine.h"
 
-PSIBinaryFileReader::PSIBinaryFileReader(std::string const InFileName) : PSIFileReader(false)
+PSIBinaryFileReader::PSIBinaryFileReader(std::string const InFileName) : PSIFileReader(false),
+  fEventWords(fBuffer), fMappedFile(nullptr), fMappedSize(0), fMappedWords(nullptr), fNMappedWords(0), fMappedPos(0)
 {
   fEOF = 0;
   fBinaryFileName = InFileName;
   if (!OpenFile()) {
     std::cerr << "ERROR: cannot open input file: " << InFileName << std::endl;
-    throw;
+    throw std::runtime_error("cannot open input file: " + InFileName);
   }
 
   // Initialize fLevelsROC with zeros
@@ -37,6 +45,9 @@ PSIBinaryFileReader::PSIBinaryFileReader(std::string const InFileName) : PSIFile
 PSIBinaryFileReader::~PSIBinaryFileReader ()
 {
   Clear();
+  if (fMappedFile != nullptr) {
+    munmap(fMappedFile, fMappedSize);
+  }
 }
 
 void PSIBinaryFileReader::CloseFile() {
@@ -48,6 +59,39 @@ bool PSIBinaryFileReader::OpenFile ()
 {
 
   fEOF = false;
+  fMappedPos = 0;
+  /** release the mapping or stream of a previously opened file */
+  if (fMappedFile != nullptr) {
+    munmap(fMappedFile, fMappedSize);
+    fMappedFile = nullptr;
+    fMappedSize = 0;
+    fMappedWords = nullptr;
+    fNMappedWords = 0;
+  }
+  if (fInputBinaryFile.is_open()) {
+    fInputBinaryFile.close();
+  }
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  /** the words are stored little endian, so on little endian machines the mapped file can be used as array of words */
+  int fd = open(fBinaryFileName.c_str(), O_RDONLY);
+  struct stat st {};
+  if (fd >= 0 and fstat(fd, &st) == 0 and st.st_size >= 2) {
+    void * mapped = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapped != MAP_FAILED) {
+      madvise(mapped, size_t(st.st_size), MADV_SEQUENTIAL);
+      fMappedFile = mapped;
+      fMappedSize = size_t(st.st_size);
+      fMappedWords = static_cast<const unsigned short*>(mapped);
+      fNMappedWords = fMappedSize / 2;
+    }
+  }
+  if (fd >= 0) {
+    close(fd);
+  }
+  if (fMappedFile != nullptr) {
+    return true;
+  }
+#endif
   fInputBinaryFile.clear();
   fInputBinaryFile.open(fBinaryFileName.c_str(), std::ios::in | std::ios::binary);
   if (fInputBinaryFile.is_open()) {
@@ -62,6 +106,7 @@ void PSIBinaryFileReader::ResetFile ()
   // Reset the file
   std::cout << "Reset the file!" << std::endl;
 
+  fMappedPos = 0;
   fInputBinaryFile.clear() ;
   fInputBinaryFile.seekg(0, fInputBinaryFile.beg) ;
   fEOF = false;
@@ -83,17 +128,67 @@ unsigned short PSIBinaryFileReader::readBinaryWordFromFile()
   return word;
 }
 
+int PSIBinaryFileReader::HeaderCode(unsigned short word)
+{
+  switch (word) {
+    case 0x8000: return 0;   // end of file
+    case 0x8001: return 1;   // data
+    case 0x8004: return 4;   // trig
+    case 0x8008: return 8;   // reset
+    case 0x8080: return 80;  // overflow
+    default: return -1;
+  }
+}
+
+size_t PSIBinaryFileReader::FindNextHeader(size_t pos) const
+{
+  /** all headers have the highest bit set, so test four words at once and only look closer if one of them has it */
+  uint64_t const high_bits = 0x8000800080008000ULL;
+  while (pos + 4 <= fNMappedWords) {
+    uint64_t four_words;
+    memcpy(&four_words, fMappedWords + pos, sizeof(four_words));
+    if (four_words & high_bits) {
+      for (size_t end = pos + 4; pos != end; ++pos) {
+        if (HeaderCode(fMappedWords[pos]) > -1) return pos;
+      }
+    } else {
+      pos += 4;
+    }
+  }
+  for (; pos < fNMappedWords; ++pos) {
+    if (HeaderCode(fMappedWords[pos]) > -1) return pos;
+  }
+  return fNMappedWords;
+}
+
 // ----------------------------------------------------------------------
 int PSIBinaryFileReader::nextBinaryHeader()
 {
 
   int header(-1);
 
-  for (int i = 0; i < MAXNDATA; ++i)
-  {
-    fBuffer[i] = 0;
+  if (fMappedFile != nullptr) {
+    /** the event is a view into the mapped file */
+    size_t const end = FindNextHeader(fMappedPos);
+    fEventWords = fMappedWords + fMappedPos;
+    fBufferSize = int(end - fMappedPos);
+    if (fBufferSize >= MAXNDATA) {
+      std::cerr << "ERROR: fBufferSize >= MAXNDATA: " << fBufferSize << std::endl;
+      exit(1);
+    }
+    if (end == fNMappedWords) {
+      fEOF = true;
+      fMappedPos = end;
+    } else {
+      header = HeaderCode(fMappedWords[end]);
+      fMappedPos = end + 1;
+    }
+    fHeader     = fNextHeader;
+    fNextHeader = header;
+    return header;
   }
 
+  fEventWords = fBuffer;
   fBufferSize = 0;
   unsigned short word(0);
 
@@ -103,36 +198,7 @@ int PSIBinaryFileReader::nextBinaryHeader()
 
     if (fEOF) break;
 
-    if (word == 0x8000)
-    {
-      //      cout << "==> end of file " << endl;
-      header = 0;
-      break;
-    }
-
-    if (word == 0x8001)
-    {
-      header = 1;
-      //      cout << " --> data " <<endl;
-    }
-
-    if (word == 0x8004)
-    {
-      header = 4;
-      //      cout << " --> trig " << endl;
-    }
-
-    if (word == 0x8008)
-    {
-      header = 8;
-      //      cout << " --> reset " << endl;
-    }
-
-    if (word == 0x8080)
-    {
-      header = 80;
-      //      cout << " --> overflow " << endl;
-    }
+    header = HeaderCode(word);
 
     if (header > -1)
     {
@@ -162,9 +228,10 @@ int PSIBinaryFileReader::decodeBinaryData()
   int j(0);
 
   if (fHeader > 0)  {
-    unsigned short t0 = fBuffer[0];
-    unsigned short t1 = fBuffer[1];
-    unsigned short t2 = fBuffer[2];
+    /** the buffer is not cleared between events, short events have no time stamp */
+    unsigned short t0 = fBufferSize > 0 ? fEventWords[0] : 0;
+    unsigned short t1 = fBufferSize > 1 ? fEventWords[1] : 0;
+    unsigned short t2 = fBufferSize > 2 ? fEventWords[2] : 0;
     fUpperTime = t0;
     fLowerTime = (t1 << 16) | t2;
     //    cout << Form(" Event at time  %04x/%08x with Header %d", fUpperTime, fLowerTime, fHeader) << endl;
@@ -177,7 +244,7 @@ int PSIBinaryFileReader::decodeBinaryData()
   int value(0);
   for (int i = 3; i < fBufferSize; ++i)
   {
-    value = fBuffer[i] & 0x0fff;
+    value = fEventWords[i] & 0x0fff;
     if (value & 0x0800) value -= 4096;
     fData[i-3] = value;
     ++j;
@@ -211,15 +278,13 @@ int PSIBinaryFileReader::GetNextEvent ()
 
   Clear();
 
-  for (int i = 0; i != fNPlanes; ++i) {
-    fPlaneMap[i].SetROC(i);;
-  }
-
+  tel::StageTimer::Clock::time_point const start = tel::StageTimer::Clock::now();
   while (nextBinaryHeader() >= 0) {
     decodeBinaryData();
     if (fBufferSize <= 0) {
       continue;
     } else {
+      tel::StageTimer::local().add(tel::Stage::Read, tel::StageTimer::Clock::now() - start);
       // decode waveform
       DecodeHits();
       return fBufferSize;
@@ -427,6 +492,7 @@ void PSIBinaryFileReader::DecodeHits ()
 
   std::vector<int> UBPositionROC(NROCs, -1);
   std::vector<int> NHitsROC(NROCs, 0);
+  tel::StageTimer::Clock::time_point const start = tel::StageTimer::Clock::now();
   for (int iroc = 0; iroc != NROCs; ++iroc) {
     UBPositionROC[iroc] = UBPosition[3+iroc];
     NHitsROC[iroc] = (UBPosition[3+iroc+1] - UBPosition[3+iroc] - 3) / 6;
@@ -437,28 +503,49 @@ void PSIBinaryFileReader::DecodeHits ()
 
       // Ignore masked pixels
       // Important: Assume Channel==1 !!!!
-      if (!IsPixelMasked( 1*100000 + iroc*10000 + colrow.first*100 + colrow.second)){
+      if (!IsPixelMasked(1, iroc, colrow.first, colrow.second)){
         //printf("Hit iroc %2i  col %2i  row %2i  PH: %4i\n", iroc, colrow.first, colrow.second, fData[ UBPosition[3 + iroc] + 2 + 6 + ihit * 6 ]);
-        PLTHit* Hit = new PLTHit(1, iroc, colrow.first, colrow.second, fData[ UBPosition[3 + iroc] + 2 + 6 + ihit * 6 ]);
-
-	if (UseGainInterpolator())
-	  fGainInterpolator.SetCharge(*Hit);
-	else
-    fGainCal.SetCharge(*Hit);
-
-        fAlignment.AlignHit(*Hit);
-        fHits.push_back(Hit);
-        fPlaneMap[Hit->ROC()].AddHit(Hit);
+        fHits.push_back(fArena.NewHit(1, iroc, colrow.first, colrow.second, fData[ UBPosition[3 + iroc] + 2 + 6 + ihit * 6 ]));
       }
     }
 
   }
+  tel::StageTimer::local().add(tel::Stage::Mask, tel::StageTimer::Clock::now() - start);
 
-  // Loop over all planes and clusterize each one, then add each plane to the correct telescope (by channel number
-  for (std::map< int, PLTPlane>::iterator it = fPlaneMap.begin(); it != fPlaneMap.end(); ++it) {
-    it->second.Clusterize(PLTPlane::kClustering_AllTouching, PLTPlane::kFiducialRegion_All);
-    AddPlane( &(it->second) );
+  {
+    tel::ScopedStage timer(tel::Stage::GainCal);
+    for (auto * Hit: fHits) {
+      if (UseGainInterpolator())
+        fGainInterpolator.SetCharge(*Hit);
+      else
+        fGainCal.SetCharge(*Hit);
+    }
+  }
+  {
+    tel::ScopedStage timer(tel::Stage::Align);
+    for (auto * Hit: fHits) { fAlignment.AlignHit(*Hit); }
+  }
+  for (auto * Hit: fHits) {
+    if (PLTPlane * Plane = PlaneOf(Hit->ROC())) { Plane->AddHit(Hit); }
+  }
+
+  ClusterizeAndTrack();
+
+  return;
+}
+
+
+
+void PSIBinaryFileReader::ClusterizeAndTrack ()
+{
+  // Loop over all planes and clusterize each one (the planes are already part of the telescope)
+  {
+    tel::ScopedStage timer(tel::Stage::Clusterize);
+    for (auto & Plane : fPlaneArray) {
+      Plane.Clusterize(PLTPlane::kClustering_AllTouching, PLTPlane::kFiducialRegion_All);
+    }
   }
+  tel::ScopedStage timer(tel::Stage::Tracking);
 
 
   // If we are doing single plane-efficiencies:
@@ -534,7 +621,7 @@ bool PSIBinaryFileReader::ReadAddressesFromFile (std::string const InFileName)
   std::ifstream f(InFileName.c_str());
   if (!f.is_open()) {
     std::cerr << "ERROR: PSIBinaryFileReader::ReadAddressesFromFile cannot open file: " << InFileName << std::endl;
-    throw;
+    throw std::runtime_error("cannot open file: " + InFileName);
   }
 
   std::cout << "PSIBinaryFileReader::ReadAddressesFromFile: " << InFileName << std::endl;
@@ -5,38 +5,46 @@
 #include <string>
 #include <cstdint>
 #include <cstdlib>
+#include <map>
+#include <mutex>
+#include <stdexcept>
 
 #include "TGraph.h"
 #include "TString.h"
 #include "TCanvas.h"
 #include "TLine.h"
 #include "GetNames.h"
+#include "StageTimer.h"
 
 using namespace std;
 
 /** ============================
  CONSTRUCTOR
  =================================*/
-PSIFileReader::PSIFileReader(bool track_only_telescope):
-  PLTTracking(GetNPlanes(), track_only_telescope),
-  fGainCal(fNPlanes, UseExternalCalibrationFunction()) {
+bool PSIFileReader::KeepCalibrations = false;
+
+PSIFileReader::PSIFileReader(bool track_only_telescope): PSIFileReader(track_only_telescope, *LoadCalibration()) { }
 
-    /** Set and read in gain calibration files */
-    tel::info("Reading calibration files from " + GetCalibrationPath());
-    for (int i_roc=0; i_roc != fNPlanes; i_roc++) {
-      string file_name = GetCalibrationPath() + Form("ROC%i.txt", i_roc);
-      fCalibrationFile.emplace_back(file_name);
+PSIFileReader::PSIFileReader(bool track_only_telescope, Calibration const & C):
+  PLTTracking(GetNPlanes(), track_only_telescope),
+  fGainInterpolator(C.GainInterpolator),
+  fGainCal(C.GainCal),
+  fAlignment(C.Alignment),
+  fPlaneArray(fNPlanes) {
+
+    SetTrackingArena(&fArena);
+    fOwnsTracks = false;
+
+    /** the planes are added to the telescope once and only cleared between the events */
+    for (int i_roc = 0; i_roc != fNPlanes; i_roc++) {
+      fPlaneArray[i_roc].SetChannel(1);
+      fPlaneArray[i_roc].SetROC(i_roc);
+      fPlaneArray[i_roc].SetArena(&fArena);
+      AddPlane(&fPlaneArray[i_roc]);
+      fCalibrationFile.emplace_back(GetCalibrationPath() + Form("ROC%i.txt", i_roc));
       fRawCalibrationFile.emplace_back(GetCalibrationPath() + Form("ph_Calibration_C%i.dat", i_roc));
-      fGainCal.ReadGainCalFile(file_name, i_roc);
-    }
-    /** read-in additional files if we want to use the GainInterpolator */
-    if (UseGainInterpolator()) {
-      for (int i_roc=0; i_roc != fNPlanes; i_roc++) {
-        fGainInterpolator.ReadFile(fRawCalibrationFile[i_roc], i_roc);
-      }
     }
 
-  fAlignment.ReadAlignmentFile(GetAlignmentFilename());// TODO: DA: make condition to skip this in case there is not analysis but only alignment?
   SetTrackingAlignment(&fAlignment);
 
   if(!trackOnlyTelescope) {
@@ -49,6 +57,48 @@ PSIFileReader::PSIFileReader(bool track_only_telescope):
 }
 
 
+shared_ptr<const PSIFileReader::Calibration> PSIFileReader::LoadCalibration ()
+{
+  /** the files are parsed once per telescope if the calibrations are kept, every reader gets its own copy */
+  static mutex Mutex;
+  static map<int16_t, shared_ptr<const Calibration> > Cache;
+  lock_guard<mutex> Lock(Mutex);
+  auto const It = Cache.find(tel::Config::telescope_id_);
+  if (KeepCalibrations and It != Cache.end()) {
+    tel::info(Form("Reusing the calibration and alignment of telescope %i", tel::Config::telescope_id_));
+    return It->second;
+  }
+
+  uint16_t const NPlanes = GetNPlanes();
+  shared_ptr<Calibration> C(new Calibration{PLTGainCal(NPlanes, UseExternalCalibrationFunction(), UseGainLookupTable()), PSIGainInterpolator(), PLTAlignment()});
+
+  /** Set and read in gain calibration files */
+  tel::info("Reading calibration files from " + GetCalibrationPath());
+  for (int i_roc=0; i_roc != NPlanes; i_roc++) {
+    C->GainCal.ReadGainCalFile(GetCalibrationPath() + Form("ROC%i.txt", i_roc), i_roc);
+  }
+  /** read-in additional files if we want to use the GainInterpolator */
+  if (UseGainInterpolator()) {
+    for (int i_roc=0; i_roc != NPlanes; i_roc++) {
+      C->GainInterpolator.ReadFile(GetCalibrationPath() + Form("ph_Calibration_C%i.dat", i_roc), i_roc);
+    }
+  }
+
+  C->Alignment.ReadAlignmentFile(GetAlignmentFilename());// TODO: DA: make condition to skip this in case there is not analysis but only alignment?
+
+  if (KeepCalibrations) { Cache[tel::Config::telescope_id_] = C; }
+  return C;
+}
+
+
+PSIFileReader::~PSIFileReader ()
+{
+  /** the planes belong to the reader and the hits, clusters and tracks of the last event to the arena, not to the telescope */
+  Clear();
+  fPlanes.clear();
+}
+
+
 size_t PSIFileReader::NHits ()
 {
   return fHits.size();
@@ -61,21 +111,53 @@ PLTHit* PSIFileReader::Hit (size_t const i)
     return fHits[i];
   }
   std::cerr << "ERROR: PSIFileReader::Hit asking for a hit outside of range." << std::endl;
-  throw;
+  throw std::out_of_range("PSIFileReader::Hit asking for a hit outside of range");
 }
 
 
-void PSIFileReader::Clear()
+int PSIFileReader::GetNextCachedEvent (PLTEventCache & Cache)
 {
-  for (size_t i = 0; i != fHits.size(); ++i) {
-    if (fHits[i]) {
-      delete fHits[i];
-    }
+  /** Read the next event from the input file and store it in the cache or, once the cache is complete,
+   *  replay the stored hits with the current alignment. */
+  if (not Cache.IsComplete()) {
+    int const ret = GetNextEvent();
+    if (ret >= 0) { Cache.AddEvent(fHits); }
+    return ret;
+  }
+
+  Clear();
+
+  uint16_t n_hits;
+  const PLTEventCache::Hit * CachedHits;
+  if (not Cache.NextEvent(CachedHits, n_hits)) {
+    return -1;
   }
+  for (uint16_t i = 0; i != n_hits; ++i) {
+    const PLTEventCache::Hit & C = CachedHits[i];
+    auto * Hit = fArena.NewHit(1, C.ROC, C.Column, C.Row, C.ADC);
+    Hit->SetCharge(C.Charge);
+    fHits.push_back(Hit);
+  }
+  {
+    tel::ScopedStage timer(tel::Stage::Align);
+    for (auto * Hit: fHits) { fAlignment.AlignHit(*Hit); }
+  }
+  for (auto * Hit: fHits) {
+    if (PLTPlane * Plane = PlaneOf(Hit->ROC())) { Plane->AddHit(Hit); }
+  }
+  ClusterizeAndTrack();
+
+  return 0;
+}
+
+
+void PSIFileReader::Clear()
+{
+  /** the hits, clusters and tracks belong to the arena and are recycled for the next event */
   fHits.clear();
-  fPlaneMap.clear();
-  fPlanes.clear();
+  for (auto & Plane: fPlaneArray) { Plane.Clear(); }
   fTracks.clear();
+  fArena.Reset();
 
   return;
 }
@@ -83,18 +165,29 @@ void PSIFileReader::Clear()
 
 void PSIFileReader::AddToPixelMask(int ch, int roc, int col, int row)
 {
-  fPixelMask.insert( ch*100000 + roc*10000 + col*100 + row );
+  fPixelMask.Add(ch, roc, col, row);
 }
 
 
 void PSIFileReader::ReadPixelMask (std::string const InFileName)
 {
+  /** masks which were already read are copied if the calibrations are kept */
+  static mutex Mutex;
+  static map<string, PLTPixelMask> Cache;
+  if (KeepCalibrations) {
+    lock_guard<mutex> Lock(Mutex);
+    auto const It = Cache.find(InFileName);
+    if (It != Cache.end()) {
+      fPixelMask = It->second;
+      return;
+    }
+  }
   std::cout << "PLTBinaryFileReader::ReadPixelMask reading file: " << InFileName << std::endl;
 
   std::ifstream InFile(InFileName.c_str());
   if (!InFile.is_open()) {
     std::cerr << "ERROR: cannot open PixelMask file: " << InFileName << std::endl;
-    throw;
+    throw std::runtime_error("cannot open PixelMask file: " + InFileName);
   }
 
   // Loop over header lines in the input data file
@@ -111,30 +204,28 @@ void PSIFileReader::ReadPixelMask (std::string const InFileName)
 
     if (line.find("col") != std::string::npos){
       linestream >> ch >> roc >> col;
-      for (uint8_t i_row = 0; i_row < PLTU::NROW; i_row++)
-        fPixelMask.insert(ch * 100000 + roc * 10000 + col * 100 + i_row);
+      fPixelMask.AddColumn(ch, roc, col);
     }
     else if (line.find("row") != std::string::npos){
       linestream >> ch >> roc >> row;
-      for (uint8_t i_col = 0; i_col < PLTU::NCOL; i_col++)
-        fPixelMask.insert(ch * 100000 + roc * 10000 + i_col * 100 + row);
+      fPixelMask.AddRow(ch, roc, row);
     }
     else {
       linestream >> ch >> roc >> col >> row;
-      fPixelMask.insert( ch*100000 + roc*10000 + col*100 + row );
+      fPixelMask.Add(ch, roc, col, row);
     }
   }
 
-  return;
+  if (KeepCalibrations) {
+    lock_guard<mutex> Lock(Mutex);
+    Cache[InFileName] = fPixelMask;
+  }
 }
 
 
 bool PSIFileReader::IsPixelMasked (int const ChannelPixel)
 {
-  if (fPixelMask.count(ChannelPixel)) {
-    return true;
-  }
-  return false;
+  return fPixelMask.IsMasked(ChannelPixel);
 }
 
 
@@ -4,6 +4,7 @@
 #include <fstream>
 #include <sstream>
 #include <cstdlib> 
+#include <stdexcept>
 
 #include "TString.h"
 #include "TH1F.h"
@@ -29,7 +30,7 @@ bool PSIGainInterpolator::ReadFile (std::string const InFileName, int const roc)
   std::ifstream f(InFileName.c_str());
   if (!f) {
     std::cerr << "ERROR; Cannot open file: " << InFileName << std::endl;
-    throw;
+    throw std::runtime_error("Cannot open file: " + InFileName);
   }
 
   // Clear previous values
@@ -173,7 +174,7 @@ float PSIGainInterpolator::GetCharge (int const ch, int const roc, int const col
 //      return 65. * GetInterpolation(ch, roc, col, row, adc);
     default:
       std::cerr << "ERROR: No fInterpoleratorAlgorithm selected" << std::endl;
-      throw;
+      throw std::logic_error("PSIGainInterpolator: no interpolation algorithm selected");
   }
 }
 
@@ -241,7 +242,7 @@ float PSIGainInterpolator::GetLinearInterpolation (int const ch, int const roc,
   }
   else {
     std::cerr << "ERROR: For some reason you have reached a strange state, or my logic has failed me" << std::endl;
-    throw;
+    throw std::logic_error("PSIGainInterpolator: unexpected state of the linear interpolation");
   }
 
 
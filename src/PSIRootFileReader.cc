@@ -1,17 +1,22 @@
 #include "PSIRootFileReader.h"
+#include "StageTimer.h"
+#include "Utils.h"
 
 #include <iostream>
 #include <string>
 #include <utility>
 #include <cstdint>
+#include <stdexcept>
+#include <bitset>
 
 using namespace std;
 
 PSIRootFileReader::PSIRootFileReader(string in_file_name, bool const only_align, bool track_only_telescope):
-  PSIFileReader(track_only_telescope), fFileName(move(in_file_name)), fOnlyAlign(only_align) {
+  PSIFileReader(track_only_telescope), fFileName(move(in_file_name)), fOnlyAlign(only_align),
+  fFirstEntry(0), fLastEntry(-1), fUsePrefilter(false), fPrefilterPlanes(-1), fPrefilterMaxMissing(0) {
     if (!OpenFile()) {
         std::cerr << "ERROR: cannot open input file: " << fFileName << std::endl;
-    throw;
+        throw runtime_error("cannot open input file: " + fFileName);
     }
 }
 
@@ -35,6 +40,7 @@ bool PSIRootFileReader::OpenFile ()
     if (!fRootFile->IsOpen()) { return false; }
 
     fTree = dynamic_cast<TTree*>(fRootFile->Get("tree"));
+    if (fTree == nullptr) { return false; }
     if(fRootFile->FindKey("region_information") != nullptr) {
         fMacro = dynamic_cast<TMacro *>(fRootFile->Get("region_information"));
     }
@@ -56,6 +62,19 @@ bool PSIRootFileReader::OpenFile ()
     fTree->SetBranchAddress("charge", f_charge);
     if (fTree->FindBranch(GetSignalBranchName() ))
         fTree->SetBranchAddress(GetSignalBranchName(), f_signal);
+
+    /** branches for the two-phase read: the hit planes first, the rest only for events which can be tracked */
+    fBranchNHits = fTree->GetBranch("n_hits_tot");
+    fBranchPlane = fTree->GetBranch("plane");
+    fEventBranches.clear();
+    for (auto name: {"event_number", "time", GetSignalBranchName()}) {
+        if (TBranch * branch = fTree->GetBranch(name)) { fEventBranches.push_back(branch); }
+    }
+    fHitBranches.clear();
+    for (auto name: {"col", "row", "adc", "charge"}) {
+        if (TBranch * branch = fTree->GetBranch(name)) { fHitBranches.push_back(branch); }
+    }
+    ApplyEntryRange();
     return true;
 }
 
@@ -74,6 +93,68 @@ void PSIRootFileReader::ResetFile ()
     OpenFile();
 }
 
+void PSIRootFileReader::GoToEntry (int entry)
+{
+    /** the signal of an event is taken from the branch buffers before reading the next entry, so load the previous one */
+    fAtEntry = entry;
+    if (entry > 0) { fTree->GetEntry(entry - 1); }
+}
+
+void PSIRootFileReader::SetPrefilter (bool use, int required_planes, uint16_t max_missing)
+{
+    fUsePrefilter = use;
+    fPrefilterPlanes = required_planes;
+    fPrefilterMaxMissing = max_missing;
+    if (use) {
+        tel::info(Form("Prefiltering events on the hit planes 0x%x with at most %u missing", unsigned(TrackingPlaneBits()), max_missing));
+    }
+}
+
+int PSIRootFileReader::TrackingPlaneBits ()
+{
+    if (fPrefilterPlanes >= 0) { return fPrefilterPlanes; }
+    /** same conditions as in ClusterizeAndTrack */
+    if (DoingSinglePlaneEfficiency()) {
+        int bits = 0;
+        for (int i = 0; i != fNPlanes; i++) {
+            if (IsPlaneRequired(unsigned(i))) { bits |= 1 << i; }
+        }
+        return bits;
+    }
+    switch (fTrackingAlgorithm) {
+        case kTrackingAlgorithm_ETH: return 0xf;  // falls through to all planes, so the first four are the weaker condition
+        case kTrackingAlgorithm_6PlanesHit: return (1 << fNPlanes) - 1;
+        default: return 0;
+    }
+}
+
+bool PSIRootFileReader::PassesPrefilter ()
+{
+    fBranchNHits->GetEntry(fAtEntry);
+    fBranchPlane->GetEntry(fAtEntry);
+    int const required = TrackingPlaneBits();
+    if (required == 0) { return true; }
+    int bits = 0;
+    for (uint16_t i = 0; i != min(f_n_hits, UShort_t(UINT8_MAX + 1)); i++) {
+        if (f_plane[i] < 32) { bits |= 1 << f_plane[i]; }
+    }
+    return std::bitset<32>(unsigned(required & ~bits)).count() <= size_t(fPrefilterMaxMissing);
+}
+
+void PSIRootFileReader::SetEntryRange (int first, int last)
+{
+    fFirstEntry = max(first, 0);
+    fLastEntry = last;
+    ApplyEntryRange();
+}
+
+void PSIRootFileReader::ApplyEntryRange ()
+{
+    fNEntries = int(fTree->GetEntries());
+    if (fLastEntry >= 0) { fNEntries = min(fNEntries, fLastEntry + 1); }
+    GoToEntry(min(fFirstEntry, fNEntries));
+}
+
 int PSIRootFileReader::GetNextEvent ()
 {
     Clear();
@@ -83,51 +164,94 @@ int PSIRootFileReader::GetNextEvent ()
         }
     }
 
-    for (int i = 0; i != fNPlanes; ++i) {
-        fPlaneMap.emplace(i, PLTPlane());
-        fPlaneMap[i].SetROC(i);
-    }
-
-    if (fAtEntry == fNEntries) {
+    if (fAtEntry >= fNEntries) {
         return -1;
     }
 
-    fTree->GetEntry(fAtEntry);
+    {
+        tel::ScopedStage timer(tel::Stage::Read);
+        if (not fUsePrefilter) {
+            fTree->GetEntry(fAtEntry);
+        } else {
+            /** the event number, time and signal are read for every event, the signal is added with the next event */
+            bool const passes = PassesPrefilter();
+            for (auto * branch: fEventBranches) { branch->GetEntry(fAtEntry); }
+            if (not passes) {
+                /** return an empty event to keep the entry numbers */
+                fAtEntry++;
+                return 0;
+            }
+            for (auto * branch: fHitBranches) { branch->GetEntry(fAtEntry); }
+        }
+    }
 
     fAtEntry++;
     if (f_n_hits > 255) { cout << endl<< "f_plane->size() = " << f_n_hits << endl; }
 
-    for (auto i_hit = 0; i_hit != f_n_hits; i_hit++){
-        uint8_t roc = f_plane[i_hit];
-        uint8_t col = f_col[i_hit];
-        uint8_t row = f_row[i_hit];
-        int16_t adc = f_adc[i_hit];
-
-        if (!IsPixelMasked( 1*100000 + roc*10000 + col*100 + row)){
-            auto * Hit = new PLTHit(1, roc, col, row, adc);
-
-            /** Gain calibration */
-            fGainCal.SetCharge(*Hit);
-            f_charge[i_hit] = Hit->Charge();  // overwrite empty charge values...
-
-            /** Alignment */
-            fAlignment.AlignHit(*Hit);
-            fHits.push_back(Hit);
-            fPlaneMap[Hit->ROC()].AddHit(Hit);
-            if ( fOnlyAlign ) {
-                for (uint8_t i = 0; i !=roc+1; i++) {
-                    if (fPlaneMap[i].NHits() == 0) return 0;
-                }
-            } // CHECKS THAT THERE WERE HITS IN THE PREVIOUS ROCS IF NOT RETURN 0
+    /** remove the masked pixels of the whole event before creating any hits */
+    uint16_t good_hits[UINT8_MAX + 1];
+    size_t n_good;
+    {
+        tel::ScopedStage timer(tel::Stage::Mask);
+        n_good = fPixelMask.Filter(1, f_plane, f_col, f_row, min(size_t(f_n_hits), size_t(UINT8_MAX + 1)), good_hits);
+    }
+    /** Gain calibration of the whole event before creating the hits */
+    {
+        tel::ScopedStage timer(tel::Stage::GainCal);
+        if (n_good == f_n_hits) {
+            fGainCal.GetCharges(n_good, f_plane, f_col, f_row, f_adc, f_charge);  // overwrite empty charge values...
+        } else {
+            uint8_t plane[UINT8_MAX + 1], col[UINT8_MAX + 1], row[UINT8_MAX + 1];
+            int16_t adc[UINT8_MAX + 1];
+            float charge[UINT8_MAX + 1];
+            for (size_t i_good = 0; i_good != n_good; i_good++){
+                uint16_t const i_hit = good_hits[i_good];
+                plane[i_good] = f_plane[i_hit]; col[i_good] = f_col[i_hit]; row[i_good] = f_row[i_hit]; adc[i_good] = f_adc[i_hit];
+            }
+            fGainCal.GetCharges(n_good, plane, col, row, adc, charge);
+            for (size_t i_good = 0; i_good != n_good; i_good++){ f_charge[good_hits[i_good]] = charge[i_good]; }
         }
     }
+    for (size_t i_good = 0; i_good != n_good; i_good++){
+        uint16_t const i_hit = good_hits[i_good];
+        fHits.push_back(fArena.NewHit(1, f_plane[i_hit], f_col[i_hit], f_row[i_hit], f_adc[i_hit]));
+        fHits.back()->SetCharge(f_charge[i_hit]);
+    }
 
-    /** Loop over all planes and clusterize each one, then add each plane to the correct telescope (by channel number) */
-    for (auto & it : fPlaneMap){
-        it.second.Clusterize(PLTPlane::kClustering_AllTouching, PLTPlane::kFiducialRegion_All);
-        AddPlane( &(it.second) );
+    /** Alignment */
+    {
+        tel::ScopedStage timer(tel::Stage::Align);
+        for (auto * Hit: fHits) { fAlignment.AlignHit(*Hit); }
     }
 
+    for (size_t i_good = 0; i_good != n_good; i_good++){
+        PLTHit * Hit = fHits[i_good];
+        if (PLTPlane * Plane = PlaneOf(Hit->ROC())) { Plane->AddHit(Hit); }
+        if ( fOnlyAlign ) {
+            for (uint8_t i = 0; i != Hit->ROC() + 1 and i != fNPlanes; i++) {
+                if (fPlaneArray[i].NHits() == 0) {
+                    fHits.resize(i_good + 1);
+                    return 0;
+                }
+            }
+        } // CHECKS THAT THERE WERE HITS IN THE PREVIOUS ROCS IF NOT RETURN 0
+    }
+
+    ClusterizeAndTrack();
+    return 0;
+}
+
+void PSIRootFileReader::ClusterizeAndTrack()
+{
+    /** Loop over all planes and clusterize each one (the planes are already part of the telescope) */
+    {
+        tel::ScopedStage timer(tel::Stage::Clusterize);
+        for (auto & Plane : fPlaneArray){
+            Plane.Clusterize(PLTPlane::kClustering_AllTouching, PLTPlane::kFiducialRegion_All);
+        }
+    }
+    tel::ScopedStage timer(tel::Stage::Tracking);
+
     /** If we are doing single plane-efficiencies:
         Just send all events to the tracking and sort it out there */
     if (DoingSinglePlaneEfficiency()) { // TRUE FOR 1ST LOOP ALIGNMENT
@@ -158,6 +282,4 @@ int PSIRootFileReader::GetNextEvent ()
             case kTrackingAlgorithm_2PlaneTracks_All:break;
         }
     }
-    return 0;
-
-}
\ No newline at end of file
+}
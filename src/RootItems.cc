@@ -1,4 +1,7 @@
 #include "RootItems.h"
+#include "Utils.h"
+
+#include <stdexcept>
 
 using namespace std;
 
@@ -69,6 +72,48 @@ RootItems::RootItems(TString const RunNumber) :
     hSignalDistribution = FillSignalDisto();
 
 
+}
+RootItems::RootItems(const RootItems & main, uint16_t const shard) :
+    nRoc(main.nRoc),
+    nSig(main.nSig),
+    PlotsDir(main.PlotsDir),
+    OutDir(main.OutDir),
+    FileType(main.FileType),
+    HistColors {1, 4, 28, 2 },
+    maxChi2(main.maxChi2),
+    c1(nullptr), c2(nullptr), fGauss(nullptr), lFitGauss(nullptr), lPulseHeight(nullptr), lPHMean(nullptr), lRatio(nullptr) {
+
+    /** the shards are merged into the main items and never written, so keep them out of the current directory */
+    bool const add_directory = TH1::AddDirectoryStatus();
+    TH1::AddDirectory(false);
+
+    hTrackSlopeX = CloneVector<TH1F>({main.hTrackSlopeX}, shard).at(0);
+    hTrackSlopeY = CloneVector<TH1F>({main.hTrackSlopeY}, shard).at(0);
+    hOccupancy = CloneVector(main.hOccupancy, shard);
+    hOccupancy1DZ.resize(nRoc);
+    h3x3.resize(nRoc);
+    h3x31DZ.resize(nRoc);
+    hOccupancyLowPH = CloneVector(main.hOccupancyLowPH, shard);
+    hOccupancyHighPH = CloneVector(main.hOccupancyHighPH, shard);
+    hNHitsPerCluster = CloneVector(main.hNHitsPerCluster, shard);
+    hNClusters = CloneVector(main.hNClusters, shard);
+    for (uint16_t iRoc = 0; iRoc != nRoc; iRoc++) {
+        hPulseHeight.push_back(CloneVector(main.hPulseHeight.at(iRoc), shard));
+        hPulseHeightLong.push_back(CloneVector(main.hPulseHeightLong.at(iRoc), shard));
+        hPulseHeightOffline.push_back(CloneVector(main.hPulseHeightOffline.at(iRoc), shard));
+    }
+    AllocateArrAvPH();
+    gAvgPH = FillVecAvPH(gAvgPH);
+    hCoincidenceMap = CloneVector<TH1F>({main.hCoincidenceMap}, shard).at(0);
+    hChi2 = CloneVector<TH1F>({main.hChi2}, shard).at(0);
+    hChi2X = CloneVector<TH1F>({main.hChi2X}, shard).at(0);
+    hChi2Y = CloneVector<TH1F>({main.hChi2Y}, shard).at(0);
+    hResidual = CloneVector(main.hResidual, shard);
+    hResidualXdY = CloneVector(main.hResidualXdY, shard);
+    hResidualYdX = CloneVector(main.hResidualYdX, shard);
+    hSignalDistribution = CloneVector(main.hSignalDistribution, shard);
+
+    TH1::AddDirectory(add_directory);
 }
 RootItems::~RootItems() {
 
@@ -158,9 +203,115 @@ RootItems::~RootItems() {
  }
 
 
+void RootItems::Merge(const RootItems & shard){
+    /** add the histograms and combine the running averages of a shard, call for the shards in a fixed order */
+    vector<TH1*> histos = MergeableHistos(), shard_histos = shard.MergeableHistos();
+    for (size_t i = 0; i != histos.size(); i++) { histos[i]->Add(shard_histos[i]); }
+    for (uint16_t iRoc = 0; iRoc != nRoc; iRoc++)
+        for (uint8_t iCol = 0; iCol != PLTU::NCOL; ++iCol)
+            for (uint8_t iRow = 0; iRow != PLTU::NROW; ++iRow)
+                AddAveragePH2D(iRoc, iCol, iRow, shard.dAvgPH2D[iRoc][iCol][iRow], shard.nAvgPH2D[iRoc][iCol][iRow]);
+}
+void RootItems::MergeAveragePH(const RootItems & shard, uint16_t first_point, uint16_t n_points){
+    CopyAveragePH(shard.gAvgPH, first_point, n_points);
+}
+void RootItems::WriteShard(TFile * file, uint16_t first_point, uint16_t n_points){
+    /** the histograms keep their names, the pixel averages are stored as mean and entries and the graphs with their range of points */
+    file->cd();
+    for (auto * h: MergeableHistos()) { h->Write(); }
+    for (uint16_t iRoc = 0; iRoc != nRoc; iRoc++) {
+        TH2D mean(Form("AvgPH2DMean_ROC%i", iRoc), "", PLTU::NCOL, 0, PLTU::NCOL, PLTU::NROW, 0, PLTU::NROW);
+        TH2D entries(Form("AvgPH2DEntries_ROC%i", iRoc), "", PLTU::NCOL, 0, PLTU::NCOL, PLTU::NROW, 0, PLTU::NROW);
+        mean.SetDirectory(nullptr);
+        entries.SetDirectory(nullptr);
+        for (uint8_t iCol = 0; iCol != PLTU::NCOL; ++iCol) {
+            for (uint8_t iRow = 0; iRow != PLTU::NROW; ++iRow) {
+                mean.SetBinContent(iCol + 1, iRow + 1, dAvgPH2D[iRoc][iCol][iRow]);
+                entries.SetBinContent(iCol + 1, iRow + 1, nAvgPH2D[iRoc][iCol][iRow]);
+            }
+        }
+        mean.Write();
+        entries.Write();
+        for (uint16_t iMode = 0; iMode != 4; iMode++) { gAvgPH[iRoc][iMode]->Write(); }
+    }
+    TParameter<int>("FirstGraphPoint", first_point).Write();
+    TParameter<int>("NGraphPoints", n_points).Write();
+}
+template <typename T>
+T * RootItems::GetShardItem(TFile * file, const string & name){
+    /** @returns: the item of a shard file, throws if it is missing or of another type (truncated or foreign file) */
+    auto * item = dynamic_cast<T*>(file->Get(name.c_str()));
+    if (item == nullptr) {
+        string const msg = Form("Cannot find %s in the shard file %s", name.c_str(), file->GetName());
+        tel::critical(msg);
+        throw runtime_error(msg);
+    }
+    return item;
+}
+
+void RootItems::AddShard(TFile * file){
+    /** add the items of a shard file written by WriteShard */
+    for (auto * h: MergeableHistos()) { h->Add(GetShardItem<TH1>(file, h->GetName())); }
+    vector<vector<TGraphErrors*> > graphs(nRoc);
+    for (uint16_t iRoc = 0; iRoc != nRoc; iRoc++) {
+        auto * mean = GetShardItem<TH2D>(file, Form("AvgPH2DMean_ROC%i", iRoc));
+        auto * entries = GetShardItem<TH2D>(file, Form("AvgPH2DEntries_ROC%i", iRoc));
+        for (uint8_t iCol = 0; iCol != PLTU::NCOL; ++iCol)
+            for (uint8_t iRow = 0; iRow != PLTU::NROW; ++iRow)
+                AddAveragePH2D(iRoc, iCol, iRow, mean->GetBinContent(iCol + 1, iRow + 1), int(entries->GetBinContent(iCol + 1, iRow + 1)));
+        for (uint16_t iMode = 0; iMode != 4; iMode++) { graphs[iRoc].push_back(GetShardItem<TGraphErrors>(file, gAvgPH[iRoc][iMode]->GetName())); }
+    }
+    auto * first_point = GetShardItem<TParameter<int> >(file, "FirstGraphPoint");
+    auto * n_points = GetShardItem<TParameter<int> >(file, "NGraphPoints");
+    CopyAveragePH(graphs, uint16_t(first_point->GetVal()), uint16_t(n_points->GetVal()));
+}
+
+
 /** ============================
  AUXILIARY FUNCTIONS
  =================================*/
+template <typename T>
+vector<T*> RootItems::CloneVector(const vector<T*> & histos, uint16_t shard){
+    vector<T*> tmp;
+    for (auto * h: histos) {
+        auto * clone = (T*) h->Clone(Form("%s_shard%i", h->GetName(), shard));
+        clone->SetDirectory(nullptr);
+        clone->Reset();
+        tmp.push_back(clone);
+    }
+    return tmp;
+}
+vector<TH1*> RootItems::MergeableHistos() const {
+    /** all histograms filled in the event loop, in a fixed order */
+    vector<TH1*> tmp;
+    for (auto * vec: {&hOccupancy, &hOccupancyLowPH, &hOccupancyHighPH}) { tmp.insert(tmp.end(), vec->begin(), vec->end()); }
+    for (auto * vec: {&hNHitsPerCluster, &hNClusters}) { tmp.insert(tmp.end(), vec->begin(), vec->end()); }
+    for (uint16_t iRoc = 0; iRoc != nRoc; iRoc++)
+        for (auto * vec: {&hPulseHeight[iRoc], &hPulseHeightLong[iRoc], &hPulseHeightOffline[iRoc]}) { tmp.insert(tmp.end(), vec->begin(), vec->end()); }
+    tmp.insert(tmp.end(), {hCoincidenceMap, hChi2, hChi2X, hChi2Y, hTrackSlopeX, hTrackSlopeY});
+    for (auto * vec: {&hResidual, &hResidualXdY, &hResidualYdX}) { tmp.insert(tmp.end(), vec->begin(), vec->end()); }
+    tmp.insert(tmp.end(), hSignalDistribution.begin(), hSignalDistribution.end());
+    return tmp;
+}
+void RootItems::AddAveragePH2D(uint16_t iRoc, uint16_t iCol, uint16_t iRow, double mean, int n){
+    int const n_old = nAvgPH2D[iRoc][iCol][iRow];
+    if (n == 0) return;
+    dAvgPH2D[iRoc][iCol][iRow] = (dAvgPH2D[iRoc][iCol][iRow] * n_old + mean * n) / (n_old + n);
+    nAvgPH2D[iRoc][iCol][iRow] = n_old + n;
+}
+void RootItems::CopyAveragePH(const vector<vector<TGraphErrors*> > & graphs, uint16_t first_point, uint16_t n_points){
+    /** copy the time slices [first_point, n_points) of the average pulse height graphs of a shard */
+    for (uint16_t iRoc = 0; iRoc != nRoc; iRoc++) {
+        for (uint16_t iMode = 0; iMode != 4; iMode++) {
+            TGraphErrors * g = gAvgPH[iRoc][iMode], * g_shard = graphs[iRoc][iMode];
+            g->Set(n_points);
+            for (uint16_t i = first_point; i < n_points; i++) {
+                g->SetPoint(i, g_shard->GetX()[i], g_shard->GetY()[i]);
+                g->SetPointError(i, g_shard->GetEX()[i], g_shard->GetEY()[i]);
+            }
+        }
+    }
+}
 void RootItems::FitSlope(TH1F * histo){
 
     fGauss->SetLineWidth(2);
@@ -358,9 +509,9 @@ void RootItems::AllocateArrAvPH(){
     dAvgPH = new double*[nRoc]; nAvgPH = new int*[nRoc];
     for (uint8_t iRoc = 0; iRoc < nRoc; iRoc++){
         dAvgPH2D[iRoc] = new double*[PLTU::NCOL]; nAvgPH2D[iRoc] = new int*[PLTU::NCOL];
-        dAvgPH[iRoc] = new double[4]; nAvgPH[iRoc] = new int[4];
+        dAvgPH[iRoc] = new double[4](); nAvgPH[iRoc] = new int[4]();
         for (uint8_t iCol = 0; iCol < PLTU::NCOL; iCol++){
-            dAvgPH2D[iRoc][iCol] = new double[PLTU::NROW]; nAvgPH2D[iRoc][iCol] = new int[PLTU::NROW];
+            dAvgPH2D[iRoc][iCol] = new double[PLTU::NROW](); nAvgPH2D[iRoc][iCol] = new int[PLTU::NROW]();
         }
     }
 }
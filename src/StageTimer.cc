@@ -0,0 +1,118 @@
+#include "StageTimer.h"
+#include "Utils.h"
+
+#include <mutex>
+#include <set>
+#include <fstream>
+#include <iomanip>
+
+using namespace std;
+
+namespace tel {
+
+  namespace {
+    /** live accumulators of all threads and the sums of the threads which have already finished */
+    struct Registry {
+      mutex mutex_;
+      set<StageTimer*> timers_;
+      uint64_t ns_[StageTimer::NStages] = {};
+      uint64_t calls_[StageTimer::NStages] = {};
+    };
+    Registry & registry() {
+      static Registry r;
+      return r;
+    }
+  }
+
+  const char * stage_name(Stage stage) {
+    static const char * names[StageTimer::NStages] = {"read", "mask", "gain_cal", "align", "clusterize", "tracking", "histo_fill", "write_tree"};
+    return names[size_t(stage)];
+  }
+
+  double wall_time() {
+    return chrono::duration<double>(StageTimer::Clock::now().time_since_epoch()).count();
+  }
+
+  StageTimer::StageTimer(): ns_(), calls_() {
+    lock_guard<mutex> lock(registry().mutex_);
+    registry().timers_.insert(this);
+  }
+
+  StageTimer::~StageTimer() {
+    Registry & r = registry();
+    lock_guard<mutex> lock(r.mutex_);
+    for (size_t i = 0; i != NStages; ++i) {
+      r.ns_[i] += ns_[i];
+      r.calls_[i] += calls_[i];
+    }
+    r.timers_.erase(this);
+  }
+
+  StageTimer & StageTimer::local() {
+    static thread_local StageTimer timer;
+    return timer;
+  }
+
+  void StageTimer::collect(uint64_t * ns, uint64_t * calls) {
+    Registry & r = registry();
+    lock_guard<mutex> lock(r.mutex_);
+    for (size_t i = 0; i != NStages; ++i) {
+      ns[i] = r.ns_[i];
+      calls[i] = r.calls_[i];
+      for (auto * timer: r.timers_) {
+        ns[i] += timer->ns_[i];
+        calls[i] += timer->calls_[i];
+      }
+    }
+  }
+
+  void StageTimer::reset() {
+    Registry & r = registry();
+    lock_guard<mutex> lock(r.mutex_);
+    for (size_t i = 0; i != NStages; ++i) {
+      r.ns_[i] = r.calls_[i] = 0;
+      for (auto * timer: r.timers_) { timer->ns_[i] = timer->calls_[i] = 0; }
+    }
+  }
+
+  void StageTimer::print(const string & action, double wall) {
+    /** the times are summed over all threads, so the events/s of a stage are the rate of a single thread */
+    uint64_t ns[NStages], calls[NStages];
+    collect(ns, calls);
+    ostringstream s;
+    s << "Timing of " << action << " (wall time " << fixed << setprecision(2) << wall << " s)\n";
+    s << left << setw(12) << "Stage" << right << setw(12) << "Calls" << setw(12) << "Time [s]" << setw(10) << "Share" << setw(14) << "Events/s" << "\n";
+    for (size_t i = 0; i != NStages; ++i) {
+      if (calls[i] == 0) { continue; }
+      double const seconds = ns[i] * 1e-9;
+      s << left << setw(12) << stage_name(Stage(i)) << right << setw(12) << calls[i] << setw(12) << setprecision(3) << seconds
+        << setw(9) << setprecision(1) << (wall > 0 ? 100 * seconds / wall : 0.) << "%"
+        << setw(14) << setprecision(0) << (seconds > 0 ? calls[i] / seconds : 0.) << "\n";
+    }
+    if (calls[size_t(Stage::Read)] and wall > 0) {
+      s << left << setw(12) << "total" << right << setw(12) << calls[size_t(Stage::Read)] << setw(12) << setprecision(3) << wall
+        << setw(10) << "" << setw(14) << setprecision(0) << calls[size_t(Stage::Read)] / wall << "\n";
+    }
+    print_banner(s.str(), '=');
+  }
+
+  void StageTimer::writeJSON(const string & file_name, const string & action, double wall) {
+    uint64_t ns[NStages], calls[NStages];
+    collect(ns, calls);
+    ofstream f(file_name);
+    if (not f.is_open()) {
+      warning("cannot write the timing to " + file_name);
+      return;
+    }
+    f << setprecision(9);
+    f << "{\n  \"action\": \"" << action << "\",\n  \"wall_time_s\": " << wall << ",\n";
+    f << "  \"events\": " << calls[size_t(Stage::Read)] << ",\n  \"stages\": [\n";
+    for (size_t i = 0; i != NStages; ++i) {
+      double const seconds = ns[i] * 1e-9;
+      f << "    {\"stage\": \"" << stage_name(Stage(i)) << "\", \"calls\": " << calls[i] << ", \"time_s\": " << seconds
+        << ", \"events_per_s\": " << (seconds > 0 ? calls[i] / seconds : 0.) << "}" << (i + 1 != NStages ? "," : "") << "\n";
+    }
+    f << "  ]\n}\n";
+    info("Wrote the timing to " + file_name);
+  }
+}
@@ -28,7 +28,9 @@
 #include "PSIRootFileReader.h"
 #include "DoAlignment.h"
 #include "FindPlaneErrors.h"
+#include "PLTEventGenerator.h"
 #include "Utils.h"
+#include "StageTimer.h"
 #include "GetNames.h"
 
 #define DEBUG false
@@ -511,8 +513,9 @@ void TestPlaneEfficiency (std::string const InFileName,
       double tx = FR->Track(0)->TX( tz );
       double ty = FR->Track(0)->TY( tz );
 
-      double lx = FR->GetAlignment()->TtoLX( tx, ty, 1, plane_under_test);
-      double ly = FR->GetAlignment()->TtoLY( tx, ty, 1, plane_under_test);
+      pair<float, float> const lxy = FR->GetAlignment()->TtoLXY(tx, ty, 1, plane_under_test);
+      double lx = lxy.first;
+      double ly = lxy.second;
 
       int px = FR->GetAlignment()->PXfromLX( lx );
       int py = FR->GetAlignment()->PYfromLY( ly );
@@ -726,13 +729,13 @@ void TestPlaneEfficiency (std::string const InFileName,
 
 
   // Remove masked areas from Occupancy Histograms
-  const std::set<int> * pixelMask = FR->GetPixelMask();
+  const std::vector<int> pixelMask = FR->GetPixelMask()->GetMaskedPixels();
 
-  std::cout << "Got PixelMask: "<<pixelMask->size() <<std::endl;
+  std::cout << "Got PixelMask: "<<pixelMask.size() <<std::endl;
 
   // Loop over all masked pixels
-  for (std::set<int>::const_iterator ipix = pixelMask->begin();
-       ipix != pixelMask->end();
+  for (std::vector<int>::const_iterator ipix = pixelMask.begin();
+       ipix != pixelMask.end();
        ipix++){
 
          // Decode the integer
@@ -1319,45 +1322,111 @@ void WriteHTML(TString const & OutDir, int telescopeID)
 void PrintUsage(const string & name) {
   cerr << "Usage: " << name << " <InFileName> <action> <telescopeID> ";
   cerr << "optional arguments: (<TrackMode>=0) (<EventsAlignment>=100000) (<IterAlignStep>=20) (<MaxAlignRes(cm)>=0.00001) (<MaxAlignAngle(rad)>=0.001) (<SilDUT>=-1)" << endl;
-  cerr << "action:\n  0: analysis\n  1: alignment\n  2: residuals" << endl;
+  cerr << "action:\n  0: analysis\n  1: alignment\n  2: residuals\n  3: simulation (writes the events to <InFileName>)" << endl;
   cerr << "TrackMode:\n  0: AllPlanes\n  1: OnlyTelescope" << endl;
   cerr << "EventsAlignment:\n  0: Use ALL events in file\n  <n>: Use only the first \"n\" events in the provided file." << endl;
   cerr << "SilDUT:\n  -1: No Silicon DUT, only diamonds\n  <i>: Roc position \"i\" where the Silicon DUT is" << endl;
+  cerr << "options:\n  --threads <n>: number of threads for the analysis event loop (default 1, ROOT input only)" << endl;
+  cerr << "  --align-plots <0|1>: save the residual plots of every alignment iteration (default 0)" << endl;
+  cerr << "  --global-align <0|1>: align all planes at once with a global least squares fit (default 0)" << endl;
+  cerr << "  --road-search <0|1>: combine only the clusters in a road around seeds of the outer planes instead of all combinations;" << endl;
+  cerr << "                       faster for busy events but approximate, it can change which tracks survive (default 0)" << endl;
+  cerr << "  --timing-json <file>: write the wall time and events/s of every stage of the event loop to a JSON file" << endl;
+  cerr << "  --run-list <file>: analyse all runs of the file instead of <InFileName> (lines: <InFileName> <telescopeID> (<TrackMode>=0))" << endl;
+  cerr << "  --workers <n>: number of runs of the run list which are analysed in parallel (default 1)" << endl;
+  cerr << "  --first-entry <n>: first entry of the run to analyse (default 0, ROOT input only)" << endl;
+  cerr << "  --last-entry <n>: last entry of the run to analyse (default: the last entry of the file)" << endl;
+  cerr << "  --shard <i>/<n>: analyse only the part i of the run split into n parts, writes separate histogram and track files" << endl;
+  cerr << "  --merge-shards <n>: add up the histograms and tracks of the n parts analysed with --shard and draw them" << endl;
+  cerr << "  --sim-events <n>: number of simulated events (default 100000)" << endl;
+  cerr << "  --sim-tracks <mean>: mean number of tracks per simulated event (default 1)" << endl;
+  cerr << "  --sim-noise <mean>: mean number of noise hits per plane and simulated event (default 0.05)" << endl;
+  cerr << "  --sim-momentum <GeV/c>: beam momentum for the multiple scattering (default 0.26)" << endl;
+  cerr << "  --sim-seed <n>: random seed of the simulation (default 1)" << endl;
+  cerr << "  --sim-calibration <dir>: directory with the ROC<i>.txt calibration files (default: the telescope's)" << endl;
 }
 
 
 int main (int argc, char* argv[]) {
 
+  vector<string> args(argv, argv + argc);
+  /** number of threads for the analysis event loop */
+  auto n_threads = uint16_t(stoi(tel::pop_option(args, "--threads", "1")));
+  /** fill and save the residual histograms of every alignment iteration */
+  auto align_plots = bool(stoi(tel::pop_option(args, "--align-plots", "0")));
+  /** align all planes at once with the global least squares fit */
+  auto global_align = bool(stoi(tel::pop_option(args, "--global-align", "0")));
+  /** approximate road search instead of all cluster combinations, see PLTTracking::MakeTrackCandidates */
+  PLTTracking::UseRoadSearch = bool(stoi(tel::pop_option(args, "--road-search", "0")));
+  /** write the per-stage timing table as JSON */
+  auto timing_json = tel::pop_option(args, "--timing-json", "");
+  /** analyse a list of runs, the runs of a telescope reuse the calibration and alignment */
+  auto run_list = tel::pop_option(args, "--run-list", "");
+  auto n_workers = uint16_t(stoi(tel::pop_option(args, "--workers", "1")));
+  /** analyse only a range of entries */
+  auto first_entry = uint32_t(stoul(tel::pop_option(args, "--first-entry", "0")));
+  auto last_entry = int64_t(stoll(tel::pop_option(args, "--last-entry", "-1")));
+  /** split the analysis of a run over several processes and merge their outputs */
+  auto shard = tel::split(tel::pop_option(args, "--shard", "-1/1"), '/');
+  auto merge_shards = uint16_t(stoi(tel::pop_option(args, "--merge-shards", "0")));
+  if (shard.size() != 2) {
+    tel::critical("The shard must be given as <i>/<n>");
+    return 1;
+  }
+  auto process_shard = int16_t(stoi(shard[0]));
+  auto n_process_shards = uint16_t(stoi(shard[1]));
+  /** settings of the simulation */
+  PLTEventGenerator::Settings sim;
+  sim.NEvents = uint32_t(stoul(tel::pop_option(args, "--sim-events", to_string(sim.NEvents))));
+  sim.TracksPerEvent = stof(tel::pop_option(args, "--sim-tracks", to_string(sim.TracksPerEvent)));
+  sim.NoiseHitsPerPlane = stof(tel::pop_option(args, "--sim-noise", to_string(sim.NoiseHitsPerPlane)));
+  sim.Momentum = stof(tel::pop_option(args, "--sim-momentum", to_string(sim.Momentum)));
+  sim.Seed = uint32_t(stoul(tel::pop_option(args, "--sim-seed", to_string(sim.Seed))));
+  sim.CalibrationPath = tel::pop_option(args, "--sim-calibration", "");
+
   const uint16_t max_args = 11;
-  if (argc <= 3 or argc >= max_args) {
+  if (run_list.empty() and (args.size() <= 3 or args.size() >= max_args)) {
     tel::critical("Wrong arguments; Must supply at least 3 arguments and no more than 9: ");
-    PrintUsage(argv[0]);
+    PrintUsage(args[0]);
     return 1;
   }
   gInterpreter->GenerateDictionary("vector<vector<float> >;vector<vector<UShort_t> >", "vector"); // add root dicts for vector<vector> >
   gROOT->ProcessLine("#include <vector>");
 
-  /** There three usage modes: analysis, alignment and residuals
+  if (not run_list.empty()) { /** BATCH ANALYSIS */
+    tel::StageTimer::reset();
+    double const start_time = tel::wall_time();
+    int const n_failed = AnalyseRunList(run_list, n_workers, n_threads);
+    double const wall = tel::wall_time() - start_time;
+    tel::StageTimer::print("Run list", wall);
+    if (not timing_json.empty()) { tel::StageTimer::writeJSON(timing_json, "Run list", wall); }
+    if (n_failed > 0) { tel::warning(Form("%i runs could not be analysed", n_failed)); }
+    return n_failed > 0 ? 3 : 0;
+  }
+
+  /** There are four usage modes: analysis, alignment, residuals and simulation
       analysis: uses alignment and residuals for the given telescope to perform global and single plane studies
       alignment: starts with all alignment constants zero and does several iterations to minimize the residuals. All planes are shifted in x and y and rotated
         around the z-axis. Residual plots of the last iteration are saved.
       residuals: tries to find the correct residuals for tracking
+      simulation: writes simulated events of the telescope geometry to <InFileName>
       action:
         0: Analysis
         1: Alignment
-        2: Residuals */
-  auto action = stoi(argv[2]);
-  auto telescope_id = stoi(argv[3]); /** see data/alignments.txt file */
+        2: Residuals
+        3: Simulation */
+  auto action = stoi(args[2]);
+  auto telescope_id = stoi(args[3]); /** see data/alignments.txt file */
   /** Tracking only on the telescope (only for digital telescope):
       0: Use All planes (default until September 2016.
       1: Use only the first 4 planes for tracking (telescope planes) */
-  auto track_only_telescope = argc >= 5 and bool(stoi(argv[4]));
+  auto track_only_telescope = args.size() >= 5 and bool(stoi(args[4]));
 
   if (action > 3) {
     tel::critical("Wrong action argument: " + to_string(action));
     return 2;
   }
-  vector<string> action_str = {" (Analysis)", " (Alignment)", " (Residuals)"};
+  vector<string> action_str = {" (Analysis)", " (Alignment)", " (Residuals)", " (Simulation)"};
   cout << "Action = " << int(action) << action_str.at(action) << endl;
   cout << "TelescopeID = " << int(telescope_id) << endl;
   cout << "Track only analogue telescope: " << track_only_telescope << endl << endl;
@@ -1365,26 +1434,43 @@ int main (int argc, char* argv[]) {
   /** read config */
   if (tel::Config::Read(telescope_id) == 0) { return 3; }
 
-  /** optional settings */
-  AlignSettings AS = ReadAlignSettings(vector<string>(argv, argv + argc), action_str.size());
+  if (action == 3) { /** SIMULATION */
+    PLTEventGenerator(sim).Generate(args[1]);
+    return 0;
+  }
+
+  /** optional settings, they start after <TrackMode> */
+  AlignSettings AS = ReadAlignSettings(args, 3);
 
-  const string in_file_name = argv[1];
-  const string run_number = tel::trim(tel::trim(tel::split(in_file_name, '/').back(), "estro0"), ".");
+  const string in_file_name = args[1];
+  const string run_number = GetRunNumber(in_file_name);
 
   ValidateDirectories(run_number);
 
-  /** Open a ROOT file to store histograms in. */
-  TFile out_f(Form("%s/plots/%s/histos.root", GetDir().c_str(), run_number.c_str()), "recreate");
+  /** Open a ROOT file to store histograms in, the shards of a split run write their own files */
+  Action::SetEntryRange(first_entry, last_entry);
+  string const histo_file_name = process_shard >= 0 ? PLTAnalysis::ShardFileName(run_number, process_shard) : Form("%s/plots/%s/histos.root", GetDir().c_str(), run_number.c_str());
+  TFile out_f(histo_file_name.c_str(), "recreate");
 
+  tel::StageTimer::reset();
+  double const start_time = tel::wall_time();
   if (action == 1) { /** ALIGNMENT */
-    Alignment(in_file_name, run_number, telescope_id, track_only_telescope, AS.n_iterations_, AS.res_thresh_, AS.angle_thresh_, AS.max_events_, AS.sil_roc_);
+    Alignment(in_file_name, run_number, telescope_id, track_only_telescope, AS.n_iterations_, AS.res_thresh_, AS.angle_thresh_, AS.max_events_, AS.sil_roc_, align_plots, global_align);
   } else if (action==2) { /** RESIDUAL CALCULATION */
     FindPlaneErrors(in_file_name, run_number, telescope_id);
+  } else if (merge_shards > 0) { /** MERGE THE SHARDS OF A SPLIT ANALYSIS */
+    PLTAnalysis::MergeShards(in_file_name, &out_f, run_number, telescope_id, merge_shards);
   } else { /** ANALYSIS */
-    PLTAnalysis Analysis(in_file_name, &out_f, run_number, telescope_id, bool(track_only_telescope));
+    PLTAnalysis Analysis(in_file_name, &out_f, run_number, telescope_id, bool(track_only_telescope), 0, n_threads, process_shard, n_process_shards);
     Analysis.EventLoop();
     Analysis.FinishAnalysis();
   }
 
+  /** per-stage throughput of the action */
+  double const wall = tel::wall_time() - start_time;
+  string const action_name = tel::trim(action_str.at(action), " ()");
+  tel::StageTimer::print(action_name, wall);
+  if (not timing_json.empty()) { tel::StageTimer::writeJSON(timing_json, action_name, wall); }
+
   return 0;
 }
@@ -0,0 +1,589 @@
+////////////////////////////////////////////////////////////////////
+//
+// Microbenchmarks of the hot kernels of the event loop. The events are simulated straight tracks through the
+// telescope of the given configuration, using its alignment and calibration files.
+//
+////////////////////////////////////////////////////////////////////
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <functional>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <chrono>
+
+#include "TRandom3.h"
+#include "TSystem.h"
+#include "TROOT.h"
+#include "TFile.h"
+#include "TTree.h"
+
+#include "PLTGainCal.h"
+#include "PSIGainInterpolator.h"
+#include "PLTAlignment.h"
+#include "PLTTelescope.h"
+#include "PLTTracking.h"
+#include "PLTEventArena.h"
+#include "PSIRootFileReader.h"
+#include "FileWriterTracking.h"
+#include "Utils.h"
+#include "GetNames.h"
+
+using namespace std;
+
+/** ============================
+ ALLOCATION COUNTER
+ =================================*/
+namespace {
+  atomic<uint64_t> NAllocations(0);
+}
+
+void * operator new (size_t size)
+{
+  NAllocations.fetch_add(1, memory_order_relaxed);
+  if (void * p = malloc(size != 0 ? size : 1)) { return p; }
+  throw bad_alloc();
+}
+void operator delete (void * p) noexcept { free(p); }
+void operator delete (void * p, size_t) noexcept { free(p); }
+
+
+namespace {
+
+/** ============================
+ SYNTHETIC EVENTS
+ =================================*/
+struct BenchHit {
+  uint8_t ROC, Column, Row;
+  int16_t ADC;
+};
+using BenchEvent = vector<BenchHit>;
+
+vector<BenchEvent> MakeEvents (size_t NEvents, PLTAlignment & Alignment, uint16_t NPlanes)
+{
+  /** straight tracks with a small divergence, mostly one but sometimes two per event, one to three pixels per cluster
+   *  and a few noise hits per plane. The pulse heights follow a Landau distribution inside the adc range of the ROCs. */
+  TRandom3 Random(42);
+  auto ADC = [&Random] { return int16_t(max(-95., min(135., Random.Landau(-20, 15)))); };
+  vector<BenchEvent> Events(NEvents);
+  for (auto & Event: Events) {
+    int const NTracks = Random.Uniform() < .9 ? 1 : 2;
+    for (int itrack = 0; itrack != NTracks; ++itrack) {
+      float const X = float(Random.Uniform(-.25, .25)), Y = float(Random.Uniform(-.25, .25));
+      float const SlopeX = float(Random.Gaus(0, 5e-4)), SlopeY = float(Random.Gaus(0, 5e-4));
+      for (uint16_t iroc = 0; iroc != NPlanes; ++iroc) {
+        float const Z = Alignment.LZ(1, iroc);
+        pair<float, float> const LXY = Alignment.TtoLXY(X + SlopeX * Z, Y + SlopeY * Z, 1, iroc);
+        int const Col = PLTAlignment::PXfromLX(LXY.first), Row = PLTAlignment::PYfromLY(LXY.second);
+        if (Col < 1 or Col >= PLTU::NCOL - 1 or Row < 1 or Row >= PLTU::NROW - 1) { continue; }
+        Event.push_back({uint8_t(iroc), uint8_t(Col), uint8_t(Row), ADC()});
+        if (Random.Uniform() < .5) { Event.push_back({uint8_t(iroc), uint8_t(Col + 1), uint8_t(Row), ADC()}); }
+        if (Random.Uniform() < .3) { Event.push_back({uint8_t(iroc), uint8_t(Col), uint8_t(Row + 1), ADC()}); }
+      }
+    }
+    for (uint16_t iroc = 0; iroc != NPlanes; ++iroc) {
+      for (int inoise = Random.Poisson(.3); inoise > 0; --inoise) {
+        Event.push_back({uint8_t(iroc), uint8_t(Random.Integer(PLTU::NCOL)), uint8_t(Random.Integer(PLTU::NROW)), ADC()});
+      }
+    }
+  }
+  return Events;
+}
+
+string WriteParametricGainCal (uint16_t NPlanes)
+{
+  /** the old second order polynomial + exponential calibration (5 parameters) with small pixel to pixel variations */
+  string const FileName = Form("/tmp/TrackingTelescopeBench_GainCal5_%i.txt", gSystem->GetPid());
+  ofstream f(FileName);
+  TRandom3 Random(7);
+  f << "8 1 5 1\n\n";
+  for (int i = -1; i != NPlanes * PLTU::NCOL * PLTU::NROW; ++i) {  // the first line after the header is skipped by the reader
+    int const Pixel = max(i, 0);
+    int const ROC = Pixel / (PLTU::NCOL * PLTU::NROW), Col = (Pixel / PLTU::NROW) % PLTU::NCOL, Row = Pixel % PLTU::NROW;
+    f << "1 " << ROC << " " << Col << " " << Row << " " << Random.Gaus(1e-3, 1e-4) << " " << Random.Gaus(2.5, .1) << " "
+      << Random.Gaus(250, 10) << " " << Random.Gaus(120, 5) << " " << Random.Gaus(30, 2) << "\n";
+  }
+  return FileName;
+}
+
+
+/** copies of the calibration files of the telescope in a temporary directory, such that the binary caches are not written
+ *  next to the real calibration files. Everything is removed again at the end. */
+class CalibrationCopy
+{
+  public:
+    explicit CalibrationCopy (uint16_t const NPlanes): fDir(Form("/tmp/TrackingTelescopeBench_%i", gSystem->GetPid())), fNPlanes(NPlanes)
+    {
+      gSystem->mkdir(fDir.c_str(), true);
+      for (int iroc = 0; iroc != fNPlanes; ++iroc) {
+        gSystem->CopyFile((GetCalibrationPath() + Form("ROC%i.txt", iroc)).c_str(), FileName(iroc).c_str(), true);
+      }
+    }
+    ~CalibrationCopy ()
+    {
+      for (int iroc = 0; iroc != fNPlanes; ++iroc) {
+        for (const char * Suffix: {"", ".cache", ".lut.cache"}) { gSystem->Unlink((FileName(iroc) + Suffix).c_str()); }
+      }
+      gSystem->Unlink(fDir.c_str());
+    }
+    string FileName (int const roc) const { return fDir + Form("/ROC%i.txt", roc); }
+    string const & Dir () const { return fDir; }
+
+  private:
+    string const fDir;
+    uint16_t const fNPlanes;
+};
+
+
+/** ============================
+ TELESCOPE
+ =================================*/
+class BenchTelescope : public PLTTelescope, public PLTTracking
+{
+  public:
+    BenchTelescope (uint16_t const NPlanes, PLTAlignment & Alignment):
+      PLTTracking(NPlanes), fPlaneArray(NPlanes)
+    {
+      SetTrackingArena(&fArena);
+      fOwnsTracks = false;
+      SetTrackingAlignment(&Alignment);
+      for (uint16_t iroc = 0; iroc != NPlanes; ++iroc) {
+        fPlaneArray[iroc].SetChannel(1);
+        fPlaneArray[iroc].SetROC(iroc);
+        fPlaneArray[iroc].SetArena(&fArena);
+        AddPlane(&fPlaneArray[iroc]);
+      }
+    }
+    ~BenchTelescope ()
+    {
+      /** the planes and tracks are not owned by the telescope */
+      fPlanes.clear();
+      fTracks.clear();
+    }
+
+    void Clear ()
+    {
+      for (auto & Plane: fPlaneArray) { Plane.Clear(); }
+      fTracks.clear();
+      fArena.Reset();
+    }
+    void Load (BenchEvent const & Event, PLTGainCal & GainCal, PLTAlignment & Alignment)
+    {
+      Clear();
+      for (auto const & H: Event) {
+        PLTHit * Hit = fArena.NewHit(1, H.ROC, H.Column, H.Row, H.ADC);
+        GainCal.SetCharge(*Hit);
+        Alignment.AlignHit(*Hit);
+        fPlaneArray[H.ROC].AddHit(Hit);
+      }
+    }
+    size_t Clusterize (PLTPlane::Clustering const Clustering)
+    {
+      for (auto & Plane: fPlaneArray) { Plane.Clusterize(Clustering, PLTPlane::kFiducialRegion_All); }
+      return 1;
+    }
+    bool HasClusterInAllPlanes ()
+    {
+      for (auto & Plane: fPlaneArray) {
+        if (Plane.NClusters() == 0) { return false; }
+      }
+      return true;
+    }
+    PLTTrack * NewTrackFromFirstClusters ()
+    {
+      PLTTrack * Track = fArena.NewTrack();
+      for (auto & Plane: fPlaneArray) { Track->AddCluster(Plane.Cluster(0)); }
+      return Track;
+    }
+
+  private:
+    PLTEventArena fArena;
+    std::vector<PLTPlane> fPlaneArray;
+};
+
+
+/** ============================
+ BENCHMARK RUNNER
+ =================================*/
+struct Benchmark {
+  string Name;
+  string Unit;                         // what one operation is
+  function<bool(size_t)> Setup;        // prepares the input i (not timed), false to skip it
+  function<size_t(size_t)> Kernel;     // runs the kernel on the input i and returns the number of operations
+};
+
+class BenchRunner
+{
+  public:
+    BenchRunner (size_t NInputs, double MinTime): fNInputs(NInputs), fMinTime(MinTime) { }
+
+    void Run (Benchmark const & B)
+    {
+      /** cycle through the inputs until the kernels ran for at least fMinTime, only the kernel calls are timed and counted */
+      using Clock = chrono::steady_clock;
+      uint64_t NOps = 0, NAllocs = 0;
+      Clock::duration Time(0);
+      for (size_t i = 0, NPasses = 0; NPasses == 0 or chrono::duration<double>(Time).count() < fMinTime; ++i) {
+        if (i == fNInputs) {
+          i = 0;
+          if (++NPasses >= 1000 or NOps == 0) { break; }
+        }
+        if (B.Setup and not B.Setup(i)) { continue; }
+        uint64_t const Allocs0 = NAllocations.load(memory_order_relaxed);
+        Clock::time_point const Start = Clock::now();
+        NOps += B.Kernel(i);
+        Time += Clock::now() - Start;
+        NAllocs += NAllocations.load(memory_order_relaxed) - Allocs0;
+      }
+      double const NanoSeconds = chrono::duration<double, nano>(Time).count();
+      cout << left << setw(40) << B.Name << setw(8) << B.Unit << right << setw(12) << NOps << fixed
+           << setw(14) << setprecision(1) << (NOps ? NanoSeconds / NOps : 0.)
+           << setw(14) << setprecision(3) << (NOps ? double(NAllocs) / NOps : 0.) << endl;
+    }
+
+    static void PrintHeader ()
+    {
+      cout << left << setw(40) << "Benchmark" << setw(8) << "Op" << right << setw(12) << "Ops" << setw(14) << "ns/op" << setw(14) << "allocs/op" << endl;
+      cout << string(88, '-') << endl;
+    }
+
+  private:
+    size_t const fNInputs;
+    double const fMinTime;
+};
+
+
+/** ============================
+ REGRESSION CHECKS
+ =================================*/
+struct Check {
+  string Name;
+  function<pair<size_t, size_t>()> Run;  // compares an optimised path with the baseline path, returns the number of mismatches and of comparisons
+};
+
+bool RunCheck (Check const & C)
+{
+  pair<size_t, size_t> const Result = C.Run();
+  cout << left << setw(60) << C.Name << right << setw(12) << Result.second << setw(12) << Result.first
+       << (Result.first == 0 and Result.second != 0 ? "  ok" : "  FAILED") << endl;
+  return Result.first == 0 and Result.second != 0;
+}
+
+} // end anonymous namespace
+
+
+void PrintUsage (const string & name)
+{
+  cerr << "Usage: " << name << " [options]" << endl;
+  cerr << "options:\n  --telescope <id>: telescope configuration with the alignment and calibration files (default 25)" << endl;
+  cerr << "  --events <n>: number of simulated events (default 2000)" << endl;
+  cerr << "  --min-time <s>: minimum time of each benchmark in seconds (default 0.5)" << endl;
+  cerr << "  --filter <text>: only run the benchmarks with <text> in their name" << endl;
+  cerr << "  --check <0/1>: compare the outputs of the optimised paths with the baseline paths instead of running the benchmarks" << endl;
+}
+
+
+int main (int argc, char* argv[])
+{
+  vector<string> args(argv, argv + argc);
+  auto const telescope_id = int16_t(stoi(tel::pop_option(args, "--telescope", "25")));
+  auto const n_events = size_t(stoul(tel::pop_option(args, "--events", "2000")));
+  auto const min_time = stod(tel::pop_option(args, "--min-time", "0.5"));
+  auto const filter = tel::pop_option(args, "--filter", "");
+  auto const check = bool(stoi(tel::pop_option(args, "--check", "0")));
+  if (args.size() != 1) {
+    PrintUsage(args[0]);
+    return 1;
+  }
+  if (tel::Config::Read(telescope_id) == 0) { return 3; }
+  uint16_t const NPlanes = GetNPlanes();
+
+  /** inputs: alignment and calibrations of the telescope, the binary caches are only used on the copies of CalibrationCopy */
+  PLTGainCal::UseCache = false;
+  CalibrationCopy Calibrations(NPlanes);
+  PLTAlignment Alignment;
+  Alignment.ReadAlignmentFile(GetAlignmentFilename());
+  Alignment.SetErrors(telescope_id, true);
+  PLTGainCal GainCalErf(NPlanes, true, false), GainCalLUT(NPlanes, true, true), GainCalParametric(NPlanes, false);
+  PSIGainInterpolator GainInterpolator;
+  for (int iroc = 0; iroc != NPlanes; ++iroc) {
+    GainCalErf.ReadGainCalFile(GetCalibrationPath() + Form("ROC%i.txt", iroc), iroc);
+    GainCalLUT.ReadGainCalFile(GetCalibrationPath() + Form("ROC%i.txt", iroc), iroc);
+    GainInterpolator.ReadFile(GetCalibrationPath() + Form("phCalibration_C%i.dat", iroc), iroc);
+  }
+  string const ParametricFile = WriteParametricGainCal(NPlanes);
+  GainCalParametric.ReadGainCalFile(ParametricFile);
+  gSystem->Unlink(ParametricFile.c_str());
+
+  vector<BenchEvent> const Events = MakeEvents(n_events, Alignment, NPlanes);
+  vector<PLTHit> Hits;
+  for (auto const & Event: Events) {
+    for (auto const & H: Event) { Hits.emplace_back(1, H.ROC, H.Column, H.Row, H.ADC); }
+  }
+  /** the same hits as arrays for the batch calibration */
+  vector<uint8_t> HitROC, HitColumn, HitRow;
+  vector<int16_t> HitADC;
+  for (auto & H: Hits) {
+    HitROC.push_back(uint8_t(H.ROC())); HitColumn.push_back(uint8_t(H.Column())); HitRow.push_back(uint8_t(H.Row())); HitADC.push_back(int16_t(H.ADC()));
+  }
+  vector<float> Charges(Hits.size());
+  BenchTelescope Telescope(NPlanes, Alignment);
+
+  /** per hit kernels run over the hits of one event */
+  vector<size_t> FirstHit(1, 0);
+  for (auto const & Event: Events) { FirstHit.push_back(FirstHit.back() + Event.size()); }
+  volatile float Sink = 0;
+  auto GainKernel = [&] (function<float(PLTHit&)> const & GetCharge) {
+    return [&, GetCharge] (size_t i) {
+      float Sum = 0;
+      for (size_t ihit = FirstHit[i]; ihit != FirstHit[i + 1]; ++ihit) { Sum += GetCharge(Hits[ihit]); }
+      Sink = Sum;
+      return FirstHit[i + 1] - FirstHit[i];
+    };
+  };
+
+  vector<Benchmark> Benchmarks;
+  Benchmarks.push_back({"PLTGainCal::GetCharge parametric", "hit", nullptr, GainKernel([&] (PLTHit & H) {
+    return GainCalParametric.GetCharge(1, H.ROC(), H.Column(), H.Row(), H.ADC()); })});
+  Benchmarks.push_back({"PLTGainCal::GetCharges parametric", "hit", nullptr, [&] (size_t i) {
+    size_t const First = FirstHit[i], N = FirstHit[i + 1] - First;
+    GainCalParametric.GetCharges(N, HitROC.data() + First, HitColumn.data() + First, HitRow.data() + First, HitADC.data() + First, Charges.data() + First);
+    return N; }});
+  /** startup: reading the calibration of one ROC from the text file (building the lookup table) or from the binary cache */
+  PLTGainCal GainCalRead(NPlanes, true, true);
+  for (bool const Cached: {false, true}) {
+    Benchmarks.push_back({Cached ? "PLTGainCal::ReadGainCalFile cache" : "PLTGainCal::ReadGainCalFile text", "ROC", nullptr, [&, Cached] (size_t i) {
+      PLTGainCal::UseCache = Cached;
+      GainCalRead.ReadGainCalFile(Calibrations.FileName(int(i % NPlanes)), int(i % NPlanes));
+      PLTGainCal::UseCache = false;
+      return size_t(1); }});
+  }
+  Benchmarks.push_back({"PLTGainCal::GetCharge Erf", "hit", nullptr, GainKernel([&] (PLTHit & H) {
+    return GainCalErf.GetCharge(1, H.ROC(), H.Column(), H.Row(), H.ADC()); })});
+  Benchmarks.push_back({"PLTGainCal::GetCharge Erf lookup table", "hit", nullptr, GainKernel([&] (PLTHit & H) {
+    return GainCalLUT.GetCharge(1, H.ROC(), H.Column(), H.Row(), H.ADC()); })});
+  Benchmarks.push_back({"PSIGainInterpolator::GetLinearInterpolation", "hit", nullptr, GainKernel([&] (PLTHit & H) {
+    return GainInterpolator.GetLinearInterpolation(1, H.ROC(), H.Column(), H.Row(), H.ADC()); })});
+  Benchmarks.push_back({"PLTAlignment::AlignHit", "hit", nullptr, [&] (size_t i) {
+    for (size_t ihit = FirstHit[i]; ihit != FirstHit[i + 1]; ++ihit) { Alignment.AlignHit(Hits[ihit]); }
+    return FirstHit[i + 1] - FirstHit[i]; }});
+
+  /** clustering of all planes of an event */
+  vector<pair<string, PLTPlane::Clustering> > const Clusterings = {
+    {"Seed_3x3", PLTPlane::kClustering_Seed_3x3}, {"Seed_5x5", PLTPlane::kClustering_Seed_5x5}, {"Seed_9x9", PLTPlane::kClustering_Seed_9x9},
+    {"AllTouching", PLTPlane::kClustering_AllTouching}, {"OnePixOneCluster", PLTPlane::kClustering_OnePixOneCluster}};
+  for (bool const Grid: {true, false}) {
+    for (auto const & C: Clusterings) {
+      if (not Grid and C.second == PLTPlane::kClustering_OnePixOneCluster) { continue; }
+      PLTPlane::Clustering const Clustering = C.second;
+      Benchmarks.push_back({"PLTPlane::Clusterize " + C.first + (Grid ? " grid" : " list"), "event",
+        [&, Grid] (size_t i) { PLTPlane::UseGridClustering = Grid; Telescope.Load(Events[i], GainCalLUT, Alignment); return true; },
+        [&, Clustering] (size_t) { return Telescope.Clusterize(Clustering); }});
+    }
+  }
+  auto LoadAndClusterize = [&] (size_t i) {
+    PLTPlane::UseGridClustering = true;
+    Telescope.Load(Events[i], GainCalLUT, Alignment);
+    Telescope.Clusterize(PLTPlane::kClustering_AllTouching);
+    return Telescope.HasClusterInAllPlanes();
+  };
+
+  /** track fit of one cluster per plane */
+  PLTTrack * Track = nullptr;
+  Benchmarks.push_back({"PLTTrack::MakeTrack", "track",
+    [&] (size_t i) { if (not LoadAndClusterize(i)) { return false; } Track = Telescope.NewTrackFromFirstClusters(); return true; },
+    [&] (size_t) { Track->MakeTrack(Alignment, NPlanes); return size_t(1); }});
+
+  /** track finders on events with a cluster in every plane */
+  vector<tuple<string, PLTTracking::TrackingAlgorithm, bool> > const Finders = {
+    make_tuple("AllPlanesHit road search", PLTTracking::kTrackingAlgorithm_6PlanesHit, true),
+    make_tuple("AllPlanesHit all combinations", PLTTracking::kTrackingAlgorithm_6PlanesHit, false),
+    make_tuple("ETH road search", PLTTracking::kTrackingAlgorithm_ETH, true)};
+  for (auto const & F: Finders) {
+    PLTTracking::TrackingAlgorithm const Algorithm = get<1>(F);
+    bool const Road = get<2>(F);
+    Benchmarks.push_back({"PLTTracking::" + get<0>(F), "event",
+      [&, Algorithm, Road] (size_t i) { Telescope.SetTrackingAlgorithm(Algorithm); PLTTracking::UseRoadSearch = Road; return LoadAndClusterize(i); },
+      [&] (size_t) { Telescope.RunTracking(Telescope); return size_t(1); }});
+  }
+
+  /** the tracks of an event as the aligned positions of their clusters, in the order of the telescope */
+  auto TrackList = [&] (size_t i) {
+    vector<vector<float> > Tracks;
+    if (not LoadAndClusterize(i)) { return Tracks; }
+    Telescope.RunTracking(Telescope);
+    for (size_t itrack = 0; itrack != Telescope.NTracks(); ++itrack) {
+      Tracks.emplace_back();
+      for (size_t icluster = 0; icluster != Telescope.Track(itrack)->NClusters(); ++icluster) {
+        PLTCluster * Cluster = Telescope.Track(itrack)->Cluster(icluster);
+        Tracks.back().insert(Tracks.back().end(), {float(Cluster->ROC()), Cluster->TX(), Cluster->TY()});
+      }
+    }
+    return Tracks;
+  };
+
+  vector<Check> Checks;
+  Checks.push_back({"PLTGainCal::GetCharges == GetCharge parametric", [&] {
+    GainCalParametric.GetCharges(Hits.size(), HitROC.data(), HitColumn.data(), HitRow.data(), HitADC.data(), Charges.data());
+    size_t NDiffer = 0;
+    for (size_t ihit = 0; ihit != Hits.size(); ++ihit) {
+      NDiffer += Charges[ihit] != GainCalParametric.GetCharge(1, Hits[ihit].ROC(), Hits[ihit].Column(), Hits[ihit].Row(), Hits[ihit].ADC());
+    }
+    return make_pair(NDiffer, Hits.size()); }});
+  /** the alignment fixes its reference plane with an error of 0, the analytic fit has to skip it like the ROOT fit */
+  Checks.push_back({"PLTTrack::MakeTrack zero error == ROOT fit", [&] {
+    float const ErrorX = Alignment.GetErrorX(0), ErrorY = Alignment.GetErrorY(0);
+    Alignment.SetErrorX(0, 0);
+    Alignment.SetErrorY(0, 0);
+    auto Close = [] (double a, double b) { return fabs(a - b) <= 1e-4 + 1e-3 * fabs(b); };
+    size_t NDiffer = 0, NTracks = 0;
+    for (size_t i = 0; i != Events.size(); ++i) {
+      if (not LoadAndClusterize(i)) { continue; }
+      PLTTrack * T = Telescope.NewTrackFromFirstClusters();
+      PLTTrack::UseRootFit = true;
+      T->MakeTrack(Alignment, NPlanes);
+      float const Root[6] = {T->fSlopeX, T->fSlopeY, T->fOffsetX, T->fOffsetY, T->Chi2X(), T->Chi2Y()};
+      PLTTrack::UseRootFit = false;
+      T->MakeTrack(Alignment, NPlanes);
+      float const Analytic[6] = {T->fSlopeX, T->fSlopeY, T->fOffsetX, T->fOffsetY, T->Chi2X(), T->Chi2Y()};
+      bool Differ = false;
+      for (int j = 0; j != 6; ++j) { Differ = Differ or not Close(Analytic[j], Root[j]); }
+      NDiffer += Differ;
+      NTracks++;
+    }
+    Alignment.SetErrorX(0, ErrorX);
+    Alignment.SetErrorY(0, ErrorY);
+    return make_pair(NDiffer, NTracks); }});
+
+  for (auto const & F: Finders) {
+    if (not get<2>(F)) { continue; }
+    PLTTracking::TrackingAlgorithm const Algorithm = get<1>(F);
+    Checks.push_back({"PLTTracking::" + get<0>(F) + " == all combinations", [&, Algorithm] {
+      size_t NDiffer = 0, NEvents = 0;
+      Telescope.SetTrackingAlgorithm(Algorithm);
+      for (size_t i = 0; i != Events.size(); ++i) {
+        PLTTracking::UseRoadSearch = false;
+        vector<vector<float> > const Tracks = TrackList(i);
+        PLTTracking::UseRoadSearch = true;
+        NDiffer += TrackList(i) != Tracks;
+        NEvents++;
+      }
+      PLTTracking::UseRoadSearch = false;
+      return make_pair(NDiffer, NEvents); }});
+  }
+
+  for (bool const LUT: {false, true}) {
+    Checks.push_back({string("PLTGainCal cache == text file") + (LUT ? " lookup table" : ""), [&, LUT] {
+      PLTGainCal Text(NPlanes, true, LUT), Writer(NPlanes, true, LUT), Cached(NPlanes, true, LUT);
+      for (int iroc = 0; iroc != NPlanes; ++iroc) {
+        for (const char * Suffix: {".cache", ".lut.cache"}) { gSystem->Unlink((Calibrations.FileName(iroc) + Suffix).c_str()); }
+        Text.ReadGainCalFile(Calibrations.FileName(iroc), iroc);
+        PLTGainCal::UseCache = true;
+        Writer.ReadGainCalFile(Calibrations.FileName(iroc), iroc);  // parses the text file and writes the cache
+        Cached.ReadGainCalFile(Calibrations.FileName(iroc), iroc);  // loads the cache
+        PLTGainCal::UseCache = false;
+      }
+      size_t NDiffer = 0;
+      for (int iroc = 0; iroc != NPlanes; ++iroc) {
+        NDiffer += gSystem->AccessPathName((Calibrations.FileName(iroc) + (LUT ? ".lut.cache" : ".cache")).c_str());  // no cache was written
+      }
+      for (auto & H: Hits) {
+        NDiffer += Cached.GetCharge(1, H.ROC(), H.Column(), H.Row(), H.ADC()) != Text.GetCharge(1, H.ROC(), H.Column(), H.Row(), H.ADC());
+      }
+      return make_pair(NDiffer, Hits.size()); }});
+  }
+
+  /** the tracking tree has to contain the charges of the event loop, not the ones of the input file, and the copied input branches */
+  Checks.push_back({"FileWriterTracking charge/input == PSIRootFileReader", [&] {
+    string const InFileName = Calibrations.Dir() + "/test99999.root";
+    {
+      TFile f(InFileName.c_str(), "RECREATE");
+      TTree Tree("tree", "tree");
+      UShort_t NHits;
+      uint8_t Plane[UINT8_MAX + 1], Col[UINT8_MAX + 1], Row[UINT8_MAX + 1];
+      int16_t ADC[UINT8_MAX + 1];
+      float Charge[UINT8_MAX + 1];
+      int32_t EventNumber;
+      double Time;
+      Tree.Branch("event_number", &EventNumber, "event_number/I");
+      Tree.Branch("time", &Time, "time/D");
+      Tree.Branch("n_hits_tot", &NHits, "n_hits_tot/s");
+      Tree.Branch("plane", Plane, "plane[n_hits_tot]/b");
+      Tree.Branch("col", Col, "col[n_hits_tot]/b");
+      Tree.Branch("row", Row, "row[n_hits_tot]/b");
+      Tree.Branch("adc", ADC, "adc[n_hits_tot]/S");
+      Tree.Branch("charge", Charge, "charge[n_hits_tot]/F");
+      for (size_t i = 0; i != Events.size(); ++i) {
+        EventNumber = int32_t(i);
+        Time = double(i);
+        NHits = UShort_t(min(Events[i].size(), size_t(UINT8_MAX + 1)));
+        for (size_t ihit = 0; ihit != NHits; ++ihit) {
+          BenchHit const & H = Events[i][ihit];
+          Plane[ihit] = H.ROC; Col[ihit] = H.Column; Row[ihit] = H.Row; ADC[ihit] = H.ADC;
+          Charge[ihit] = -1;  // not calibrated
+        }
+        Tree.Fill();
+      }
+      Tree.Write();
+      f.Close();
+    }
+    ROOT::EnableThreadSafety();
+    vector<vector<float> > Expected;
+    string OutFileName;
+    {
+      PSIRootFileReader Reader(InFileName, false, false);
+      FileWriterTracking Writer(InFileName, &Reader);
+      OutFileName = Writer.FileName();
+      for (uint32_t Entry = 0; Reader.GetNextEvent() >= 0; ++Entry) {
+        Expected.emplace_back(Reader.Charges(), Reader.Charges() + Reader.NHitsTotal());
+        Writer.fillTree(Entry);
+      }
+      Writer.saveTree();
+    }
+    size_t NDiffer = 0;
+    {
+      TFile f(OutFileName.c_str(), "READ");
+      auto * Tree = dynamic_cast<TTree*>(f.Get("tree"));
+      UShort_t NHits;
+      float Charge[UINT8_MAX + 1];
+      int16_t ADC[UINT8_MAX + 1];
+      int32_t EventNumber;
+      Tree->SetBranchAddress("n_hits_tot", &NHits);
+      Tree->SetBranchAddress("charge", Charge);
+      Tree->SetBranchAddress("adc", ADC);
+      Tree->SetBranchAddress("event_number", &EventNumber);
+      NDiffer += size_t(Tree->GetEntries()) != Expected.size();
+      for (size_t i = 0; i != min(Expected.size(), size_t(Tree->GetEntries())); ++i) {
+        Tree->GetEntry(Long64_t(i));
+        bool Differ = vector<float>(Charge, Charge + NHits) != Expected[i] or EventNumber != int32_t(i);
+        for (size_t ihit = 0; ihit < min(size_t(NHits), Events[i].size()); ++ihit) { Differ = Differ or ADC[ihit] != Events[i][ihit].ADC; }
+        NDiffer += Differ;
+      }
+      f.Close();
+    }
+    gSystem->Unlink(InFileName.c_str());
+    gSystem->Unlink(OutFileName.c_str());
+    return make_pair(NDiffer, Expected.size()); }});
+
+  if (check) {
+    tel::info(Form("Running the regression checks on %zu simulated events with %zu hits", Events.size(), Hits.size()));
+    cout << left << setw(60) << "Check" << right << setw(12) << "Compared" << setw(12) << "Differ" << endl;
+    cout << string(88, '-') << endl;
+    bool Passed = true;
+    for (auto const & C: Checks) {
+      if (C.Name.find(filter) != string::npos) { Passed = RunCheck(C) and Passed; }
+    }
+    return Passed ? 0 : 2;
+  }
+
+  tel::info(Form("Running the benchmarks on %zu simulated events with %zu hits", Events.size(), Hits.size()));
+  BenchRunner Runner(Events.size(), min_time);
+  BenchRunner::PrintHeader();
+  for (auto const & B: Benchmarks) {
+    if (B.Name.find(filter) != string::npos) { Runner.Run(B); }
+  }
+
+  return 0;
+}
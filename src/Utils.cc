@@ -7,6 +7,7 @@
 #include <iomanip>
 #include <cmath>
 #include <algorithm>
+#include <stdexcept>
 
 using namespace std;
 
@@ -64,6 +65,19 @@ namespace tel {
 
    void info(const string & msg) { cout <<  INFO << "INFO: " << ENDC << msg << endl; }
 
+  string pop_option(vector<string> & args, const string & name, const string & default_value) {
+    /** removes "<name> <value>" from the arguments so that the positional arguments keep their indices */
+    auto it = find(args.begin(), args.end(), name);
+    if (it == args.end()) { return default_value; }
+    if (next(it) == args.end()) {
+      critical("missing value for option " + name);
+      throw std::invalid_argument("missing value for option " + name);
+    }
+    string value = *next(it);
+    args.erase(it, next(it, 2));
+    return value;
+  }
+
   void ProgressBar::update(uint32_t event) {
 
     if (currentEvent == 0u)